@@ -0,0 +1,169 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstdio>
+#include <random>
+#include <algorithm>
+#include "NetworkManagerLogger.h"
+#include "DiagnosticJobs.h"
+
+#define NM_DIAGNOSTIC_CANCELLED_RESULT  "{\"success\":false,\"error\":\"Cancelled\"}"
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        DiagnosticJobs::DiagnosticJobs(const Completion& completion)
+            : completion(completion)
+            , stopping(false)
+        {
+        }
+
+        DiagnosticJobs::~DiagnosticJobs()
+        {
+            shutdown();
+        }
+
+        void DiagnosticJobs::shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+                for (const auto& guid : pending)
+                    jobs.erase(guid);
+                pending.clear();
+                for (auto& job : jobs)
+                {
+                    if (job.second->state == DIAGNOSTIC_RUNNING && job.second->job.cancel)
+                        job.second->job.cancel();
+                }
+            }
+            queued.notify_all();
+            /* workers are only made by submit, which refuses once stopping is set */
+            for (auto& worker : workers)
+                worker.join();
+            workers.clear();
+        }
+
+        std::string DiagnosticJobs::newGuid()
+        {
+            static std::mutex guidLock;
+            static std::mt19937_64 generator(std::random_device{}());
+            uint64_t high, low;
+            {
+                std::lock_guard<std::mutex> guard(guidLock);
+                high = generator();
+                low = generator();
+            }
+            /* version 4, variant 10 */
+            high = (high & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL;
+            low = (low & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;
+            char text[40];
+            snprintf(text, sizeof(text), "%08x-%04x-%04x-%04x-%012llx",
+                     static_cast<unsigned>(high >> 32), static_cast<unsigned>((high >> 16) & 0xFFFF), static_cast<unsigned>(high & 0xFFFF),
+                     static_cast<unsigned>(low >> 48), static_cast<unsigned long long>(low & 0xFFFFFFFFFFFFULL));
+            return text;
+        }
+
+        DiagnosticJobs::SubmitResult DiagnosticJobs::submit(const std::string& guid, const DiagnosticJob& job)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (jobs.find(guid) != jobs.end())
+                return DUPLICATE;
+            if (stopping || jobs.size() >= NM_DIAGNOSTIC_MAX_JOBS)
+                return FULL;
+
+            std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+            entry->job = job;
+            entry->state = DIAGNOSTIC_QUEUED;
+            jobs[guid] = entry;
+            pending.push_back(guid);
+            /* one more worker whenever every worker there is already has a job */
+            if (workers.size() < NM_DIAGNOSTIC_WORKERS && workers.size() < jobs.size())
+                workers.push_back(std::thread(&DiagnosticJobs::workerThreadFunction, this));
+            NMLOG_INFO("diagnostic %s queued, %zu jobs", guid.c_str(), jobs.size());
+            queued.notify_one();
+            return SUBMITTED;
+        }
+
+        bool DiagnosticJobs::cancel(const std::string& guid)
+        {
+            DiagnosticJob job;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                auto found = jobs.find(guid);
+                if (found == jobs.end())
+                    return false;
+                if (found->second->state == DIAGNOSTIC_RUNNING)
+                {
+                    NMLOG_INFO("diagnostic %s cancelled while running", guid.c_str());
+                    if (found->second->job.cancel)
+                        found->second->job.cancel();
+                    return true;
+                }
+                job = found->second->job;
+                jobs.erase(found);
+                pending.erase(std::find(pending.begin(), pending.end(), guid));
+            }
+            NMLOG_INFO("diagnostic %s cancelled before it ran", guid.c_str());
+            completion(guid, job.type, NM_DIAGNOSTIC_CANCELLED_RESULT);
+            return true;
+        }
+
+        bool DiagnosticJobs::status(const std::string& guid, DiagnosticJobState& state, uint32_t& progress) const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = jobs.find(guid);
+            if (found == jobs.end())
+                return false;
+            state = found->second->state;
+            progress = (state == DIAGNOSTIC_RUNNING && found->second->job.progress) ? found->second->job.progress() : 0;
+            return true;
+        }
+
+        void DiagnosticJobs::workerThreadFunction()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (true)
+            {
+                queued.wait(guard, [this] { return stopping || !pending.empty(); });
+                if (stopping)
+                    break;
+
+                std::string guid = pending.front();
+                pending.pop_front();
+                std::shared_ptr<Entry> entry = jobs[guid];
+                entry->state = DIAGNOSTIC_RUNNING;
+
+                guard.unlock();
+                NMLOG_INFO("diagnostic %s running", guid.c_str());
+                std::string result = entry->job.run();
+                guard.lock();
+
+                jobs.erase(guid);
+                /* a job that ran when the manager was going away has nobody left to tell */
+                if (stopping)
+                    break;
+                guard.unlock();
+                completion(guid, entry->job.type, result);
+                guard.lock();
+            }
+        }
+    }
+}
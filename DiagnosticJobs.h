@@ -0,0 +1,104 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <map>
+#include <vector>
+
+#define NM_DIAGNOSTIC_WORKERS           4       // pings and traces that run at the same time
+#define NM_DIAGNOSTIC_MAX_JOBS          32      // running and queued; a start beyond this is refused
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        enum DiagnosticJobType {
+            DIAGNOSTIC_PING,
+            DIAGNOSTIC_TRACE
+        };
+
+        enum DiagnosticJobState {
+            DIAGNOSTIC_QUEUED,
+            DIAGNOSTIC_RUNNING
+        };
+
+        /* what a diagnostic does, set up by whoever starts it; cancel and progress are called from other threads */
+        struct DiagnosticJob {
+            DiagnosticJobType type;
+            std::function<std::string()> run;   /* returns the result JSON */
+            std::function<void()> cancel;
+            std::function<uint32_t()> progress; /* percent */
+        };
+
+        /*
+         * Pings and traces started in the background, each known by its GUID until its result is handed to the
+         * completion callback. They run on up to NM_DIAGNOSTIC_WORKERS threads, made when the first job comes,
+         * and the rest wait in order. A queued job that is cancelled never runs and completes at once, a running
+         * one is told to stop and completes with what it has. Every job completes once, the callback should
+         * not block: it runs on a worker, or on the cancelling thread for a queued job.
+         */
+        class DiagnosticJobs
+        {
+            public:
+                typedef std::function<void(const std::string& guid, DiagnosticJobType type, const std::string& jsonOfResult)> Completion;
+
+                explicit DiagnosticJobs(const Completion& completion);
+                ~DiagnosticJobs();
+                /* running jobs are cancelled and waited for, queued ones are dropped without completion; later submits are refused */
+                void shutdown();
+                enum SubmitResult {
+                    SUBMITTED,
+                    DUPLICATE,
+                    FULL
+                };
+                SubmitResult submit(const std::string& guid, const DiagnosticJob& job);
+                /* false when no queued or running job has the GUID */
+                bool cancel(const std::string& guid);
+                bool status(const std::string& guid, DiagnosticJobState& state, uint32_t& progress) const;
+                /* random, in the 8-4-4-4-12 hex form */
+                static std::string newGuid();
+
+            private:
+                struct Entry {
+                    DiagnosticJob job;
+                    DiagnosticJobState state;
+                };
+
+                DiagnosticJobs(const DiagnosticJobs&) = delete;
+                DiagnosticJobs& operator=(const DiagnosticJobs&) = delete;
+                void workerThreadFunction();
+
+                const Completion completion;
+                mutable std::mutex lock;
+                std::condition_variable queued;
+                std::map<std::string, std::shared_ptr<Entry>> jobs;
+                std::deque<std::string> pending;
+                std::vector<std::thread> workers;
+                bool stopping;
+        };
+    }
+}
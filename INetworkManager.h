@@ -30,7 +30,8 @@ namespace WPEFramework
             ID_NETWORKMANAGER                               = 0x800004E0,
             ID_NETWORKMANAGER_NOTIFICATION                  = ID_NETWORKMANAGER + 1,
             ID_NETWORKMANAGER_INTERFACE_DETAILS_ITERATOR    = ID_NETWORKMANAGER + 2,
-            ID_NETWORKMANAGER_WIFI_SECURITY_MODE_ITERATOR   = ID_NETWORKMANAGER + 3
+            ID_NETWORKMANAGER_WIFI_SECURITY_MODE_ITERATOR   = ID_NETWORKMANAGER + 3,
+            ID_NETWORKMANAGER_WIFI_ACCESS_POINT_ITERATOR    = ID_NETWORKMANAGER + 4
         };
 
         /* @json */
@@ -125,6 +126,29 @@ namespace WPEFramework
                     double           m_frequency;
             };
 
+            enum WiFiSecurityFlags : uint32_t
+            {
+                WIFI_SECURITY_FLAG_PRIVACY      = 0x01,
+                WIFI_SECURITY_FLAG_WPA          = 0x02,
+                WIFI_SECURITY_FLAG_RSN          = 0x04,
+                WIFI_SECURITY_FLAG_PSK          = 0x08,
+                WIFI_SECURITY_FLAG_8021X        = 0x10,
+                WIFI_SECURITY_FLAG_SAE          = 0x20,
+                WIFI_SECURITY_FLAG_OWE          = 0x40
+            };
+
+            /* one scan result, plain values only so it crosses COM-RPC without any JSON */
+            struct EXTERNAL WiFiAccessPoint {
+                    string           m_ssid;            /* raw SSID octets, at most 32, not necessarily UTF-8; empty for a hidden network */
+                    uint64_t         m_bssid;           /* 48 bit MAC, first octet in the most significant byte; 0 when unknown */
+                    uint32_t         m_frequency;       /* MHz */
+                    int16_t          m_rssi;            /* dBm */
+                    uint8_t          m_strength;        /* 0 - 100 */
+                    WIFISecurityMode m_securityMode;
+                    uint32_t         m_securityFlags;   /* WiFiSecurityFlags */
+                    int32_t          m_lastSeen;        /* CLOCK_BOOTTIME seconds the AP was last seen, -1 when unknown */
+            };
+
             struct EXTERNAL WiFiConnectTo {
                     string           m_ssid;
                     string           m_passphrase;
@@ -203,6 +227,7 @@ namespace WPEFramework
             using IInterfaceDetailsIterator = RPC::IIteratorType<InterfaceDetails,     ID_NETWORKMANAGER_INTERFACE_DETAILS_ITERATOR>;
             using ISecurityModeIterator     = RPC::IIteratorType<WIFISecurityModeInfo, ID_NETWORKMANAGER_WIFI_SECURITY_MODE_ITERATOR>;
             using IStringIterator           = RPC::IIteratorType<string,               RPC::ID_STRINGITERATOR>;
+            using IWiFiAccessPointIterator  = RPC::IIteratorType<WiFiAccessPoint,      ID_NETWORKMANAGER_WIFI_ACCESS_POINT_ITERATOR>;
 
             /* @brief Get all the Available Interfaces */
             virtual uint32_t GetAvailableInterfaces (IInterfaceDetailsIterator*& interfaces/* @out */) = 0;
@@ -292,11 +317,36 @@ namespace WPEFramework
                 virtual void onAvailableSSIDs(const string jsonOfWiFiScanResults /* @in */) = 0;
                 virtual void onWiFiStateChange(const WiFiState state /* @in */) = 0;
                 virtual void onWiFiSignalStrengthChange(const string ssid /* @in */, const string signalLevel /* @in */, const WiFiSignalQuality signalQuality /* @in */) = 0;
+
+                // Notifications added later go at the end, the proxy stubs address them by their position
+                virtual void onWiFiScanDelta(const uint32_t sequence /* @in */, const string& jsonOfAdded /* @in */, const string& jsonOfChanged /* @in */, const string& jsonOfRemoved /* @in */) = 0;
+
+                // Diagnostics started with StartPing and StartTrace
+                virtual void onPingResult(const string guid /* @in */, const string& jsonOfResult /* @in */) = 0;
+                virtual void onTraceResult(const string guid /* @in */, const string& jsonOfResult /* @in */) = 0;
             };
 
             // Allow other processes to register/unregister from our notifications
             virtual uint32_t Register(INetworkManager::INotification* notification) = 0;
             virtual uint32_t Unregister(INetworkManager::INotification* notification) = 0;
+
+            // Methods added later go at the end, the proxy stubs address them by their position
+            /* @brief Get the connectivity probe latency histograms and per endpoint health as a JSON document */
+            virtual uint32_t GetConnectivityStatistics(string& statistics /* @out */) const = 0;
+            /* @brief Get the event queue depth, delivery latency and per subscriber statistics as a JSON document */
+            virtual uint32_t GetNotificationStatistics(string& statistics /* @out */) const = 0;
+            /* @brief Get the access points of the last scan as typed records; the same scan onAvailableSSIDs carries as JSON */
+            virtual uint32_t GetWiFiScanResults(IWiFiAccessPointIterator*& accessPoints /* @out */) const = 0;
+            /* @brief Get the access point table onWiFiScanDelta events apply to and its sequence; read it again when a sequence is skipped */
+            virtual uint32_t GetWiFiScanTable(uint32_t& sequence /* @out */, IWiFiAccessPointIterator*& accessPoints /* @out */) const = 0;
+            /* @brief Start a ping in the background and return at once; the result comes in onPingResult with the GUID, one is made when none is given */
+            virtual uint32_t StartPing (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const uint16_t timeOutInSeconds /* @in */, string& guid /* @inout */) = 0;
+            /* @brief Start a trace in the background and return at once; the result comes in onTraceResult with the GUID, one is made when none is given */
+            virtual uint32_t StartTrace (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, string& guid /* @inout */) = 0;
+            /* @brief Cancel a ping or trace started in the background; its result event still comes, with what it had */
+            virtual uint32_t CancelDiagnostic (const string guid /* @in */) = 0;
+            /* @brief Get whether a ping or trace started in the background is queued or running, and how far it is in percent */
+            virtual uint32_t GetDiagnosticStatus (const string guid /* @in */, string& state /* @out */, uint32_t& progress /* @out */) const = 0;
         };
     }
 }
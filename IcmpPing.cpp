@@ -0,0 +1,343 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <atomic>
+#include <random>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include "NetworkManagerLogger.h"
+#include "IcmpPing.h"
+
+#define ICMP_HEADER_SIZE                8
+#define ICMP_ECHO_REQUEST               8
+#define ICMP_ECHO_REPLY                 0
+#define ICMP6_ECHO_REQUEST_TYPE         128
+#define ICMP6_ECHO_REPLY_TYPE           129
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        static std::atomic<uint16_t> identifierCounter(0);
+
+        IcmpPing::IcmpPing(int family)
+            : family(family)
+            , sockFd(-1)
+            , datagram(false)
+            , identifier(0)
+            , cancelled(false)
+            , percent(0)
+        {
+            memset(cookie, 0, sizeof(cookie));
+        }
+
+        IcmpPing::~IcmpPing()
+        {
+            close();
+        }
+
+        uint64_t IcmpPing::nowUs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+        }
+
+        uint16_t IcmpPing::checksum(const uint8_t* data, size_t length)
+        {
+            uint32_t sum = 0;
+            for (size_t i = 0; i + 1 < length; i += 2)
+                sum += (static_cast<uint32_t>(data[i]) << 8) | data[i + 1];
+            if (length & 1)
+                sum += static_cast<uint32_t>(data[length - 1]) << 8;
+            while (sum >> 16)
+                sum = (sum & 0xFFFF) + (sum >> 16);
+            return static_cast<uint16_t>(~sum);
+        }
+
+        bool IcmpPing::resolve(const std::string& endpoint, int family, sockaddr_storage& address, socklen_t& addressLen)
+        {
+            struct addrinfo hints;
+            struct addrinfo* results = nullptr;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = family;
+            hints.ai_socktype = SOCK_DGRAM;
+
+            int rc = getaddrinfo(endpoint.c_str(), nullptr, &hints, &results);
+            if (rc != 0 || results == nullptr)
+            {
+                NMLOG_ERROR("%s does not resolve: %s", endpoint.c_str(), gai_strerror(rc));
+                return false;
+            }
+            memset(&address, 0, sizeof(address));
+            memcpy(&address, results->ai_addr, results->ai_addrlen);
+            addressLen = results->ai_addrlen;
+            freeaddrinfo(results);
+            return true;
+        }
+
+        std::string IcmpPing::addressToString(const sockaddr_storage& address)
+        {
+            char text[INET6_ADDRSTRLEN] = "";
+            if (address.ss_family == AF_INET)
+                inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&address)->sin_addr, text, sizeof(text));
+            else if (address.ss_family == AF_INET6)
+                inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&address)->sin6_addr, text, sizeof(text));
+            return text;
+        }
+
+        bool IcmpPing::open()
+        {
+            const int protocol = (family == AF_INET6) ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP);
+
+            /* the kernel owns the identifier of a datagram socket and only hands it the replies to it */
+            sockFd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+            datagram = (sockFd >= 0);
+            if (sockFd < 0)
+                sockFd = socket(family, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+            if (sockFd < 0)
+            {
+                NMLOG_ERROR("ICMP socket failed: %s", strerror(errno));
+                return false;
+            }
+
+            if (family == AF_INET6 && !datagram)
+            {
+                struct icmp6_filter filter;
+                ICMP6_FILTER_SETBLOCKALL(&filter);
+                ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY_TYPE, &filter);
+                setsockopt(sockFd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+            }
+
+            /* a raw socket sees every echo reply on the host, the identifier and cookie pick this run's */
+            std::random_device random;
+            identifier = static_cast<uint16_t>((getpid() << 4) ^ identifierCounter++);
+            for (size_t i = 0; i < sizeof(cookie); i++)
+                cookie[i] = static_cast<uint8_t>(random());
+            return true;
+        }
+
+        void IcmpPing::close()
+        {
+            if (sockFd >= 0)
+            {
+                ::close(sockFd);
+                sockFd = -1;
+            }
+        }
+
+        bool IcmpPing::send(const sockaddr_storage& address, socklen_t addressLen, uint16_t sequence)
+        {
+            uint8_t packet[ICMP_HEADER_SIZE + ICMP_PING_PAYLOAD_SIZE];
+            memset(packet, 0, sizeof(packet));
+            packet[0] = (family == AF_INET6) ? ICMP6_ECHO_REQUEST_TYPE : ICMP_ECHO_REQUEST;
+            packet[4] = identifier >> 8;
+            packet[5] = identifier & 0xFF;
+            packet[6] = sequence >> 8;
+            packet[7] = sequence & 0xFF;
+            memcpy(packet + ICMP_HEADER_SIZE, cookie, sizeof(cookie));
+            for (size_t i = ICMP_HEADER_SIZE + sizeof(cookie); i < sizeof(packet); i++)
+                packet[i] = static_cast<uint8_t>(i);
+            /* ICMPv6 is summed by the kernel, it covers the IPv6 pseudo header */
+            if (family == AF_INET)
+            {
+                uint16_t sum = checksum(packet, sizeof(packet));
+                packet[2] = sum >> 8;
+                packet[3] = sum & 0xFF;
+            }
+
+            ssize_t sent = sendto(sockFd, packet, sizeof(packet), 0, reinterpret_cast<const sockaddr*>(&address), addressLen);
+            if (sent != static_cast<ssize_t>(sizeof(packet)))
+            {
+                NMLOG_WARNING("ICMP echo %u not sent: %s", sequence, strerror(errno));
+                return false;
+            }
+            return true;
+        }
+
+        int IcmpPing::receive(const sockaddr_storage& address)
+        {
+            uint8_t packet[1500];
+            sockaddr_storage from;
+            socklen_t fromLen = sizeof(from);
+            ssize_t length = recvfrom(sockFd, packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&from), &fromLen);
+            /* nothing more queued, or an error the kernel reported for an earlier probe */
+            if (length < 0)
+                return -2;
+
+            const uint8_t* icmp = packet;
+            if (family == AF_INET)
+            {
+                if (from.ss_family != AF_INET || reinterpret_cast<sockaddr_in*>(&from)->sin_addr.s_addr != reinterpret_cast<const sockaddr_in*>(&address)->sin_addr.s_addr)
+                    return -1;
+                /* raw IPv4 sockets get the IP header too */
+                if (!datagram)
+                {
+                    size_t headerLen = (length > 0) ? static_cast<size_t>(packet[0] & 0x0F) * 4 : 0;
+                    if (headerLen < 20 || static_cast<size_t>(length) < headerLen)
+                        return -1;
+                    icmp += headerLen;
+                    length -= headerLen;
+                }
+            }
+            else if (from.ss_family != AF_INET6 || memcmp(&reinterpret_cast<sockaddr_in6*>(&from)->sin6_addr, &reinterpret_cast<const sockaddr_in6*>(&address)->sin6_addr, sizeof(in6_addr)) != 0)
+                return -1;
+
+            if (length < static_cast<ssize_t>(ICMP_HEADER_SIZE + sizeof(cookie)))
+                return -1;
+            if (icmp[0] != ((family == AF_INET6) ? ICMP6_ECHO_REPLY_TYPE : ICMP_ECHO_REPLY))
+                return -1;
+            if (!datagram && ((icmp[4] << 8) | icmp[5]) != identifier)
+                return -1;
+            if (memcmp(icmp + ICMP_HEADER_SIZE, cookie, sizeof(cookie)) != 0)
+                return -1;
+            return (icmp[6] << 8) | icmp[7];
+        }
+
+        void IcmpPing::summarize(IcmpPingResult& result)
+        {
+            double sum = 0, sumOfSquares = 0;
+            result.received = 0;
+            for (double rtt : result.rtts)
+            {
+                if (rtt < 0)
+                    continue;
+                if (result.received == 0 || rtt < result.min)
+                    result.min = rtt;
+                if (result.received == 0 || rtt > result.max)
+                    result.max = rtt;
+                sum += rtt;
+                sumOfSquares += rtt * rtt;
+                result.received++;
+            }
+            if (result.received > 0)
+            {
+                result.avg = sum / result.received;
+                /* population deviation, what ping prints as mdev */
+                double variance = sumOfSquares / result.received - result.avg * result.avg;
+                result.stddev = (variance > 0) ? std::sqrt(variance) : 0;
+            }
+            if (result.transmitted > 0)
+                result.loss = 100.0 * (result.transmitted - result.received) / result.transmitted;
+        }
+
+        bool IcmpPing::run(const std::string& endpoint, uint32_t count, uint32_t timeoutMs, IcmpPingResult& result, uint32_t intervalMs)
+        {
+            result = IcmpPingResult();
+            count = (count == 0) ? 1 : (count > ICMP_PING_MAX_PROBES) ? ICMP_PING_MAX_PROBES : count;
+            const uint64_t timeoutUs = static_cast<uint64_t>((timeoutMs == 0) ? 1000 : timeoutMs) * 1000;
+            const uint64_t intervalUs = static_cast<uint64_t>(intervalMs) * 1000;
+
+            sockaddr_storage address;
+            socklen_t addressLen = 0;
+            if (!resolve(endpoint, family, address, addressLen))
+            {
+                result.error = "Bad Address";
+                return false;
+            }
+            result.target = addressToString(address);
+
+            if (sockFd < 0 && !open())
+            {
+                result.error = "Could not open ICMP socket";
+                return false;
+            }
+
+            std::vector<uint64_t> sentAt(count, 0);
+            result.rtts.assign(count, -1);
+            uint64_t now = nowUs();
+            uint64_t nextSend = now;
+            uint64_t deadline = 0;
+
+            while (true)
+            {
+                if (cancelled)
+                {
+                    result.error = "Cancelled";
+                    result.rtts.resize(result.transmitted);
+                    break;
+                }
+
+                now = nowUs();
+                if (result.transmitted < count && now >= nextSend)
+                {
+                    uint16_t sequence = static_cast<uint16_t>(result.transmitted);
+                    sentAt[sequence] = now;
+                    send(address, addressLen, sequence);
+                    /* a probe that could not be sent counts as lost, like ping */
+                    result.transmitted++;
+                    nextSend += intervalUs;
+                    if (result.transmitted == count)
+                        deadline = now + timeoutUs;
+                }
+
+                uint32_t answered = 0;
+                uint32_t finished = 0;
+                for (uint32_t i = 0; i < result.transmitted; i++)
+                {
+                    answered += (result.rtts[i] >= 0) ? 1 : 0;
+                    finished += (result.rtts[i] >= 0 || now >= sentAt[i] + timeoutUs) ? 1 : 0;
+                }
+                percent = finished * 100 / count;
+                if (answered == count || (result.transmitted == count && now >= deadline))
+                    break;
+
+                uint64_t wakeUp = (result.transmitted < count) ? nextSend : deadline;
+                int waitMs = (wakeUp > now) ? static_cast<int>((wakeUp - now + 999) / 1000) : 0;
+                if (waitMs > ICMP_CANCEL_CHECK_MS)
+                    waitMs = ICMP_CANCEL_CHECK_MS;
+                struct pollfd pfd = { sockFd, POLLIN, 0 };
+                if (poll(&pfd, 1, waitMs) <= 0 || !(pfd.revents & POLLIN))
+                    continue;
+
+                int sequence;
+                while ((sequence = receive(address)) != -2)
+                {
+                    if (sequence < 0 || static_cast<uint32_t>(sequence) >= result.transmitted || result.rtts[sequence] >= 0)
+                        continue;
+                    uint64_t elapsed = nowUs() - sentAt[sequence];
+                    /* a reply later than the timeout is as good as none */
+                    if (elapsed <= timeoutUs)
+                        result.rtts[sequence] = elapsed / 1000.0;
+                }
+            }
+
+            summarize(result);
+            percent = 100;
+            NMLOG_INFO("ping %s (%s): %u/%u replies, rtt min/avg/max/mdev %.3f/%.3f/%.3f/%.3f ms", endpoint.c_str(), result.target.c_str(),
+                       result.received, result.transmitted, result.min, result.avg, result.max, result.stddev);
+            if (result.received == 0)
+            {
+                if (result.error.empty())
+                    result.error = "Could not ping endpoint";
+                return false;
+            }
+            return result.error.empty();
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+#define ICMP_PING_INTERVAL_MS           200     // between two probes of one run, replies are not waited for
+#define ICMP_PING_MAX_PROBES            100
+#define ICMP_PING_PAYLOAD_SIZE          56      // same as ping, 64 bytes of ICMP
+#define ICMP_CANCEL_CHECK_MS            100     // longest a run waits on its socket before it looks for a cancel
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        struct IcmpPingResult {
+            std::string target;                 /* numeric address the endpoint resolved to */
+            uint32_t transmitted = 0;
+            uint32_t received = 0;
+            std::vector<double> rtts;           /* ms, one per probe in send order, negative when it got no reply */
+            double min = 0;
+            double avg = 0;
+            double max = 0;
+            double stddev = 0;
+            double loss = 100;                  /* percent */
+            std::string error;
+        };
+
+        /*
+         * ICMP echo in process, what ping does without the fork, the shell and the output scraping. Probes go out
+         * every ICMP_PING_INTERVAL_MS on one socket and replies are matched back by sequence, so a run takes
+         * about (count - 1) x interval + one timeout whatever the RTT. An unprivileged ICMP datagram socket is
+         * used when net.ipv4.ping_group_range allows it, a raw socket otherwise. One run at a time per object,
+         * cancel and progress may come from other threads.
+         */
+        class IcmpPing
+        {
+            public:
+                /* AF_INET or AF_INET6 */
+                explicit IcmpPing(int family);
+                ~IcmpPing();
+                /* false when no probe got a reply within timeoutMs of being sent or it was cancelled, result.error says why */
+                bool run(const std::string& endpoint, uint32_t count, uint32_t timeoutMs, IcmpPingResult& result, uint32_t intervalMs = ICMP_PING_INTERVAL_MS);
+                /* from any thread; the run, or the next one, stops with what it has */
+                void cancel() { cancelled = true; }
+                /* from any thread; percent of the probes answered or given up on */
+                uint32_t progress() const { return percent; }
+
+                /* first address of the family for a host name or a numeric address */
+                static bool resolve(const std::string& endpoint, int family, sockaddr_storage& address, socklen_t& addressLen);
+                static std::string addressToString(const sockaddr_storage& address);
+                /* CLOCK_MONOTONIC in microseconds */
+                static uint64_t nowUs();
+                static uint16_t checksum(const uint8_t* data, size_t length);
+
+            private:
+                IcmpPing(const IcmpPing&) = delete;
+                IcmpPing& operator=(const IcmpPing&) = delete;
+
+                bool open();
+                void close();
+                bool send(const sockaddr_storage& address, socklen_t addressLen, uint16_t sequence);
+                /* sequence of an echo reply to this run, -1 for anything else, -2 when nothing is left to read */
+                int receive(const sockaddr_storage& address);
+                static void summarize(IcmpPingResult& result);
+
+                const int family;
+                int sockFd;
+                bool datagram;
+                uint16_t identifier;
+                uint8_t cookie[8];
+                std::atomic<bool> cancelled;
+                std::atomic<uint32_t> percent;
+        };
+    }
+}
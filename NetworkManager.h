@@ -40,6 +40,81 @@ namespace WPEFramework
          */
         class NetworkManager : public PluginHost::IPlugin, public PluginHost::JSONRPC, public PluginHost::ISubSystem::IInternet
         {
+            /**
+             * onAvailableSSIDs parameters; ssids is an unquoted string, it holds the
+             * scan result array text and is written out verbatim. WiFiScanResults::json()
+             * quotes IARM text that is not valid JSON, so the message stays parseable
+             */
+            class AvailableSSIDsParams : public Core::JSON::Container
+            {
+            public:
+                AvailableSSIDsParams(const AvailableSSIDsParams&) = delete;
+                AvailableSSIDsParams& operator=(const AvailableSSIDsParams&) = delete;
+
+                AvailableSSIDsParams()
+                    : Core::JSON::Container()
+                    , ssids(false)
+                {
+                    Add(_T("ssids"), &ssids);
+                }
+                ~AvailableSSIDsParams() override = default;
+
+            public:
+                Core::JSON::String ssids;
+            };
+
+            /**
+             * onWiFiScanDelta parameters; the record arrays are unquoted strings written out verbatim
+             */
+            class WiFiScanDeltaParams : public Core::JSON::Container
+            {
+            public:
+                WiFiScanDeltaParams(const WiFiScanDeltaParams&) = delete;
+                WiFiScanDeltaParams& operator=(const WiFiScanDeltaParams&) = delete;
+
+                WiFiScanDeltaParams()
+                    : Core::JSON::Container()
+                    , added(false)
+                    , changed(false)
+                    , removed(false)
+                {
+                    Add(_T("sequence"), &sequence);
+                    Add(_T("added"), &added);
+                    Add(_T("changed"), &changed);
+                    Add(_T("removed"), &removed);
+                }
+                ~WiFiScanDeltaParams() override = default;
+
+            public:
+                Core::JSON::DecUInt32 sequence;
+                Core::JSON::String added;
+                Core::JSON::String changed;
+                Core::JSON::String removed;
+            };
+
+            /**
+             * onPingResult and onTraceResult parameters; result is an unquoted string, the result JSON written out verbatim
+             */
+            class DiagnosticResultParams : public Core::JSON::Container
+            {
+            public:
+                DiagnosticResultParams(const DiagnosticResultParams&) = delete;
+                DiagnosticResultParams& operator=(const DiagnosticResultParams&) = delete;
+
+                DiagnosticResultParams()
+                    : Core::JSON::Container()
+                    , result(false)
+                {
+                    Add(_T("guid"), &guid);
+                    Add(_T("result"), &result);
+                }
+                ~DiagnosticResultParams() override = default;
+
+            public:
+                Core::JSON::String guid;
+                Core::JSON::String result;
+            };
+
             /**
              * Our notification handling code
              *
@@ -180,12 +255,21 @@ namespace WPEFramework
                 void onAvailableSSIDs(const string jsonOfWiFiScanResults) override
                 {
                     NMLOG_INFO("%s", __FUNCTION__);
-                    JsonArray scanResults;
-                    JsonObject result;
-                    scanResults.FromString(jsonOfWiFiScanResults);
-                    result["ssids"] = scanResults;
+                    /* the scan results are already JSON text, they are embedded as they are instead of parsed and serialized again */
+                    AvailableSSIDsParams result;
+                    result.ssids = jsonOfWiFiScanResults.empty() ? string("[]") : jsonOfWiFiScanResults;
                     _parent.Notify("onAvailableSSIDs", result);
+                }
 
+                void onWiFiScanDelta(const uint32_t sequence, const string& jsonOfAdded, const string& jsonOfChanged, const string& jsonOfRemoved) override
+                {
+                    NMLOG_INFO("%s %u", __FUNCTION__, sequence);
+                    WiFiScanDeltaParams result;
+                    result.sequence = sequence;
+                    result.added = jsonOfAdded.empty() ? string("[]") : jsonOfAdded;
+                    result.changed = jsonOfChanged.empty() ? string("[]") : jsonOfChanged;
+                    result.removed = jsonOfRemoved.empty() ? string("[]") : jsonOfRemoved;
+                    _parent.Notify("onWiFiScanDelta", result);
                 }
 
                 void onWiFiStateChange(const Exchange::INetworkManager::WiFiState state) override
@@ -209,6 +293,25 @@ namespace WPEFramework
                     _parent.Notify("onWiFiSignalStrengthChange", result);
                 }
 
+                // Results of diagnostics started with StartPing and StartTrace
+                void onPingResult(const string guid, const string& jsonOfResult) override
+                {
+                    NMLOG_INFO("%s %s", __FUNCTION__, guid.c_str());
+                    DiagnosticResultParams result;
+                    result.guid = guid;
+                    result.result = jsonOfResult.empty() ? string("{}") : jsonOfResult;
+                    _parent.Notify("onPingResult", result);
+                }
+
+                void onTraceResult(const string guid, const string& jsonOfResult) override
+                {
+                    NMLOG_INFO("%s %s", __FUNCTION__, guid.c_str());
+                    DiagnosticResultParams result;
+                    result.guid = guid;
+                    result.result = jsonOfResult.empty() ? string("{}") : jsonOfResult;
+                    _parent.Notify("onTraceResult", result);
+                }
+
                 // The activated/deactived methods are part of the RPC::IRemoteConnection::INotification
                 // interface. These are triggered when Thunder detects a connection/disconnection over the
                 // COM-RPC link.
@@ -352,11 +455,18 @@ namespace WPEFramework
             uint32_t GetCaptivePortalURI(const JsonObject& parameters, JsonObject& response);
             uint32_t StartConnectivityMonitoring(const JsonObject& parameters, JsonObject& response);
             uint32_t StopConnectivityMonitoring(const JsonObject& parameters, JsonObject& response);
+            uint32_t GetConnectivityStatistics(const JsonObject& parameters, JsonObject& response);
+            uint32_t GetNotificationStatistics(const JsonObject& parameters, JsonObject& response);
             uint32_t GetPublicIP(const JsonObject& parameters, JsonObject& response);
             uint32_t Ping(const JsonObject& parameters, JsonObject& response);
             uint32_t Trace(const JsonObject& parameters, JsonObject& response);
+            uint32_t StartPing(const JsonObject& parameters, JsonObject& response);
+            uint32_t StartTrace(const JsonObject& parameters, JsonObject& response);
+            uint32_t CancelDiagnostic(const JsonObject& parameters, JsonObject& response);
+            uint32_t GetDiagnosticStatus(const JsonObject& parameters, JsonObject& response);
             uint32_t StartWiFiScan(const JsonObject& parameters, JsonObject& response);
             uint32_t StopWiFiScan(const JsonObject& parameters, JsonObject& response);
+            uint32_t GetWiFiScanTable(const JsonObject& parameters, JsonObject& response);
             uint32_t GetKnownSSIDs(const JsonObject& parameters, JsonObject& response);
             uint32_t AddToKnownSSIDs(const JsonObject& parameters, JsonObject& response);
             uint32_t RemoveKnownSSID(const JsonObject& parameters, JsonObject& response);
@@ -23,6 +23,10 @@
 #include <arpa/inet.h>
 #include <stdbool.h>
 #include <fstream>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #include "NetworkManagerImplementation.h"
 #include "NetworkManagerConnectivity.h"
@@ -90,17 +94,6 @@ namespace WPEFramework
         return readStrings;
     }
 
-    TestConnectivity::TestConnectivity(const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion)
-    {
-        internetSate = UNKNOWN;
-        if(endpoints.size() < 1) {
-            NMLOG_ERROR("Endpoints size error ! curl check not possible");
-            return;
-        }
-
-        internetSate = checkCurlResponse(endpoints, timeout_ms, headReq, ipversion);
-    }
-
     static bool curlVerboseEnabled() {
         std::ifstream fileStream("/tmp/nm.plugin.debug");
         return fileStream.is_open();
@@ -119,139 +112,843 @@ namespace WPEFramework
         return size * nmemb;
     }
 
-    nsm_internetState TestConnectivity::checkCurlResponse(const std::vector<std::string>& endpoints, long timeout_ms,  bool headReq, nsm_ipversion ipversion)
+    /*
+     * incremental form of the checkInternetStateFromResponseCode vote. decided when the leading code
+     * already has half of all the endpoints and the pending responses can not catch it up, or when no
+     * code can reach half any more (NO_INTERNET). voting the partial responses gives the same verdict.
+     */
+    static bool isVoteDecided(const std::vector<int>& responses, int endpointCount)
+    {
+        int remaining = endpointCount - static_cast<int>(responses.size());
+        if (remaining <= 0)
+            return true;
+
+        std::map<int, int> codeCount;
+        for (int code : responses)
+            codeCount[code]++;
+        int leading = 0, second = 0;
+        for (const auto& code : codeCount)
+        {
+            if (code.second > leading) {
+                second = leading;
+                leading = code.second;
+            }
+            else if (code.second > second)
+                second = code.second;
+        }
+
+        if (leading * 2 >= endpointCount && leading > second + remaining)
+            return true;
+        return (leading + remaining) * 2 < endpointCount;
+    }
+
+    static ProbeErrorClass classifyCurlError(CURLcode curlResult)
+    {
+        switch (curlResult)
+        {
+            case CURLE_OK:
+                return PROBE_ERROR_NONE;
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_RESOLVE_PROXY:
+                return PROBE_ERROR_DNS;
+            case CURLE_COULDNT_CONNECT:
+                return PROBE_ERROR_CONNECT;
+            case CURLE_OPERATION_TIMEDOUT:
+                return PROBE_ERROR_TIMEOUT;
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_PEER_FAILED_VERIFICATION:
+            case CURLE_SSL_CERTPROBLEM:
+            case CURLE_SSL_CIPHER:
+            case CURLE_SSL_CACERT_BADFILE:
+            case CURLE_SSL_ISSUER_ERROR:
+                return PROBE_ERROR_TLS;
+            default:
+                return PROBE_ERROR_OTHER;
+        }
+    }
+
+    TestConnectivity::TestConnectivity(ConnectivityProbeEngine& probeEngine, const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion, bool earlyQuorum)
     {
-        long deadline = current_time() + timeout_ms, time_now = 0, time_earlier = 0;
+        internetSate = UNKNOWN;
+        decisionLatencyMs = 0;
+        confidence = 0;
+        if(endpoints.size() < 1) {
+            NMLOG_ERROR("Endpoints size error ! curl check not possible");
+            return;
+        }
 
-        CURLM *curl_multi_handle = curl_multi_init();
-        if (!curl_multi_handle)
+        ProbeResult result = probeEngine.probe(endpoints, timeout_ms, headReq, ipversion, earlyQuorum);
+        captivePortalURI = result.captivePortalURI;
+        decisionLatencyMs = result.decisionLatencyMs;
+        if(!result.aborted)
+            internetSate = checkInternetStateFromResponseCode(result.responses);
+    }
+
+    TestConnectivity::TestConnectivity(const ProbeResult& probeResult)
+    {
+        internetSate = UNKNOWN;
+        confidence = 0;
+        captivePortalURI = probeResult.captivePortalURI;
+        decisionLatencyMs = probeResult.decisionLatencyMs;
+        if(!probeResult.aborted && !probeResult.responses.empty())
+            internetSate = checkInternetStateFromResponseCode(probeResult.responses);
+    }
+
+    ConnectivityProbeEngine::ConnectivityProbeEngine()
+        : reactorRunning(false)
+        , epollFd(-1)
+        , wakeupFd(-1)
+        , curlTimerFd(-1)
+        , taskTimerFd(-1)
+        , nextTaskId(0)
+        , nextProbeId(0)
+        , multiHandle(nullptr)
+        , curlShare(nullptr)
+        , curlHeaders(nullptr)
+        , activeTransfers(0)
+        , poolGeneration(0)
+        , recyclePending(false)
+        , resetGeneration(0)
+        , statProbes(0)
+        , statTransfers(0)
+        , statNewConnections(0)
+        , statReusedConnections(0)
+        , statHandshakeSavedMs(0)
+        , statLastProbeSavedMs(0)
+        , statEarlyDecisions(0)
+        , statCancelledTransfers(0)
+        , statLastDecisionLatencyMs(0)
+    {
+        /* the multi handle already shares DNS and connections between its transfers; keep TLS sessions too */
+        curlShare = curl_share_init();
+        if (curlShare)
+            curl_share_setopt(curlShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        else
+            NMLOG_ERROR("curl_share_init returned NULL; TLS sessions will not be shared");
+
+        curlHeaders = curl_slist_append(curlHeaders, "Cache-Control: no-cache, no-store");
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        curlTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        taskTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (epollFd < 0 || wakeupFd < 0 || curlTimerFd < 0 || taskTimerFd < 0)
+        {
+            NMLOG_ERROR("connectivity reactor fd creation failed: %s", strerror(errno));
+            return;
+        }
+
+        for (int fd : {wakeupFd, curlTimerFd, taskTimerFd})
+        {
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+
+        if (!createMultiHandle())
+            return;
+
+        reactorRunning = true;
+        reactorThread = std::thread(&ConnectivityProbeEngine::reactorFunction, this);
+        reactorThreadId = reactorThread.get_id();
+    }
+
+    ConnectivityProbeEngine::~ConnectivityProbeEngine()
+    {
+        stop();
+        dropIdleHandles();
+        if (multiHandle)
+            curl_multi_cleanup(multiHandle);
+        if (curlShare)
+            curl_share_cleanup(curlShare);
+        curl_slist_free_all(curlHeaders);
+        for (int fd : {epollFd, wakeupFd, curlTimerFd, taskTimerFd})
+        {
+            if (fd >= 0)
+                close(fd);
+        }
+    }
+
+    void ConnectivityProbeEngine::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!reactorRunning)
+                return;
+            reactorRunning = false;
+        }
+        uint64_t wake = 1;
+        if (write(wakeupFd, &wake, sizeof(wake)) < 0)
+            NMLOG_ERROR("connectivity reactor wakeup failed: %s", strerror(errno));
+        if (reactorThread.joinable() && !isReactorThread())
+            reactorThread.join();
+        NMLOG_DEBUG("connectivity reactor stopped");
+    }
+
+    bool ConnectivityProbeEngine::createMultiHandle()
+    {
+        multiHandle = curl_multi_init();
+        if (!multiHandle)
         {
             NMLOG_ERROR("curl_multi_init returned NULL");
-            return NO_INTERNET;
+            return false;
         }
+        curl_multi_setopt(multiHandle, CURLMOPT_SOCKETFUNCTION, socketCallback);
+        curl_multi_setopt(multiHandle, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multiHandle, CURLMOPT_TIMERFUNCTION, timerCallback);
+        curl_multi_setopt(multiHandle, CURLMOPT_TIMERDATA, this);
+        return true;
+    }
 
-        CURLMcode mc;
-        std::vector<CURL*> curl_easy_handles;
-        std::vector<int> http_responses;
-        struct curl_slist *chunk = NULL;
-        chunk = curl_slist_append(chunk, "Cache-Control: no-cache, no-store");
-        chunk = curl_slist_append(chunk, "Connection: close");
-        for (const auto& endpoint : endpoints)
+    int ConnectivityProbeEngine::socketCallback(CURL *easy, curl_socket_t sockfd, int what, void *userp, void *socketp)
+    {
+        ConnectivityProbeEngine *engine = static_cast<ConnectivityProbeEngine*>(userp);
+        if (what == CURL_POLL_REMOVE)
         {
-            CURL *curl_easy_handle = curl_easy_init();
-            if (!curl_easy_handle)
+            epoll_ctl(engine->epollFd, EPOLL_CTL_DEL, sockfd, NULL);
+            return 0;
+        }
+
+        struct epoll_event ev = {};
+        ev.data.fd = sockfd;
+        if (what & CURL_POLL_IN)
+            ev.events |= EPOLLIN;
+        if (what & CURL_POLL_OUT)
+            ev.events |= EPOLLOUT;
+        if (epoll_ctl(engine->epollFd, EPOLL_CTL_MOD, sockfd, &ev) < 0 && errno == ENOENT)
+        {
+            if (epoll_ctl(engine->epollFd, EPOLL_CTL_ADD, sockfd, &ev) < 0)
+                NMLOG_ERROR("epoll add socket %d failed: %s", sockfd, strerror(errno));
+        }
+        return 0;
+    }
+
+    int ConnectivityProbeEngine::timerCallback(CURLM *multi, long timeout_ms, void *userp)
+    {
+        ConnectivityProbeEngine *engine = static_cast<ConnectivityProbeEngine*>(userp);
+        struct itimerspec its = {};
+        if (timeout_ms > 0)
+        {
+            its.it_value.tv_sec = timeout_ms / 1000;
+            its.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+        }
+        else if (timeout_ms == 0)
+            its.it_value.tv_nsec = 1; /* expire right away, socket_action must not be called from the callback */
+        /* timeout_ms -1 disarms the timer */
+        timerfd_settime(engine->curlTimerFd, 0, &its, NULL);
+        return 0;
+    }
+
+    void ConnectivityProbeEngine::reactorFunction()
+    {
+        struct epoll_event events[NMCONNECTIVITY_REACTOR_MAX_EVENTS];
+        int running = 0;
+        uint64_t counter = 0;
+
+        NMLOG_DEBUG("connectivity reactor started");
+        while (reactorRunning)
+        {
+            int count = epoll_wait(epollFd, events, NMCONNECTIVITY_REACTOR_MAX_EVENTS, -1);
+            if (count < 0)
             {
-                NMLOG_ERROR("endpoint = <%s> curl_easy_init returned NULL", endpoint.c_str());
-                continue;
+                if (errno == EINTR)
+                    continue;
+                NMLOG_ERROR("epoll_wait failed: %s", strerror(errno));
+                break;
             }
-            curl_easy_setopt(curl_easy_handle, CURLOPT_URL, endpoint.c_str());
-            curl_easy_setopt(curl_easy_handle, CURLOPT_PRIVATE, endpoint.c_str());
-            /* set our custom set of headers */
-            curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPHEADER, chunk);
-            curl_easy_setopt(curl_easy_handle, CURLOPT_USERAGENT, "RDKCaptiveCheck/1.0");
-            if(!headReq)
+
+            for (int i = 0; i < count; i++)
             {
-                /* HTTPGET request added insted of HTTPHEAD request fix for DELIA-61526 */
-                curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPGET, 1L);
+                int fd = events[i].data.fd;
+                if (fd == wakeupFd)
+                {
+                    if (read(wakeupFd, &counter, sizeof(counter)) > 0)
+                        runPostedWork();
+                }
+                else if (fd == curlTimerFd)
+                {
+                    if (read(curlTimerFd, &counter, sizeof(counter)) > 0)
+                        curl_multi_socket_action(multiHandle, CURL_SOCKET_TIMEOUT, 0, &running);
+                }
+                else if (fd == taskTimerFd)
+                {
+                    if (read(taskTimerFd, &counter, sizeof(counter)) > 0)
+                        runDueTasks();
+                }
+                else
+                {
+                    int action = 0;
+                    if (events[i].events & EPOLLIN)
+                        action |= CURL_CSELECT_IN;
+                    if (events[i].events & EPOLLOUT)
+                        action |= CURL_CSELECT_OUT;
+                    if (events[i].events & (EPOLLERR | EPOLLHUP))
+                        action |= CURL_CSELECT_ERR;
+                    curl_multi_socket_action(multiHandle, fd, action, &running);
+                }
+            }
+            processCompletedTransfers();
+        }
+
+        abortProbes();
+        NMLOG_DEBUG("connectivity reactor exit");
+    }
+
+    bool ConnectivityProbeEngine::post(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!reactorRunning)
+                return false;
+            postedTasks.push_back(task);
+        }
+        uint64_t wake = 1;
+        if (write(wakeupFd, &wake, sizeof(wake)) < 0)
+            NMLOG_ERROR("connectivity reactor wakeup failed: %s", strerror(errno));
+        return true;
+    }
+
+    uint32_t ConnectivityProbeEngine::schedule(long delay_ms, Task task)
+    {
+        uint32_t taskId = 0;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!reactorRunning)
+                return 0;
+            taskId = ++nextTaskId;
+            if (taskId == 0) /* 0 is used as no task */
+                taskId = ++nextTaskId;
+            ScheduledTask scheduled;
+            scheduled.deadline = current_time() + (delay_ms > 0 ? delay_ms : 0);
+            scheduled.task = task;
+            scheduledTasks[taskId] = scheduled;
+        }
+        armTaskTimer();
+        return taskId;
+    }
+
+    void ConnectivityProbeEngine::cancel(uint32_t taskId)
+    {
+        if (taskId == 0)
+            return;
+        std::lock_guard<std::mutex> lock(queueMutex);
+        scheduledTasks.erase(taskId);
+        /* an already armed timer firing without due task is harmless */
+    }
+
+    void ConnectivityProbeEngine::armTaskTimer()
+    {
+        long deadline = -1;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (const auto& scheduled : scheduledTasks)
+            {
+                if (deadline < 0 || scheduled.second.deadline < deadline)
+                    deadline = scheduled.second.deadline;
+            }
+        }
+
+        struct itimerspec its = {};
+        if (deadline >= 0)
+        {
+            /* absolute monotonic expiry; a zero value would disarm the timer */
+            its.it_value.tv_sec = deadline / 1000;
+            its.it_value.tv_nsec = (deadline % 1000) * 1000000 + 1;
+        }
+        timerfd_settime(taskTimerFd, TFD_TIMER_ABSTIME, &its, NULL);
+    }
+
+    void ConnectivityProbeEngine::runPostedWork()
+    {
+        std::vector<Task> tasks;
+        std::vector<ProbeRequest*> requests;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.swap(postedTasks);
+            requests.swap(pendingRequests);
+        }
+        for (auto& task : tasks)
+            task();
+        for (auto request : requests)
+            startProbe(request);
+    }
+
+    void ConnectivityProbeEngine::runDueTasks()
+    {
+        std::vector<Task> dueTasks;
+        long now = current_time();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (auto it = scheduledTasks.begin(); it != scheduledTasks.end(); )
+            {
+                if (it->second.deadline <= now)
+                {
+                    dueTasks.push_back(it->second.task);
+                    it = scheduledTasks.erase(it);
+                }
+                else
+                    ++it;
             }
-            curl_easy_setopt(curl_easy_handle, CURLOPT_WRITEFUNCTION, writeFunction);
-            curl_easy_setopt(curl_easy_handle, CURLOPT_TIMEOUT_MS, deadline - current_time());
-            if ((ipversion == CURL_IPRESOLVE_V4) || (ipversion == CURL_IPRESOLVE_V6))
+        }
+        armTaskTimer();
+        for (auto& task : dueTasks)
+            task();
+    }
+
+    uint32_t ConnectivityProbeEngine::submitProbe(const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion, bool earlyQuorum, ProbeCallback callback)
+    {
+        ProbeRequest *request = new ProbeRequest();
+        request->endpoints = endpoints;
+        request->timeout_ms = timeout_ms;
+        request->headReq = headReq;
+        request->ipversion = ipversion;
+        request->earlyQuorum = earlyQuorum;
+        request->startTime = current_time();
+        request->callback = callback;
+        request->result.endpointCount = static_cast<int>(endpoints.size());
+        request->pending = 0;
+        uint32_t probeId = 0;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!reactorRunning)
             {
-                NMLOG_INFO("curlopt ipversion = %s reqtyp = %s", ipversion == CURL_IPRESOLVE_V4?"ipv4 only":"ipv6 only", headReq? "HEAD":"GET");
-                curl_easy_setopt(curl_easy_handle, CURLOPT_IPRESOLVE, ipversion);
+                delete request;
+                return 0;
             }
+            probeId = ++nextProbeId;
+            if (probeId == 0) /* 0 is used as no probe */
+                probeId = ++nextProbeId;
+            request->id = probeId;
+            pendingRequests.push_back(request);
+        }
+        uint64_t wake = 1;
+        if (write(wakeupFd, &wake, sizeof(wake)) < 0)
+            NMLOG_ERROR("connectivity reactor wakeup failed: %s", strerror(errno));
+        return probeId;
+    }
+
+    void ConnectivityProbeEngine::cancelProbe(uint32_t probeId)
+    {
+        if (probeId == 0)
+            return;
+        if (isReactorThread())
+            dropProbe(probeId);
+        else
+            post([this, probeId]() { dropProbe(probeId); });
+    }
+
+    void ConnectivityProbeEngine::dropProbe(uint32_t probeId)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            for (auto it = pendingRequests.begin(); it != pendingRequests.end(); ++it)
+            {
+                if ((*it)->id == probeId)
+                {
+                    delete *it;
+                    pendingRequests.erase(it);
+                    return;
+                }
+            }
+        }
+        for (auto request : activeRequests)
+        {
+            if (request->id == probeId)
+            {
+                cancelTransfers(request);
+                activeRequests.remove(request);
+                delete request;
+                return;
+            }
+        }
+    }
+
+    ProbeResult ConnectivityProbeEngine::probe(const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion, bool earlyQuorum)
+    {
+        ProbeResult result;
+        result.aborted = true;
+        if (isReactorThread())
+        {
+            NMLOG_ERROR("blocking probe requested on the connectivity reactor thread");
+            return result;
+        }
+
+        std::mutex resultMutex;
+        std::condition_variable resultCv;
+        bool done = false;
+        bool submitted = submitProbe(endpoints, timeout_ms, headReq, ipversion, earlyQuorum, [&](const ProbeResult& probeResult) {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            result = probeResult;
+            done = true;
+            resultCv.notify_one();
+        });
+        if (!submitted)
+        {
+            NMLOG_ERROR("connectivity reactor not running, probe not possible");
+            return result;
+        }
+
+        std::unique_lock<std::mutex> lock(resultMutex);
+        resultCv.wait(lock, [&done]() { return done; });
+        return result;
+    }
+
+    CURL* ConnectivityProbeEngine::acquireEasyHandle(const std::string& poolKey, const std::string& endpoint, nsm_ipversion ipversion)
+    {
+        auto it = idleHandles.find(poolKey);
+        if (it != idleHandles.end())
+        {
+            CURL *curl_easy_handle = it->second;
+            idleHandles.erase(it);
+            return curl_easy_handle;
+        }
+
+        CURL *curl_easy_handle = curl_easy_init();
+        if (!curl_easy_handle)
+        {
+            NMLOG_ERROR("endpoint = <%s> curl_easy_init returned NULL", endpoint.c_str());
+            return nullptr;
+        }
+
+        curl_easy_setopt(curl_easy_handle, CURLOPT_URL, endpoint.c_str());
+        /* set our custom set of headers */
+        curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPHEADER, curlHeaders);
+        curl_easy_setopt(curl_easy_handle, CURLOPT_USERAGENT, "RDKCaptiveCheck/1.0");
+        curl_easy_setopt(curl_easy_handle, CURLOPT_WRITEFUNCTION, writeFunction);
+        curl_easy_setopt(curl_easy_handle, CURLOPT_NOSIGNAL, 1L);
+        /* keep the connection open for the next check */
+        curl_easy_setopt(curl_easy_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl_easy_handle, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(NMCONNECTIVITY_CURL_DNS_CACHE_TIMEOUT));
+    #if LIBCURL_VERSION_NUM >= 0x074100
+        curl_easy_setopt(curl_easy_handle, CURLOPT_MAXAGE_CONN, static_cast<long>(NMCONNECTIVITY_CURL_MAX_CONNECTION_AGE));
+    #endif
+        if (curlShare)
+            curl_easy_setopt(curl_easy_handle, CURLOPT_SHARE, curlShare);
+        if ((ipversion == CURL_IPRESOLVE_V4) || (ipversion == CURL_IPRESOLVE_V6))
+            curl_easy_setopt(curl_easy_handle, CURLOPT_IPRESOLVE, ipversion);
+
+        return curl_easy_handle;
+    }
+
+    void ConnectivityProbeEngine::releaseEasyHandle(const ProbeTransfer& transfer)
+    {
+        if (transfer.generation != poolGeneration || idleHandles.count(transfer.poolKey) >= NMCONNECTIVITY_CURL_MAX_IDLE_HANDLES)
+        {
+            curl_easy_cleanup(transfer.easyHandle);
+            return;
+        }
+        idleHandles.insert(std::make_pair(transfer.poolKey, transfer.easyHandle));
+    }
+
+    void ConnectivityProbeEngine::dropIdleHandles()
+    {
+        for (auto& handle : idleHandles)
+            curl_easy_cleanup(handle.second);
+        idleHandles.clear();
+        handshakeCostMs.clear();
+    }
+
+    /* closes every cached connection and the DNS cache, only called when no transfer is running */
+    void ConnectivityProbeEngine::recycleConnections()
+    {
+        recyclePending = false;
+        curl_multi_cleanup(multiHandle);
+        multiHandle = nullptr;
+        timerCallback(nullptr, -1, this);
+        createMultiHandle();
+        NMLOG_DEBUG("connectivity probe connections recycled");
+    }
+
+    void ConnectivityProbeEngine::startProbe(ProbeRequest *request)
+    {
+        if (poolGeneration != resetGeneration.load())
+        {
+            NMLOG_DEBUG("connectivity probe pool reset, dropping cached connections");
+            poolGeneration = resetGeneration.load();
+            dropIdleHandles();
+            if (activeTransfers == 0)
+                recycleConnections();
             else
+                recyclePending = true;
+        }
+
+        if (!multiHandle)
+        {
+            request->result.aborted = true;
+            request->callback(request->result);
+            delete request;
+            return;
+        }
+
+        bool verbose = curlVerboseEnabled();
+        nsm_ipversion ipversion = request->ipversion;
+        if ((ipversion == CURL_IPRESOLVE_V4) || (ipversion == CURL_IPRESOLVE_V6))
+            NMLOG_INFO("curlopt ipversion = %s reqtyp = %s", ipversion == CURL_IPRESOLVE_V4?"ipv4 only":"ipv6 only", request->headReq? "HEAD":"GET");
+        else
+            NMLOG_INFO("curlopt ipversion = whatever reqtyp = %s", request->headReq? "HEAD":"GET");
+
+        activeRequests.push_back(request);
+        for (const auto& endpoint : request->endpoints)
+        {
+            std::string poolKey = std::to_string(static_cast<int>(ipversion)) + endpoint;
+            CURL *curl_easy_handle = acquireEasyHandle(poolKey, endpoint, ipversion);
+            if (!curl_easy_handle)
+                continue;
+
+            request->transfers.push_back(ProbeTransfer{request, endpoint, poolKey, poolGeneration, curl_easy_handle});
+            ProbeTransfer& transfer = request->transfers.back();
+            curl_easy_setopt(curl_easy_handle, CURLOPT_PRIVATE, &transfer);
+            if(!request->headReq)
             {
-                NMLOG_INFO("curlopt ipversion = whatever reqtyp = %s", headReq? "HEAD":"GET");
+                /* HTTPGET request added insted of HTTPHEAD request fix for DELIA-61526 */
+                curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPGET, 1L);
             }
-            if(curlVerboseEnabled())
-                curl_easy_setopt(curl_easy_handle, CURLOPT_VERBOSE, 1L);
-            if (CURLM_OK != (mc = curl_multi_add_handle(curl_multi_handle, curl_easy_handle)))
+            curl_easy_setopt(curl_easy_handle, CURLOPT_TIMEOUT_MS, request->timeout_ms);
+            curl_easy_setopt(curl_easy_handle, CURLOPT_VERBOSE, verbose ? 1L : 0L);
+            /* old connections are still cached in the multi handle until the running transfers are done */
+            curl_easy_setopt(curl_easy_handle, CURLOPT_FRESH_CONNECT, recyclePending ? 1L : 0L);
+
+            CURLMcode mc = curl_multi_add_handle(multiHandle, curl_easy_handle);
+            if (CURLM_OK != mc)
             {
                 NMLOG_ERROR("endpoint = <%s> curl_multi_add_handle returned %d (%s)", endpoint.c_str(), mc, curl_multi_strerror(mc));
                 curl_easy_cleanup(curl_easy_handle);
+                request->transfers.pop_back();
                 continue;
             }
-            curl_easy_handles.push_back(curl_easy_handle);
+            request->pending++;
+            activeTransfers++;
         }
-        int handles, msgs_left;
+
+        if (request->pending == 0)
+            completeProbe(request);
+    }
+
+    void ConnectivityProbeEngine::processCompletedTransfers()
+    {
+        CURLMsg *msg = nullptr;
+        int msgs_left = 0;
         char *url = nullptr;
-    #if LIBCURL_VERSION_NUM < 0x074200
-        int numfds, repeats = 0;
-    #endif
-        char *endpoint = nullptr;
-        while (1)
+
+        while (multiHandle && NULL != (msg = curl_multi_info_read(multiHandle, &msgs_left)))
         {
-            if (CURLM_OK != (mc = curl_multi_perform(curl_multi_handle, &handles)))
-            {
-                NMLOG_ERROR("curl_multi_perform returned %d (%s)", mc, curl_multi_strerror(mc));
-                break;
-            }
-            for (CURLMsg *msg; NULL != (msg = curl_multi_info_read(curl_multi_handle, &msgs_left)); )
-            {
-                long response_code = -1;
-                if (msg->msg != CURLMSG_DONE)
-                    continue;
-                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &endpoint);
-                if (CURLE_OK == msg->data.result) {
-                    if (curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code) == CURLE_OK)
-                    {
-                        if (HttpStatus_302_Found == response_code) {
-                            if ( (curl_easy_getinfo(msg->easy_handle, CURLINFO_REDIRECT_URL, &url) == CURLE_OK) && url != nullptr) {
-                                NMLOG_INFO("captive portal found !!!");
-                                captivePortalURI = url;
-                            }
+            long response_code = -1;
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CURL *curl_easy_handle = msg->easy_handle;
+            CURLcode curlResult = msg->data.result;
+            char *privateData = nullptr;
+            curl_easy_getinfo(curl_easy_handle, CURLINFO_PRIVATE, &privateData);
+            ProbeTransfer *transfer = reinterpret_cast<ProbeTransfer*>(privateData);
+            ProbeRequest *request = transfer->request;
+            ProbeResult& result = request->result;
+            ProbeTransferSample sample;
+            sample.endpoint = transfer->endpoint;
+            sample.ipversion = request->ipversion;
+
+            if (CURLE_OK == curlResult) {
+                if (curl_easy_getinfo(curl_easy_handle, CURLINFO_RESPONSE_CODE, &response_code) == CURLE_OK)
+                {
+                    if (HttpStatus_302_Found == response_code) {
+                        if ( (curl_easy_getinfo(curl_easy_handle, CURLINFO_REDIRECT_URL, &url) == CURLE_OK) && url != nullptr) {
+                            NMLOG_INFO("captive portal found !!!");
+                            result.captivePortalURI = url;
+                            result.captiveStatusCode = response_code;
                         }
                     }
+                    else if (HttpStatus_511_Authentication_Required == response_code && result.captiveStatusCode == 0)
+                        result.captiveStatusCode = response_code;
+                }
+
+                /* connection accounting; a reused connection skipped DNS, TCP and TLS handshakes */
+                long newConnects = 0;
+                curl_off_t nameLookupTime = 0, connectTime = 0, appConnectTime = 0, startTransferTime = 0, totalTime = 0;
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_NUM_CONNECTS, &newConnects);
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookupTime);
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_CONNECT_TIME_T, &connectTime);
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_APPCONNECT_TIME_T, &appConnectTime);
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_STARTTRANSFER_TIME_T, &startTransferTime);
+                curl_easy_getinfo(curl_easy_handle, CURLINFO_TOTAL_TIME_T, &totalTime);
+                if (newConnects > 0)
+                {
+                    result.newConnections++;
+                    handshakeCostMs[transfer->poolKey] = static_cast<long>(std::max(connectTime, appConnectTime) / 1000);
                 }
                 else
-                    NMLOG_ERROR("endpoint = <%s> curl error = %d (%s)", endpoint, msg->data.result, curl_easy_strerror(msg->data.result));
-                http_responses.push_back(response_code);
-            }
-            time_earlier = time_now;
-            time_now = current_time();
-            if (handles == 0 || time_now >= deadline)
-                break;
-    #if LIBCURL_VERSION_NUM < 0x074200
-            if (CURLM_OK != (mc = curl_multi_wait(curl_multi_handle, NULL, 0, deadline - time_now, &numfds)))
-            {
-                LOGERR("curl_multi_wait returned %d (%s)", mc, curl_multi_strerror(mc));
-                break;
+                {
+                    result.reusedConnections++;
+                    result.handshakeSavedMs += handshakeCostMs[transfer->poolKey];
+                }
+
+                /* curl times are cumulative from the transfer start, split them into phases */
+                curl_off_t handshakeDone = std::max(connectTime, appConnectTime);
+                sample.reusedConnection = (newConnects == 0);
+                sample.dnsUs = static_cast<long>(nameLookupTime);
+                sample.connectUs = static_cast<long>(connectTime > nameLookupTime ? connectTime - nameLookupTime : 0);
+                sample.tlsUs = static_cast<long>(appConnectTime > connectTime ? appConnectTime - connectTime : 0);
+                sample.ttfbUs = static_cast<long>(startTransferTime > handshakeDone ? startTransferTime - handshakeDone : 0);
+                sample.totalUs = static_cast<long>(totalTime);
+                if (response_code >= 400 && HttpStatus_511_Authentication_Required != response_code)
+                    sample.errorClass = PROBE_ERROR_HTTP;
             }
-            if (numfds == 0)
+            else
             {
-                repeats++;
-                if (repeats > 1)
-                    usleep(10*1000); /* sleep 10 ms */
+                NMLOG_ERROR("endpoint = <%s> curl error = %d (%s)", transfer->endpoint.c_str(), curlResult, curl_easy_strerror(curlResult));
+                sample.errorClass = classifyCurlError(curlResult);
             }
-            else
-                repeats = 0;
-    #else
-            if (CURLM_OK != (mc = curl_multi_poll(curl_multi_handle, NULL, 0, deadline - time_now, NULL)))
+            result.responses.push_back(response_code);
+            sample.responseCode = response_code;
+            result.samples.push_back(sample);
+
+            /* handle goes back to the pool, the connection stays alive in the multi handle cache */
+            curl_multi_remove_handle(multiHandle, curl_easy_handle);
+            activeTransfers--;
+            releaseEasyHandle(*transfer);
+            transfer->easyHandle = nullptr;
+            if (--request->pending == 0)
+                completeProbe(request);
+            else if (request->earlyQuorum && isVoteDecided(result.responses, result.endpointCount))
             {
-                NMLOG_ERROR("curl_multi_poll returned %d (%s)", mc, curl_multi_strerror(mc));
-                break;
+                result.earlyDecision = true;
+                cancelTransfers(request);
+                completeProbe(request);
             }
-    #endif
         }
 
+        if (recyclePending && activeTransfers == 0)
+            recycleConnections();
+    }
+
+    void ConnectivityProbeEngine::completeProbe(ProbeRequest *request)
+    {
+        ProbeResult& result = request->result;
+        activeRequests.remove(request);
+        result.decisionLatencyMs = current_time() - request->startTime;
         if(curlVerboseEnabled()) {
-            NMLOG_DEBUG("endpoints count = %d response count %d, handles = %d, deadline = %ld, time_now = %ld, time_earlier = %ld",
-                static_cast<int>(endpoints.size()), static_cast<int>(http_responses.size()), handles, deadline, time_now, time_earlier);
+            NMLOG_DEBUG("endpoints count = %d response count %d", static_cast<int>(request->endpoints.size()), static_cast<int>(result.responses.size()));
         }
 
-        for (const auto& curl_easy_handle : curl_easy_handles)
+        statProbes++;
+        statTransfers += result.newConnections + result.reusedConnections;
+        statNewConnections += result.newConnections;
+        statReusedConnections += result.reusedConnections;
+        statHandshakeSavedMs += result.handshakeSavedMs;
+        statLastProbeSavedMs = result.handshakeSavedMs;
+        statLastDecisionLatencyMs = result.decisionLatencyMs;
+        if (result.earlyDecision)
         {
-            curl_easy_getinfo(curl_easy_handle, CURLINFO_PRIVATE, &endpoint);
-            //LOG_DBG("endpoint = <%s> terminating attempt", endpoint);
-            curl_multi_remove_handle(curl_multi_handle, curl_easy_handle);
-            curl_easy_cleanup(curl_easy_handle);
+            statEarlyDecisions++;
+            NMLOG_INFO("connectivity verdict decided in %ld ms with %d of %d responses", result.decisionLatencyMs,
+                                        static_cast<int>(result.responses.size()), result.endpointCount);
         }
-        curl_multi_cleanup(curl_multi_handle);
-        /* free the custom headers */
-        curl_slist_free_all(chunk);
-        return checkInternetStateFromResponseCode(http_responses);
+        NMLOG_DEBUG("probe connections new = %d reused = %d, handshake saved = %ld ms", result.newConnections, result.reusedConnections, result.handshakeSavedMs);
+
+        updateCaptivePortalRecord(request);
+        if (probeObserver)
+            probeObserver(result);
+        if (request->callback)
+            request->callback(result);
+        delete request;
+    }
+
+    void ConnectivityProbeEngine::updateCaptivePortalRecord(const ProbeRequest *request)
+    {
+        const ProbeResult& result = request->result;
+        bool noContent = std::find(result.responses.begin(), result.responses.end(), HttpStatus_204_No_Content) != result.responses.end();
+        if (result.captiveStatusCode == 0 && !noContent)
+            return; /* nothing conclusive about a portal */
+
+        long now = current_time();
+        std::lock_guard<std::mutex> lock(captiveMutex);
+        captiveRecord.updateTime = now;
+        if (result.captiveStatusCode != 0)
+        {
+            if (!captiveRecord.active || captiveRecord.uri != result.captivePortalURI)
+                captiveRecord.detectedTime = now;
+            captiveRecord.active = true;
+            captiveRecord.uri = result.captivePortalURI;
+            captiveRecord.statusCode = result.captiveStatusCode;
+            captiveRecord.ipversion = request->ipversion;
+            captiveRecord.lastSeenTime = now;
+        }
+        else if (captiveRecord.active)
+        {
+            NMLOG_INFO("captive portal no longer seen");
+            captiveRecord.active = false;
+        }
+    }
+
+    CaptivePortalRecord ConnectivityProbeEngine::getCaptivePortalRecord() const
+    {
+        std::lock_guard<std::mutex> lock(captiveMutex);
+        return captiveRecord;
+    }
+
+    /* verdict is already decided, the transfers still running cannot change it */
+    void ConnectivityProbeEngine::cancelTransfers(ProbeRequest *request)
+    {
+        for (auto& transfer : request->transfers)
+        {
+            if (!transfer.easyHandle)
+                continue;
+            /* the half done connection is closed by curl, the easy handle is reusable */
+            curl_multi_remove_handle(multiHandle, transfer.easyHandle);
+            activeTransfers--;
+            statCancelledTransfers++;
+            releaseEasyHandle(transfer);
+            transfer.easyHandle = nullptr;
+        }
+        request->pending = 0;
+    }
+
+    /* reactor is exiting; complete every probe as aborted so no waiter is left behind */
+    void ConnectivityProbeEngine::abortProbes()
+    {
+        std::vector<ProbeRequest*> requests;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            requests.swap(pendingRequests);
+            postedTasks.clear();
+            scheduledTasks.clear();
+        }
+        for (auto request : activeRequests)
+        {
+            for (auto& transfer : request->transfers)
+            {
+                if (!transfer.easyHandle)
+                    continue;
+                curl_multi_remove_handle(multiHandle, transfer.easyHandle);
+                curl_easy_cleanup(transfer.easyHandle);
+            }
+            activeTransfers -= request->pending;
+            requests.push_back(request);
+        }
+        activeRequests.clear();
+
+        for (auto request : requests)
+        {
+            request->result.aborted = true;
+            if (request->callback)
+                request->callback(request->result);
+            delete request;
+        }
+    }
+
+    ProbeEngineStats ConnectivityProbeEngine::getStats() const
+    {
+        ProbeEngineStats stats;
+        stats.probes = statProbes.load();
+        stats.transfers = statTransfers.load();
+        stats.newConnections = statNewConnections.load();
+        stats.reusedConnections = statReusedConnections.load();
+        stats.handshakeSavedMs = statHandshakeSavedMs.load();
+        stats.lastProbeHandshakeSavedMs = statLastProbeSavedMs.load();
+        stats.earlyDecisions = statEarlyDecisions.load();
+        stats.cancelledTransfers = statCancelledTransfers.load();
+        stats.lastDecisionLatencyMs = statLastDecisionLatencyMs.load();
+        return stats;
     }
 
     /*
@@ -272,48 +969,385 @@ namespace WPEFramework
         int max_count = 0;
         for (int element : responses)
         {
-            int element_count = count(responses.begin(), responses.end(), element);
-            if (element_count > max_count)
+            int element_count = count(responses.begin(), responses.end(), element);
+            if (element_count > max_count)
+            {
+                http_response_code = static_cast<nsm_connectivity_httpcode>(element);
+                max_count = element_count;
+            }
+        }
+
+        /* Calculate the percentage of the most frequent code occurrences */
+        float percentage = (static_cast<float>(max_count) / responses.size());
+        confidence = percentage;
+
+        /* 50 % connectivity check */
+        if (percentage >= 0.5)
+        {
+            switch (http_response_code)
+            {
+                case HttpStatus_204_No_Content:
+                    InternetConnectionState = FULLY_CONNECTED;
+                    NMLOG_INFO("Internet State: FULLY_CONNECTED - %.1f%%", (percentage*100));
+                break;
+                case HttpStatus_200_OK:
+                    InternetConnectionState = LIMITED_INTERNET;
+                    NMLOG_INFO("Internet State: LIMITED_INTERNET - %.1f%%", (percentage*100));
+                break;
+                case HttpStatus_511_Authentication_Required:
+                case HttpStatus_302_Found:
+                    InternetConnectionState = CAPTIVE_PORTAL;
+                    NMLOG_INFO("Internet State: CAPTIVE_PORTAL - %.1f%%", (percentage*100));
+                break;
+                default:
+                    InternetConnectionState = NO_INTERNET;
+                    if(http_response_code == -1)
+                        NMLOG_ERROR("Internet State: NO_INTERNET (curl error)");
+                    else
+                        NMLOG_WARNING("Internet State: NO_INTERNET (http code: %d - %.1f%%)", static_cast<int>(http_response_code), percentage * 100);
+                    break;
+            }
+        }
+        return InternetConnectionState;
+    }
+
+    void DualStackHistory::record(nsm_ipversion ipversion, bool fullyConnected, long latencyMs)
+    {
+        FamilyHistory& family = (ipversion == NSM_IPRESOLVE_V4) ? ipv4 : ipv6;
+        family.probes++;
+        family.successRate = 0.75 * family.successRate + 0.25 * (fullyConnected ? 1.0 : 0.0);
+        if (fullyConnected)
+        {
+            family.wins++;
+            family.rttMs = (family.rttMs == 0) ? latencyMs : (3 * family.rttMs + latencyMs) / 4;
+        }
+    }
+
+    /* ipv6 first as RFC 8305 asks, unless ipv4 has been clearly more successful or clearly faster lately */
+    nsm_ipversion DualStackHistory::preferredFamily() const
+    {
+        if (ipv4.successRate > ipv6.successRate + 0.25)
+            return NSM_IPRESOLVE_V4;
+        if (ipv6.successRate > ipv4.successRate + 0.25)
+            return NSM_IPRESOLVE_V6;
+        if (ipv4.rttMs > 0 && ipv6.rttMs > 0 && ipv4.rttMs * 2 < ipv6.rttMs)
+            return NSM_IPRESOLVE_V4;
+        return NSM_IPRESOLVE_V6;
+    }
+
+    long DualStackHistory::attemptDelayMs(nsm_ipversion ipversion) const
+    {
+        const FamilyHistory& family = get(ipversion);
+        if (family.rttMs == 0)
+            return NMCONNECTIVITY_RACE_DEFAULT_DELAY_MS;
+        /* give the preferred family about twice its usual verdict time before starting the other one */
+        return std::min(std::max(2 * family.rttMs, static_cast<long>(NMCONNECTIVITY_RACE_MIN_DELAY_MS)), static_cast<long>(NMCONNECTIVITY_RACE_MAX_DELAY_MS));
+    }
+
+    bool TestConnectivity::race(ConnectivityProbeEngine& probeEngine, DualStackHistory& history, const std::vector<std::string>& endpoints,
+                                                                            long timeout_ms, bool headReq, RaceCallback callback)
+    {
+        struct RaceState {
+            bool done = false;
+            bool failed[3] = {false, false, false};
+            uint32_t probeId[3] = {0, 0, 0};   /* indexed by nsm_ipversion */
+            uint32_t delayTask = 0;
+            long startTime = 0;
+            RaceResult result;
+        };
+        std::shared_ptr<RaceState> state(new RaceState());
+        state->startTime = current_time();
+        nsm_ipversion first = history.preferredFamily();
+        nsm_ipversion second = (first == NSM_IPRESOLVE_V6) ? NSM_IPRESOLVE_V4 : NSM_IPRESOLVE_V6;
+
+        std::shared_ptr<std::function<void(nsm_ipversion)>> startFamily(new std::function<void(nsm_ipversion)>());
+        *startFamily = [&probeEngine, &history, state, endpoints, timeout_ms, headReq, callback, first, startFamily](nsm_ipversion ipversion) {
+            if (state->done || state->probeId[ipversion] != 0)
+                return;
+            state->result.probes++;
+            state->probeId[ipversion] = probeEngine.submitProbe(endpoints, timeout_ms, headReq, ipversion, NMCONNECTIVITY_EARLY_QUORUM,
+                [&probeEngine, &history, state, callback, first, startFamily, ipversion](const ProbeResult& result) {
+                    if (result.aborted)
+                        *startFamily = nullptr;
+                    if (state->done || result.aborted)
+                        return;
+                    state->probeId[ipversion] = 0;
+                    TestConnectivity testInternet(result);
+                    nsm_internetState internetState = testInternet.getInternetState();
+                    history.record(ipversion, internetState == FULLY_CONNECTED, result.decisionLatencyMs);
+                    if (ipversion == NSM_IPRESOLVE_V4)
+                        state->result.ipv4State = internetState;
+                    else
+                        state->result.ipv6State = internetState;
+
+                    nsm_ipversion other = (ipversion == NSM_IPRESOLVE_V6) ? NSM_IPRESOLVE_V4 : NSM_IPRESOLVE_V6;
+                    if (internetState != FULLY_CONNECTED)
+                    {
+                        state->failed[ipversion] = true;
+                        if (!state->failed[other])
+                        {
+                            /* no reason to wait for the attempt delay any more */
+                            probeEngine.cancel(state->delayTask);
+                            state->delayTask = 0;
+                            (*startFamily)(other);
+                            return;
+                        }
+                        /* both families answered without full connectivity; ipv4 verdict is reported like before */
+                        state->result.internetState = state->result.ipv4State;
+                    }
+                    else
+                    {
+                        state->result.winner = ipversion;
+                        state->result.internetState = internetState;
+                        state->result.confidence = testInternet.getConfidence();
+                    }
+
+                    state->done = true;
+                    probeEngine.cancel(state->delayTask);
+                    probeEngine.cancelProbe(state->probeId[other]);
+                    state->result.decisionLatencyMs = current_time() - state->startTime;
+                    NMLOG_INFO("dual stack race %s in %ld ms with %d probes (first %s)",
+                        state->result.winner == NSM_IPRESOLVE_WHATEVER ? "no winner" : (state->result.winner == NSM_IPRESOLVE_V4 ? "won by IPv4" : "won by IPv6"),
+                        state->result.decisionLatencyMs, state->result.probes, first == NSM_IPRESOLVE_V4 ? "IPv4" : "IPv6");
+                    callback(state->result);
+                    /* break the self reference of the starter */
+                    *startFamily = nullptr;
+                });
+            if (state->probeId[ipversion] == 0)
+                state->failed[ipversion] = true;
+        };
+
+        (*startFamily)(first);
+        if (state->probeId[first] == 0)
+        {
+            *startFamily = nullptr;
+            return false;
+        }
+        state->delayTask = probeEngine.schedule(history.attemptDelayMs(first), [startFamily, state, second]() {
+            state->delayTask = 0;
+            if (*startFamily)
+                (*startFamily)(second);
+        });
+        return true;
+    }
+
+    ProbeScheduler::ProbeScheduler()
+        : backoffLevel(0)
+        , lastIntervalMs(0)
+        , nextProbeTime(-1)
+        , scheduledProbes(0)
+        , avoidedMilliProbes(0)
+    {
+    }
+
+    long ProbeScheduler::nextIntervalMs(ProbeScheduleReason reason, int baseSec)
+    {
+        long baseMs = baseSec * 1000L;
+        if (reason == SCHEDULE_LINK_EVENT)
+            reset();
+        long intervalMs = (baseMs > 0) ? computeIntervalMs(reason, baseMs) : 0;
+
+        scheduledProbes++;
+        if (baseMs > 0 && intervalMs > baseMs)
+            avoidedMilliProbes += ((intervalMs - baseMs) * 1000) / baseMs;
+        lastIntervalMs = intervalMs;
+        nextProbeTime = current_time() + intervalMs;
+        return intervalMs;
+    }
+
+    ProbeScheduleInfo ProbeScheduler::getInfo() const
+    {
+        ProbeScheduleInfo info;
+        long nextProbe = nextProbeTime.load();
+        info.intervalMs = lastIntervalMs.load();
+        info.nextProbeInMs = (nextProbe < 0) ? -1 : std::max(0L, nextProbe - current_time());
+        info.backoffLevel = backoffLevel.load();
+        info.scheduledProbes = scheduledProbes.load();
+        info.avoidedProbes = avoidedMilliProbes.load() / 1000;
+        return info;
+    }
+
+    AdaptiveProbeScheduler::AdaptiveProbeScheduler()
+    {
+        std::random_device seed;
+        randomGenerator.seed(seed() ^ static_cast<unsigned>(current_time()));
+    }
+
+    long AdaptiveProbeScheduler::computeIntervalMs(ProbeScheduleReason reason, long baseMs)
+    {
+        long intervalMs = baseMs;
+        switch (reason)
+        {
+            case SCHEDULE_STATE_STABLE:
+                /* base, 2 x base, 4 x base ... up to the backoff limit */
+                intervalMs = baseMs << backoffLevel;
+                if ((1 << (backoffLevel + 1)) <= NMCONNECTIVITY_SCHEDULER_MAX_BACKOFF)
+                    backoffLevel++;
+                break;
+            case SCHEDULE_STATE_CHANGED:
+                backoffLevel = 0;
+                intervalMs = std::min(baseMs, NMCONNECTIVITY_MONITOR_MIN_INTERVAL * 1000L);
+                break;
+            case SCHEDULE_RETRY:
+            case SCHEDULE_LINK_EVENT:
+                backoffLevel = 0;
+                break;
+        }
+
+        /* spread the devices so they do not probe the endpoints in lockstep */
+        long jitterMs = (intervalMs * NMCONNECTIVITY_SCHEDULER_JITTER_PERCENT) / 100;
+        if (jitterMs > 0)
+        {
+            std::uniform_int_distribution<long> jitter(-jitterMs, jitterMs);
+            intervalMs += jitter(randomGenerator);
+        }
+        return intervalMs;
+    }
+
+    void LatencyHistogram::clear()
+    {
+        memset(buckets, 0, sizeof(buckets));
+        samples = 0;
+        sumUs = 0;
+        minUs = 0;
+        maxUs = 0;
+    }
+
+    int LatencyHistogram::bucketIndex(uint64_t valueUs)
+    {
+        if (valueUs < 4)
+            return static_cast<int>(valueUs);
+        int exponent = 63 - __builtin_clzll(valueUs);
+        int index = (exponent - 1) * 4 + static_cast<int>((valueUs >> (exponent - 2)) & 3);
+        return std::min(index, BUCKETS - 1);
+    }
+
+    uint64_t LatencyHistogram::bucketUpperBound(int index)
+    {
+        if (index < 4)
+            return static_cast<uint64_t>(index);
+        int exponent = index / 4 + 1;
+        uint64_t subBucket = static_cast<uint64_t>(index % 4);
+        return ((5 + subBucket) << (exponent - 2)) - 1;
+    }
+
+    void LatencyHistogram::record(long valueUs)
+    {
+        if (valueUs < 0)
+            valueUs = 0;
+        buckets[bucketIndex(static_cast<uint64_t>(valueUs))]++;
+        if (samples == 0 || valueUs < minUs)
+            minUs = valueUs;
+        if (valueUs > maxUs)
+            maxUs = valueUs;
+        samples++;
+        sumUs += static_cast<uint64_t>(valueUs);
+    }
+
+    long LatencyHistogram::percentile(int percent) const
+    {
+        if (samples == 0)
+            return 0;
+        percent = std::max(0, std::min(percent, 100));
+        uint64_t rank = std::max<uint64_t>(1, (samples * percent + 99) / 100);
+        uint64_t seen = 0;
+        for (int index = 0; index < BUCKETS; index++)
+        {
+            seen += buckets[index];
+            if (seen >= rank)
+                return std::max(minUs, std::min(static_cast<long>(bucketUpperBound(index)), maxUs));
+        }
+        return maxUs;
+    }
+
+    void EndpointRanker::record(const ProbeResult& result, long now)
+    {
+        bool anyAnswered = std::any_of(result.samples.begin(), result.samples.end(),
+                                       [](const ProbeTransferSample& sample) { return sample.errorClass == PROBE_ERROR_NONE; });
+
+        const std::lock_guard<std::mutex> lock(rankerMutex);
+        for (const auto& sample : result.samples)
+        {
+            bool failed = (sample.errorClass != PROBE_ERROR_NONE);
+            if (failed && !anyAnswered)
+                continue; /* link problem, not an endpoint one */
+
+            EndpointHealth& endpoint = health[sample.endpoint];
+            long rttMs = sample.totalUs / 1000;
+            endpoint.samples++;
+            endpoint.failureRate = endpoint.failureRate * 0.7f + (failed ? 0.3f : 0.0f);
+            if (!failed)
             {
-                http_response_code = static_cast<nsm_connectivity_httpcode>(element);
-                max_count = element_count;
+                endpoint.rttMs = (endpoint.rttMs == 0) ? rttMs : (endpoint.rttMs * 7 + rttMs * 3) / 10;
+                if (endpoint.openUntil != 0)
+                    NMLOG_INFO("endpoint <%s> answered again, circuit closed", sample.endpoint.c_str());
+                endpoint.consecutiveFailures = 0;
+                endpoint.cooldownMs = NMCONNECTIVITY_BREAKER_COOLDOWN_MS;
+                endpoint.openUntil = 0;
+                continue;
+            }
+
+            endpoint.consecutiveFailures++;
+            if (endpoint.consecutiveFailures >= NMCONNECTIVITY_BREAKER_FAILURES)
+            {
+                /* a half open endpoint failing again goes back for a longer cooldown */
+                if (endpoint.openUntil != 0)
+                    endpoint.cooldownMs = std::min(endpoint.cooldownMs * 2, static_cast<long>(NMCONNECTIVITY_BREAKER_MAX_COOLDOWN_MS));
+                endpoint.openUntil = now + endpoint.cooldownMs;
+                NMLOG_WARNING("endpoint <%s> failed %u times in a row, circuit open for %ld ms", sample.endpoint.c_str(),
+                                                                        endpoint.consecutiveFailures, endpoint.cooldownMs);
             }
         }
+    }
 
-        /* Calculate the percentage of the most frequent code occurrences */
-        float percentage = (static_cast<float>(max_count) / responses.size());
+    std::vector<std::string> EndpointRanker::select(const std::vector<std::string>& endpoints, size_t topK, long now, bool& ranked)
+    {
+        const std::lock_guard<std::mutex> lock(rankerMutex);
+        for (auto it = health.begin(); it != health.end();)
+        {
+            if (std::find(endpoints.begin(), endpoints.end(), it->first) == endpoints.end())
+                it = health.erase(it);
+            else
+                ++it;
+        }
 
-        /* 50 % connectivity check */
-        if (percentage >= 0.5)
+        /* endpoints never measured score 0 so they get measured first */
+        std::vector<std::pair<long, std::string>> candidates;
+        for (const auto& endpoint : endpoints)
         {
-            switch (http_response_code)
-            {
-                case HttpStatus_204_No_Content:
-                    InternetConnectionState = FULLY_CONNECTED;
-                    NMLOG_INFO("Internet State: FULLY_CONNECTED - %.1f%%", (percentage*100));
-                break;
-                case HttpStatus_200_OK:
-                    InternetConnectionState = LIMITED_INTERNET;
-                    NMLOG_INFO("Internet State: LIMITED_INTERNET - %.1f%%", (percentage*100));
-                break;
-                case HttpStatus_511_Authentication_Required:
-                case HttpStatus_302_Found:
-                    InternetConnectionState = CAPTIVE_PORTAL;
-                    NMLOG_INFO("Internet State: CAPTIVE_PORTAL - %.1f%%", (percentage*100));
-                break;
-                default:
-                    InternetConnectionState = NO_INTERNET;
-                    if(http_response_code == -1)
-                        NMLOG_ERROR("Internet State: NO_INTERNET (curl error)");
-                    else
-                        NMLOG_WARNING("Internet State: NO_INTERNET (http code: %d - %.1f%%)", static_cast<int>(http_response_code), percentage * 100);
-                    break;
-            }
+            auto it = health.find(endpoint);
+            if (it == health.end())
+                candidates.push_back(std::make_pair(0L, endpoint));
+            else if (it->second.openUntil <= now)
+                candidates.push_back(std::make_pair(it->second.scoreMs(), endpoint));
         }
-        return InternetConnectionState;
+
+        ranked = false;
+        if (candidates.empty())
+            return endpoints; /* every circuit is open, most likely it is the link and not the endpoints */
+
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const std::pair<long, std::string>& a, const std::pair<long, std::string>& b) { return a.first < b.first; });
+        size_t count = candidates.size();
+        if (++selections % NMCONNECTIVITY_RANKING_REFRESH_PROBES != 0)
+            count = std::min(count, std::max<size_t>(topK, 1));
+
+        std::vector<std::string> selected;
+        for (size_t index = 0; index < count; index++)
+            selected.push_back(candidates[index].second);
+        ranked = selected.size() < endpoints.size();
+        return selected;
+    }
+
+    std::map<std::string, EndpointRanker::EndpointHealth> EndpointRanker::getHealth() const
+    {
+        const std::lock_guard<std::mutex> lock(rankerMutex);
+        return health;
     }
 
     ConnectivityMonitor::ConnectivityMonitor()
+        : connScheduler(new AdaptiveProbeScheduler())
+        , contScheduler(new AdaptiveProbeScheduler())
     {
         if(endpointCache.isEndpointCashFileExist())
         {
@@ -324,12 +1358,13 @@ namespace WPEFramework
         else
             connectivityMonitorEndpt.push_back("http://clients3.google.com/generate_204");
 
+        continuousMonitorTimeout = NMCONNECTIVITY_MONITOR_DEFAULT_INTERVAL;
         doContinuousMonitor = false;
         doConnectivityMonitor = false;
         gInternetState = nsm_internetState::UNKNOWN;
-        gIpv4InternetState = nsm_internetState::UNKNOWN;
-        gIpv6InternetState = nsm_internetState::UNKNOWN;
+        std::atomic_store(&stateSnapshot, std::shared_ptr<const InternetStateSnapshot>(new InternetStateSnapshot()));
         ginterfaceStatus = false;
+        probeEngine.setProbeObserver([this](const ProbeResult& result) { recordProbeStatistics(result); });
     }
 
     ConnectivityMonitor::~ConnectivityMonitor()
@@ -337,12 +1372,71 @@ namespace WPEFramework
         NMLOG_WARNING("~ConnectivityMonitor");
         doContinuousMonitor = false;
         doConnectivityMonitor = false;
-        cvConnectivityMonitor.notify_one();
-        cvContinuousMonitor.notify_one();
-        if (continuousMonitorThrd.joinable())
-            continuousMonitorThrd.join();
-        if (connectivityMonitorThrd.joinable())
-            connectivityMonitorThrd.join();
+        /* in flight probes are completed as aborted and ignored by the monitors */
+        probeEngine.stop();
+    }
+
+    const char* ConnectivityMonitor::getProbeErrorClassString(ProbeErrorClass errorClass)
+    {
+        switch (errorClass)
+        {
+            case PROBE_ERROR_NONE: return "none";
+            case PROBE_ERROR_DNS: return "dns";
+            case PROBE_ERROR_CONNECT: return "connect";
+            case PROBE_ERROR_TLS: return "tls";
+            case PROBE_ERROR_TIMEOUT: return "timeout";
+            case PROBE_ERROR_HTTP: return "http";
+            default: return "other";
+        }
+    }
+
+    void ConnectivityMonitor::recordProbeStatistics(const ProbeResult& result)
+    {
+        long now = current_time();
+        endpointRanker.record(result, now);
+
+        const std::lock_guard<std::mutex> lock(statisticsMutex);
+        for (const auto& sample : result.samples)
+        {
+            if (endpointStatistics.find(sample.endpoint) == endpointStatistics.end() &&
+                endpointStatistics.size() >= NMCONNECTIVITY_STATISTICS_MAX_ENDPOINTS)
+            {
+                auto oldest = endpointStatistics.begin();
+                for (auto it = endpointStatistics.begin(); it != endpointStatistics.end(); ++it)
+                {
+                    if (it->second.lastProbeTime < oldest->second.lastProbeTime)
+                        oldest = it;
+                }
+                endpointStatistics.erase(oldest);
+            }
+
+            EndpointStatistics& stats = endpointStatistics[sample.endpoint];
+            stats.transfers++;
+            stats.responseCodes[sample.responseCode]++;
+            stats.errors[sample.errorClass]++;
+            stats.lastResponseCode = sample.responseCode;
+            stats.lastProbeTime = now;
+            if (sample.responseCode < 0)
+                continue; /* no timings worth keeping from a failed transfer */
+
+            if (sample.reusedConnection)
+                stats.reusedConnections++;
+            else
+            {
+                stats.dns.record(sample.dnsUs);
+                stats.connect.record(sample.connectUs);
+                if (sample.tlsUs > 0)
+                    stats.tls.record(sample.tlsUs);
+            }
+            stats.ttfb.record(sample.ttfbUs);
+            stats.total.record(sample.totalUs);
+        }
+    }
+
+    std::map<std::string, EndpointStatistics> ConnectivityMonitor::getEndpointStatistics() const
+    {
+        const std::lock_guard<std::mutex> lock(statisticsMutex);
+        return endpointStatistics;
     }
 
     std::vector<std::string> ConnectivityMonitor::getConnectivityMonitorEndpoints()
@@ -368,6 +1462,8 @@ namespace WPEFramework
 
         // write the endpoints to a file
         endpointCache.writeEnpointsToFile(connectivityMonitorEndpt);
+        /* pooled handles are bound to the old endpoints */
+        probeEngine.reset();
 
         std::string endpointsStr;
         for (const auto& endpoint : connectivityMonitorEndpt)
@@ -389,38 +1485,146 @@ namespace WPEFramework
     nsm_internetState ConnectivityMonitor::getInternetState(nsm_ipversion ipversion)
     {
         nsm_internetState internetState = nsm_internetState::UNKNOWN;
-        // If monitor connectivity is running take the cache value
+        std::shared_ptr<const InternetStateSnapshot> snapshot = getInternetStateSnapshot();
+        const InternetStateSnapshot::FamilyVerdict& ipv4Verdict = snapshot->verdict[NSM_IPRESOLVE_V4];
+        const InternetStateSnapshot::FamilyVerdict& ipv6Verdict = snapshot->verdict[NSM_IPRESOLVE_V6];
+        const InternetStateSnapshot::FamilyVerdict& requested = snapshot->verdict[ipversion];
 
+        // If monitor connectivity is running take the cache value
         if ( doContinuousMonitor && (nsm_ipversion::NSM_IPRESOLVE_V4 == ipversion || nsm_ipversion::NSM_IPRESOLVE_WHATEVER == ipversion)
-                                           && gIpv4InternetState != nsm_internetState::UNKNOWN ) {
-            NMLOG_WARNING("Reading Ipv4 internet state cached value %s", getInternetStateString(gIpv4InternetState));
-            internetState = gIpv4InternetState;
+                                           && ipv4Verdict.internetState != nsm_internetState::UNKNOWN ) {
+            NMLOG_WARNING("Reading Ipv4 internet state cached value %s", getInternetStateString(ipv4Verdict.internetState));
+            internetState = ipv4Verdict.internetState;
         }
         else if ( doContinuousMonitor && (nsm_ipversion::NSM_IPRESOLVE_V6 == ipversion || nsm_ipversion::NSM_IPRESOLVE_WHATEVER == ipversion)
-                                           && gIpv6InternetState != nsm_internetState::UNKNOWN ) {
-            NMLOG_WARNING("Reading Ipv6 internet state cached value %s", getInternetStateString(gIpv6InternetState));
-            internetState = gIpv6InternetState;
+                                           && ipv6Verdict.internetState != nsm_internetState::UNKNOWN ) {
+            NMLOG_WARNING("Reading Ipv6 internet state cached value %s", getInternetStateString(ipv6Verdict.internetState));
+            internetState = ipv6Verdict.internetState;
+        }
+        else if ( requested.internetState != nsm_internetState::UNKNOWN && current_time() - requested.probeTime < NMCONNECTIVITY_SNAPSHOT_FRESH_MS ) {
+            NMLOG_INFO("Reading fresh internet state %s (%ld ms old)", getInternetStateString(requested.internetState), current_time() - requested.probeTime);
+            internetState = requested.internetState;
         }
         else
         {
-            TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, NMCONNECTIVITY_CURL_GET_REQUEST, ipversion);
-            internetState = testInternet.getInternetState();
+            std::string captivePortalURI;
+            internetState = runOnDemandProbe(ipversion, captivePortalURI);
         }
         return internetState;
     }
 
     std::string ConnectivityMonitor::getCaptivePortalURI()
     {
-        TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, NMCONNECTIVITY_CURL_GET_REQUEST, NSM_IPRESOLVE_WHATEVER);
-        if(nsm_internetState::CAPTIVE_PORTAL == testInternet.getInternetState())
+        /* the monitors probe the portal anyway; serve what they saw when it is recent */
+        CaptivePortalRecord record = probeEngine.getCaptivePortalRecord();
+        if (record.updateTime != 0 && current_time() - record.updateTime < NMCONNECTIVITY_CAPTIVE_RECORD_MAX_AGE_MS)
+        {
+            if (record.active && !record.uri.empty())
+            {
+                NMLOG_WARNING("captive portal URI = %s (http %ld, seen %ld ms ago)", record.uri.c_str(), record.statusCode, current_time() - record.lastSeenTime);
+                return record.uri;
+            }
+            NMLOG_WARNING("No captive portal found !");
+            return std::string("");
+        }
+
+        std::string captivePortalURI;
+        if(nsm_internetState::CAPTIVE_PORTAL == runOnDemandProbe(NSM_IPRESOLVE_WHATEVER, captivePortalURI))
         {
-            NMLOG_WARNING("captive portal URI = %s", testInternet.getCaptivePortal().c_str());
-            return testInternet.getCaptivePortal();
+            NMLOG_WARNING("captive portal URI = %s", captivePortalURI.c_str());
+            return captivePortalURI;
         }
         NMLOG_WARNING("No captive portal found !");
         return std::string("");
     }
 
+    /*
+     * blocking probe for the RPC callers. a caller arriving while a probe of the same ip family is in flight
+     * waits for that probe and takes its verdict instead of starting one more round against the endpoints.
+     */
+    nsm_internetState ConnectivityMonitor::runOnDemandProbe(nsm_ipversion ipversion, std::string& captivePortalURI)
+    {
+        if (probeEngine.isReactorThread())
+        {
+            NMLOG_ERROR("on-demand probe requested on the connectivity reactor thread");
+            captivePortalURI = getInternetStateSnapshot()->captivePortalURI;
+            return getInternetStateSnapshot()->verdict[ipversion].internetState;
+        }
+
+        OnDemandProbe& onDemand = onDemandProbe[ipversion];
+        std::unique_lock<std::mutex> lock(onDemandMutex);
+        uint64_t generation = onDemand.generation;
+        if (onDemand.inFlight)
+        {
+            NMLOG_DEBUG("joining the on-demand probe in flight");
+        }
+        else
+        {
+            onDemand.inFlight = true;
+            lock.unlock();
+            long startTime = current_time();
+            uint32_t probeId = probeEngine.submitProbe(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS,
+                                                       NMCONNECTIVITY_CURL_GET_REQUEST, ipversion, NMCONNECTIVITY_EARLY_QUORUM,
+                [this, ipversion, startTime](const ProbeResult& result) {
+                    TestConnectivity testInternet(result);
+                    if (!result.aborted)
+                    {
+                        setFamilyState(ipversion, testInternet.getInternetState(), testInternet.getConfidence(), testInternet.getCaptivePortal());
+                        NMLOG_DEBUG("internet state %s decided in %ld ms", getInternetStateString(testInternet.getInternetState()), current_time() - startTime);
+                    }
+                    std::lock_guard<std::mutex> guard(onDemandMutex);
+                    OnDemandProbe& finished = onDemandProbe[ipversion];
+                    finished.internetState = testInternet.getInternetState();
+                    finished.captivePortalURI = testInternet.getCaptivePortal();
+                    finished.inFlight = false;
+                    finished.generation++;
+                    onDemandCv.notify_all();
+                });
+            lock.lock();
+            if (probeId == 0)
+            {
+                NMLOG_ERROR("on-demand connectivity probe not possible");
+                /* callers that joined while the lock was released are waiting for this generation too */
+                onDemand.internetState = nsm_internetState::UNKNOWN;
+                onDemand.captivePortalURI.clear();
+                onDemand.inFlight = false;
+                onDemand.generation++;
+                onDemandCv.notify_all();
+                return nsm_internetState::UNKNOWN;
+            }
+        }
+
+        onDemandCv.wait(lock, [&onDemand, generation]() { return onDemand.generation != generation; });
+        captivePortalURI = onDemand.captivePortalURI;
+        return onDemand.internetState;
+    }
+
+    void ConnectivityMonitor::publishSnapshot(const std::function<void(InternetStateSnapshot&)>& update)
+    {
+        std::lock_guard<std::mutex> lock(snapshotWriteMutex);
+        std::shared_ptr<InternetStateSnapshot> snapshot(new InternetStateSnapshot(*std::atomic_load(&stateSnapshot)));
+        snapshot->version++;
+        update(*snapshot);
+        std::atomic_store(&stateSnapshot, std::shared_ptr<const InternetStateSnapshot>(snapshot));
+    }
+
+    void ConnectivityMonitor::setFamilyState(nsm_ipversion ipversion, nsm_internetState internetState, float confidence, const std::string& captivePortalURI)
+    {
+        publishSnapshot([ipversion, internetState, confidence, &captivePortalURI](InternetStateSnapshot& snapshot) {
+            InternetStateSnapshot::FamilyVerdict& verdict = snapshot.verdict[ipversion];
+            verdict.internetState = internetState;
+            verdict.confidence = confidence;
+            if (internetState == nsm_internetState::UNKNOWN)
+                return;
+            verdict.probeTime = current_time();
+            snapshot.lastProbeTime = verdict.probeTime;
+            if (internetState == nsm_internetState::CAPTIVE_PORTAL && !captivePortalURI.empty())
+                snapshot.captivePortalURI = captivePortalURI;
+            else if (internetState == nsm_internetState::FULLY_CONNECTED)
+                snapshot.captivePortalURI.clear();
+        });
+    }
+
     bool ConnectivityMonitor::startContinuousConnectivityMonitor(int timeoutInSeconds)
     {
         continuousMonitorTimeout.store(timeoutInSeconds >= NMCONNECTIVITY_MONITOR_MIN_INTERVAL ? timeoutInSeconds : NMCONNECTIVITY_MONITOR_DEFAULT_INTERVAL);
@@ -433,33 +1637,28 @@ namespace WPEFramework
             else
             {
                 NMLOG_INFO("continuous monitor restarted with %d Sec", continuousMonitorTimeout.load());
-                cvContinuousMonitor.notify_one();
+                probeEngine.post([this]() { triggerContinuousMonitor(); });
             }
             return true;
         }
 
-        if (continuousMonitorThrd.joinable()) {
-            NMLOG_WARNING("continuous monitor joinable thread running");
-            doContinuousMonitor = false;
-            continuousMonitorThrd.join();
-        }
-
         doContinuousMonitor = true;
-        continuousMonitorThrd = std::thread(&ConnectivityMonitor::continuousMonitorFunction, this);
-        NMLOG_INFO("continuous connectivity monitor started with %d Sec", continuousMonitorTimeout.load());
-        if(!continuousMonitorThrd.joinable()) {
+        if (!probeEngine.post([this]() { triggerContinuousMonitor(); }))
+        {
             NMLOG_ERROR("continuous connectivity monitor start Failed");
+            doContinuousMonitor = false;
             return false;
         }
+        NMLOG_INFO("continuous connectivity monitor started with %d Sec", continuousMonitorTimeout.load());
         return true;
     }
 
     bool ConnectivityMonitor::stopContinuousConnectivityMonitor()
     {
         doContinuousMonitor = false;
-        cvContinuousMonitor.notify_one();
-        if (continuousMonitorThrd.joinable())
-            continuousMonitorThrd.join();
+        probeEngine.post([this]() { finishContinuousMonitor(); });
+        setFamilyState(NSM_IPRESOLVE_V4, UNKNOWN);
+        setFamilyState(NSM_IPRESOLVE_V6, UNKNOWN);
         NMLOG_INFO("continuous connectivity monitor stopped");
         return true;
     }
@@ -473,29 +1672,27 @@ namespace WPEFramework
     bool ConnectivityMonitor::startConnectivityMonitor(bool interfaceStatus)
     {
         ginterfaceStatus = interfaceStatus; /* this will give interface status connected/ disconnected */
+        /* link or ip changed, cached connections and dns entries are no longer trusted */
+        probeEngine.reset();
         gInternetState = UNKNOWN;
-        gIpv4InternetState = UNKNOWN;
-        gIpv6InternetState = UNKNOWN;
-        if (doConnectivityMonitor)
-        {
-            cvConnectivityMonitor.notify_one();
-            NMLOG_DEBUG("trigger connectivity monitor thread");
-            return true;
-        }
-
-        if (connectivityMonitorThrd.joinable()) { // cleanup of previous thread
-            doConnectivityMonitor = false;
-            connectivityMonitorThrd.join();
-        }
+        publishSnapshot([](InternetStateSnapshot& snapshot) {
+            snapshot.internetState = UNKNOWN;
+            for (auto& verdict : snapshot.verdict)
+                verdict = InternetStateSnapshot::FamilyVerdict();
+        });
 
-        doConnectivityMonitor = true;
-        connectivityMonitorThrd = std::thread(&ConnectivityMonitor::connectivityMonitorFunction, this);
-        if(!connectivityMonitorThrd.joinable()) {
+        bool monitorRunning = doConnectivityMonitor.exchange(true);
+        if (!probeEngine.post([this]() { triggerConnectivityMonitor(); }))
+        {
             NMLOG_ERROR("connectivity monitor start failed");
+            doConnectivityMonitor = false;
             return false;
         }
 
-        NMLOG_ERROR("connectivity monitor started %d", NMCONNECTIVITY_MONITOR_MIN_INTERVAL);
+        if (monitorRunning)
+            NMLOG_DEBUG("trigger connectivity monitor");
+        else
+            NMLOG_ERROR("connectivity monitor started %d", NMCONNECTIVITY_MONITOR_MIN_INTERVAL);
         return true;
     }
 
@@ -507,218 +1704,376 @@ namespace WPEFramework
             Exchange::INetworkManager::InternetStatus newState = static_cast<Exchange::INetworkManager::InternetStatus>(newInternetState);
             _instance->ReportInternetStatusChangedEvent(oldState , newState);
             gInternetState = newInternetState;
+            publishSnapshot([newInternetState](InternetStateSnapshot& snapshot) { snapshot.internetState = newInternetState; });
         }
         else
             NMLOG_WARNING("NetworkManagerImplementation Instance NULL notifyInternetStatusChange failed.");
     }
 
-    void ConnectivityMonitor::continuousMonitorFunction()
+    /* runs on the reactor thread; starts the continuous monitor or skips the wait of a running one */
+    void ConnectivityMonitor::triggerContinuousMonitor()
     {
-        int TempInterval = continuousMonitorTimeout.load();
-        std::mutex connMutex;
-        nsm_ipversion ipResolveTyp = NSM_IPRESOLVE_WHATEVER;
-        int notifyPreRetry = 1;
-        nsm_internetState currentInternetState = nsm_internetState::UNKNOWN;
+        if (!doContinuousMonitor)
+            return;
 
-        do
+        if (contMonitor.active)
         {
-            if(doConnectivityMonitor)
+            if (contMonitor.probeInFlight)
             {
-                NMLOG_DEBUG("connectivity monitor running so skiping ccm check");
-                gIpv4InternetState = UNKNOWN;
-                gIpv6InternetState = UNKNOWN;
-                std::unique_lock<std::mutex> lock(connMutex);
-                cvContinuousMonitor.wait_for(lock, std::chrono::seconds(continuousMonitorTimeout.load()));
-                ipResolveTyp = NSM_IPRESOLVE_WHATEVER; /* some interface change happense*/
-                continue;
+                contMonitor.signalled = true;
+                return;
             }
-            else if (ipResolveTyp == NSM_IPRESOLVE_WHATEVER)
-            {
-                nsm_internetState ipV4InternetState = UNKNOWN;
-                nsm_internetState ipV6InternetState = UNKNOWN;
-                auto curlCheckThrdIpv4 = [&]() {
-                    TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, 
-                                                                                    NMCONNECTIVITY_CURL_GET_REQUEST, NSM_IPRESOLVE_V4);
-                    ipV4InternetState = testInternet.getInternetState();
-                };
-
-                auto curlCheckThrdIpv6 = [&]() {
-                    TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, 
-                                                                                        NMCONNECTIVITY_CURL_GET_REQUEST, NSM_IPRESOLVE_V6);
-                    ipV6InternetState = testInternet.getInternetState();
-                };
-                std::thread ipv4thread(curlCheckThrdIpv4);
-                std::thread ipv6thread(curlCheckThrdIpv6);
-                // Wait for both threads to finish
-                ipv4thread.join();
-                ipv6thread.join();
-                if(ipV4InternetState == FULLY_CONNECTED) {
-                    ipResolveTyp = NSM_IPRESOLVE_V4;
-                    currentInternetState = ipV4InternetState;
+            NMLOG_INFO("continous connectivity monitor recieved signal. skping interval");
+            contScheduler->reset();
+            probeEngine.cancel(contMonitor.timerId);
+            contMonitor.timerId = 0;
+            runContinuousMonitorCheck();
+            return;
+        }
+
+        uint32_t cycle = contMonitor.cycle + 1;
+        contScheduler->reset();
+        contMonitor = ContinuousMonitorState();
+        contMonitor.cycle = cycle;
+        contMonitor.active = true;
+        runContinuousMonitorCheck();
+    }
+
+    void ConnectivityMonitor::finishContinuousMonitor()
+    {
+        probeEngine.cancel(contMonitor.timerId);
+        contMonitor.timerId = 0;
+        contMonitor.active = false;
+        contMonitor.probeInFlight = false;
+        contMonitor.cycle++; /* results of in flight probes are dropped */
+        contScheduler->clearNextProbe();
+        if (!doContinuousMonitor)
+        {
+            setFamilyState(NSM_IPRESOLVE_V4, UNKNOWN);
+            setFamilyState(NSM_IPRESOLVE_V6, UNKNOWN);
+        }
+        NMLOG_DEBUG("continous connectivity monitor exit");
+    }
+
+    void ConnectivityMonitor::scheduleContinuousMonitorCheck(ProbeScheduleReason reason, int intervalSec)
+    {
+        uint32_t cycle = contMonitor.cycle;
+        long intervalMs = contScheduler->nextIntervalMs(reason, intervalSec);
+        NMLOG_DEBUG("next continuous connectivity check in %ld ms", intervalMs);
+        probeEngine.cancel(contMonitor.timerId);
+        contMonitor.timerId = probeEngine.schedule(intervalMs, [this, cycle]() {
+            if (cycle != contMonitor.cycle)
+                return;
+            contMonitor.timerId = 0;
+            runContinuousMonitorCheck();
+        });
+    }
+
+    void ConnectivityMonitor::runContinuousMonitorCheck()
+    {
+        if(!doContinuousMonitor)
+        {
+            finishContinuousMonitor();
+            return;
+        }
+
+        if(doConnectivityMonitor)
+        {
+            NMLOG_DEBUG("connectivity monitor running so skiping ccm check");
+            setFamilyState(NSM_IPRESOLVE_V4, UNKNOWN);
+            setFamilyState(NSM_IPRESOLVE_V6, UNKNOWN);
+            contMonitor.ipResolveTyp = NSM_IPRESOLVE_WHATEVER; /* some interface change happense*/
+            scheduleContinuousMonitorCheck(SCHEDULE_RETRY, continuousMonitorTimeout.load());
+            return;
+        }
+
+        uint32_t cycle = contMonitor.cycle;
+        contScheduler->clearNextProbe();
+        contMonitor.probeInFlight = true;
+        if (contMonitor.ipResolveTyp == NSM_IPRESOLVE_WHATEVER)
+        {
+            /* ipv4 and ipv6 race, the loser is cancelled once the winner is fully connected */
+            bool submitted = TestConnectivity::race(probeEngine, dualStackHistory, getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS,
+                                                                                NMCONNECTIVITY_CURL_GET_REQUEST, [this, cycle](const RaceResult& result) {
+                if (cycle != contMonitor.cycle)
+                    return;
+                if (result.ipv4State != UNKNOWN)
+                    setFamilyState(NSM_IPRESOLVE_V4, result.ipv4State, result.winner == NSM_IPRESOLVE_V4 ? result.confidence : 0);
+                if (result.ipv6State != UNKNOWN)
+                    setFamilyState(NSM_IPRESOLVE_V6, result.ipv6State, result.winner == NSM_IPRESOLVE_V6 ? result.confidence : 0);
+                if(result.winner == NSM_IPRESOLVE_V4)
                     NMLOG_INFO("connectivity monitor default ip resolve IPV4");
-                }
-                else if(ipV6InternetState == FULLY_CONNECTED) {
-                    ipResolveTyp = NSM_IPRESOLVE_V6;
-                    currentInternetState = ipV6InternetState;
+                else if(result.winner == NSM_IPRESOLVE_V6)
                     NMLOG_INFO("connectivity monitor default ip resolve IPV6");
-                }
-                else /* not changing ip resolve type */
-                    currentInternetState = ipV4InternetState;
-            }
-            else /* IPV4 or IPV6 based on default values */
-            {
-                TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS,
-                                                                                    NMCONNECTIVITY_CURL_HEAD_REQUEST, ipResolveTyp);
-                currentInternetState = testInternet.getInternetState();
-                if(ipResolveTyp == NSM_IPRESOLVE_V4)
-                    gIpv4InternetState = currentInternetState;
-                else if(ipResolveTyp == NSM_IPRESOLVE_V6)
-                    gIpv6InternetState = currentInternetState;
-            }
+                /* no winner is not changing ip resolve type */
+                if(result.winner != NSM_IPRESOLVE_WHATEVER)
+                    contMonitor.ipResolveTyp = result.winner;
+                onContinuousMonitorResult(result.internetState);
+            });
+            if (!submitted)
+                contMonitor.probeInFlight = false;
+        }
+        else /* IPV4 or IPV6 based on default values */
+        {
+            /* steady state, ask the best ranked endpoints only */
+            bool ranked = false;
+            std::vector<std::string> endpoints = endpointRanker.select(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_RANKED_ENDPOINTS, current_time(), ranked);
+            if (!submitContinuousProbe(contMonitor.ipResolveTyp, endpoints, ranked))
+                contMonitor.probeInFlight = false;
+        }
+    }
 
-            if (currentInternetState == NO_INTERNET)
-            {
-                if(gInternetState == FULLY_CONNECTED && notifyPreRetry < NMCONNECTIVITY_NO_INTERNET_RETRY_COUNT)
-                {
-                    /* it will prevent posting notification */
-                    currentInternetState = gInternetState;
-                    TempInterval = 5;
-                    NMLOG_INFO("No internet retrying connection check %d ...", notifyPreRetry);
-                    notifyPreRetry++;
-                    /* no internet state retry do it in ipv4 and ipv6 sepratly in two thread */
-                    ipResolveTyp = NSM_IPRESOLVE_WHATEVER;
-                }
-                else
+    bool ConnectivityMonitor::submitContinuousProbe(nsm_ipversion ipResolveTyp, const std::vector<std::string>& endpoints, bool ranked)
+    {
+        uint32_t cycle = contMonitor.cycle;
+        uint32_t probeId = probeEngine.submitProbe(endpoints, NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, NMCONNECTIVITY_CURL_HEAD_REQUEST, ipResolveTyp, NMCONNECTIVITY_EARLY_QUORUM,
+            [this, cycle, ipResolveTyp, ranked](const ProbeResult& result) {
+                if (cycle != contMonitor.cycle || result.aborted)
+                    return;
+                TestConnectivity testInternet(result);
+                nsm_internetState currentInternetState = testInternet.getInternetState();
+                if (ranked && (currentInternetState != FULLY_CONNECTED || testInternet.getConfidence() < 1.0))
                 {
-                    notifyPreRetry = 1;
-                    TempInterval = continuousMonitorTimeout.load();
+                    /* top endpoints failed or disagree, let every endpoint vote */
+                    NMLOG_INFO("ranked endpoints reported %s, consulting all endpoints", getInternetStateString(currentInternetState));
+                    if (submitContinuousProbe(ipResolveTyp, getConnectivityMonitorEndpoints(), false))
+                        return;
                 }
+                setFamilyState(ipResolveTyp, currentInternetState, testInternet.getConfidence(), testInternet.getCaptivePortal());
+                onContinuousMonitorResult(currentInternetState);
+            });
+        return probeId != 0;
+    }
+
+    void ConnectivityMonitor::onContinuousMonitorResult(nsm_internetState currentInternetState)
+    {
+        int TempInterval = continuousMonitorTimeout.load();
+        ProbeScheduleReason scheduleReason = SCHEDULE_STATE_STABLE;
+        contMonitor.probeInFlight = false;
+
+        if (currentInternetState == NO_INTERNET)
+        {
+            if(gInternetState == FULLY_CONNECTED && contMonitor.notifyPreRetry < NMCONNECTIVITY_NO_INTERNET_RETRY_COUNT)
+            {
+                /* it will prevent posting notification */
+                currentInternetState = gInternetState;
+                TempInterval = 5;
+                scheduleReason = SCHEDULE_RETRY;
+                NMLOG_INFO("No internet retrying connection check %d ...", contMonitor.notifyPreRetry);
+                contMonitor.notifyPreRetry++;
+                /* no internet state retry do it in ipv4 and ipv6 sepratly */
+                contMonitor.ipResolveTyp = NSM_IPRESOLVE_WHATEVER;
             }
-            else {
-                notifyPreRetry = 1;
-                TempInterval = continuousMonitorTimeout.load();
-            }
+            else
+                contMonitor.notifyPreRetry = 1;
+        }
+        else
+            contMonitor.notifyPreRetry = 1;
+
+        if(gInternetState != currentInternetState)
+        {
+            NMLOG_INFO("Internet state changed to %s", getInternetStateString(currentInternetState));
+            /* Notify Internet state change */
+            notifyInternetStatusChangedEvent(currentInternetState);
+            scheduleReason = SCHEDULE_STATE_CHANGED;
+        }
+
+        if(!doContinuousMonitor)
+        {
+            finishContinuousMonitor();
+            return;
+        }
+
+        /* wait for next interval */
+        if (contMonitor.signalled)
+        {
+            contMonitor.signalled = false;
+            NMLOG_INFO("continous connectivity monitor recieved signal. skping %d sec interval", TempInterval);
+            TempInterval = 0;
+            scheduleReason = SCHEDULE_LINK_EVENT;
+        }
+        scheduleContinuousMonitorCheck(scheduleReason, TempInterval);
+    }
+
+    /* runs on the reactor thread; starts the initial connectivity monitor or restarts the retries of a running one */
+    void ConnectivityMonitor::triggerConnectivityMonitor()
+    {
+        /* the running monitor may have exited on its own after the start request was posted */
+        doConnectivityMonitor = true;
+        /* link event, both monitors drop their backoff */
+        connScheduler->reset();
+        contScheduler->reset();
 
-            if(gInternetState != currentInternetState)
+        if (connMonitor.active)
+        {
+            if (connMonitor.probeInFlight)
             {
-                NMLOG_INFO("Internet state changed to %s", getInternetStateString(currentInternetState));
-                /* Notify Internet state change */
-                notifyInternetStatusChangedEvent(currentInternetState);
+                connMonitor.signalled = true;
+                return;
             }
+            NMLOG_INFO("connectivity monitor recieved signal. skping interval");
+            connMonitor.notifyPreRetry = 1;
+            connMonitor.notifyNow = true;  // new signal came should notify in next check
+            probeEngine.cancel(connMonitor.timerId);
+            connMonitor.timerId = 0;
+            runConnectivityMonitorCheck();
+            return;
+        }
 
-            //NMLOG_INFO("icm %d, ccm %d", doConnectivityMonitor.load(), doContinuousMonitor.load());
-            if(!doContinuousMonitor)
-                break;
+        uint32_t cycle = connMonitor.cycle + 1;
+        connMonitor = InitialMonitorState();
+        connMonitor.cycle = cycle;
+        connMonitor.active = true;
+        runConnectivityMonitorCheck();
+    }
 
-            /* wait for next interval */
-            std::unique_lock<std::mutex> lock(connMutex);
-            if (cvContinuousMonitor.wait_for(lock, std::chrono::seconds(TempInterval)) != std::cv_status::timeout)
-                NMLOG_INFO("continous connectivity monitor recieved signal. skping %d sec interval", TempInterval);
+    void ConnectivityMonitor::finishConnectivityMonitor()
+    {
+        probeEngine.cancel(connMonitor.timerId);
+        connMonitor.timerId = 0;
+        connMonitor.active = false;
+        connMonitor.probeInFlight = false;
+        connMonitor.cycle++;
+        connScheduler->clearNextProbe();
+        if(!doContinuousMonitor)
+        {
+            gInternetState = nsm_internetState::UNKNOWN; // no continous monitor running reset to unknow
+            publishSnapshot([](InternetStateSnapshot& snapshot) { snapshot.internetState = UNKNOWN; });
+        }
+        NMLOG_DEBUG("initial connectivity monitor exit");
+    }
 
-        } while(doContinuousMonitor);
+    void ConnectivityMonitor::scheduleConnectivityMonitorCheck(ProbeScheduleReason reason, int intervalSec)
+    {
+        uint32_t cycle = connMonitor.cycle;
+        long intervalMs = connScheduler->nextIntervalMs(reason, intervalSec);
+        NMLOG_DEBUG("next connectivity check in %ld ms", intervalMs);
+        probeEngine.cancel(connMonitor.timerId);
+        connMonitor.timerId = probeEngine.schedule(intervalMs, [this, cycle]() {
+            if (cycle != connMonitor.cycle)
+                return;
+            connMonitor.timerId = 0;
+            runConnectivityMonitorCheck();
+        });
+    }
 
-        gIpv4InternetState = UNKNOWN;
-        gIpv6InternetState = UNKNOWN;
-        NMLOG_DEBUG("continous connectivity monitor exit");
+    void ConnectivityMonitor::runConnectivityMonitorCheck()
+    {
+        uint32_t cycle = connMonitor.cycle;
+        connScheduler->clearNextProbe();
+        connMonitor.probeInFlight = true;
+        bool submitted = probeEngine.submitProbe(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS,
+                                                 NMCONNECTIVITY_CURL_GET_REQUEST, NSM_IPRESOLVE_WHATEVER, NMCONNECTIVITY_EARLY_QUORUM,
+            [this, cycle](const ProbeResult& result) {
+                if (cycle != connMonitor.cycle || result.aborted)
+                    return;
+                TestConnectivity testInternet(result);
+                setFamilyState(NSM_IPRESOLVE_WHATEVER, testInternet.getInternetState(), testInternet.getConfidence(), testInternet.getCaptivePortal());
+                onConnectivityMonitorResult(testInternet.getInternetState());
+            });
+        if (!submitted)
+            connMonitor.probeInFlight = false;
     }
 
-    void ConnectivityMonitor::connectivityMonitorFunction()
+    void ConnectivityMonitor::onConnectivityMonitorResult(nsm_internetState currentInternetState)
     {
         int TempInterval = NMCONNECTIVITY_MONITOR_MIN_INTERVAL;
-        std::mutex connMutex;
-        bool notifyNow = true;
-        int notifyPreRetry = 1;
-        nsm_internetState currentInternetState = nsm_internetState::UNKNOWN;
-        nsm_internetState tempInternetState = nsm_internetState::UNKNOWN;
-
-        do
-        {
-            TestConnectivity testInternet(getConnectivityMonitorEndpoints(), NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS, 
-                                                                            NMCONNECTIVITY_CURL_GET_REQUEST, NSM_IPRESOLVE_WHATEVER);
-            currentInternetState = testInternet.getInternetState();
-            if(currentInternetState == CAPTIVE_PORTAL)
+        nsm_internetState previousInternetState = gInternetState;
+        connMonitor.probeInFlight = false;
+
+        if(currentInternetState == CAPTIVE_PORTAL)
+        {
+            /* set to every 30 sec interval */
+            TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
+        }
+        else if(currentInternetState == LIMITED_INTERNET)
+        {
+            TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
+        }
+        else // fullyconnect / noInternet
+        {
+            if(connMonitor.notifyPreRetry <= NMCONNECTIVITY_CONN_MONITOR_RETRY_COUNT - 1)
             {
-                /* set to every 30 sec interval */
-                TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
+                if(connMonitor.tempInternetState != currentInternetState ) // check for continous same state
+                {
+                    connMonitor.tempInternetState = currentInternetState;
+                    connMonitor.notifyPreRetry = 1;
+                    NMLOG_INFO("Connectivity check retrying %d ...", connMonitor.notifyPreRetry);
+                }
+                else
+                {
+                    connMonitor.notifyPreRetry++;
+                    NMLOG_INFO("Connectivity check retrying %d ...", connMonitor.notifyPreRetry);
+                }
+
+                if(gInternetState != UNKNOWN)
+                    currentInternetState = gInternetState;
+                TempInterval = 5;
             }
-            else if(currentInternetState == LIMITED_INTERNET)
+            else if(connMonitor.tempInternetState != currentInternetState) // last state have change
             {
-                TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
+                connMonitor.tempInternetState = currentInternetState;
+                connMonitor.notifyPreRetry = 1;
+                TempInterval = 5;
+                NMLOG_INFO("Connectivity check retrying %d ...", connMonitor.notifyPreRetry);
             }
-            else // fullyconnect / noInternet
+            else
             {
-                if(notifyPreRetry <= NMCONNECTIVITY_CONN_MONITOR_RETRY_COUNT - 1)
-                {
-                    if(tempInternetState != currentInternetState ) // check for continous same state
-                    {
-                        tempInternetState = currentInternetState;
-                        notifyPreRetry = 1;
-                        NMLOG_INFO("Connectivity check retrying %d ...", notifyPreRetry);
-                    }
-                    else
-                    {
-                        notifyPreRetry++;
-                        NMLOG_INFO("Connectivity check retrying %d ...", notifyPreRetry);
-                    }
-
-                    if(gInternetState != UNKNOWN)
-                        currentInternetState = gInternetState;
-                    TempInterval = 5;
-                }
-                else if(tempInternetState != currentInternetState) // last state have change
+                if(currentInternetState == FULLY_CONNECTED)
                 {
-                    tempInternetState = currentInternetState;
-                    notifyPreRetry = 1;
-                    TempInterval = 5;
-                    NMLOG_INFO("Connectivity check retrying %d ...", notifyPreRetry);
+                    doConnectivityMonitor = false;  // self exit
+                    connMonitor.notifyNow = true; // post current state when retry complete
                 }
-                else
+                else if(ginterfaceStatus) // interface is active and still no internet, continue check every 30 sec
                 {
-                    if(currentInternetState == FULLY_CONNECTED)
+                    TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
+                    /* notify if retry completed and state stil no internet state */
+                    if(connMonitor.notifyPreRetry == NMCONNECTIVITY_CONN_MONITOR_RETRY_COUNT)
                     {
-                        doConnectivityMonitor = false;  // self exit
-                        notifyNow = true; // post current state when retry complete
-                    }
-                    else if(ginterfaceStatus) // interface is active and still no internet, continue check every 30 sec
-                    {
-                        TempInterval = NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL;
-                        /* notify if retry completed and state stil no internet state */
-                        if(notifyPreRetry == NMCONNECTIVITY_CONN_MONITOR_RETRY_COUNT)
-                        {
-                            notifyPreRetry++;
-                            notifyNow = true;
-                        }
-                    }
-                    else // no interface connected
-                    {
-                        doConnectivityMonitor = false;
-                        notifyNow = true;
+                        connMonitor.notifyPreRetry++;
+                        connMonitor.notifyNow = true;
                     }
                 }
+                else // no interface connected
+                {
+                    doConnectivityMonitor = false;
+                    connMonitor.notifyNow = true;
+                }
             }
+        }
 
-            if(gInternetState != currentInternetState || notifyNow)
-            {
-                notifyNow = false;
-                NMLOG_INFO("notify internet state %s", getInternetStateString(currentInternetState));
-                notifyInternetStatusChangedEvent(currentInternetState);
-            }
+        if(gInternetState != currentInternetState || connMonitor.notifyNow)
+        {
+            connMonitor.notifyNow = false;
+            NMLOG_INFO("notify internet state %s", getInternetStateString(currentInternetState));
+            notifyInternetStatusChangedEvent(currentInternetState);
+        }
 
-            if(!doConnectivityMonitor)
-                break;
-            /* wait for next interval */
-            std::unique_lock<std::mutex> lock(connMutex);
-            if (cvConnectivityMonitor.wait_for(lock, std::chrono::seconds(TempInterval)) != std::cv_status::timeout) {
-                NMLOG_INFO("connectivity monitor recieved signal. skping %d sec interval", TempInterval);
-                notifyPreRetry = 1;
-                notifyNow = true;  // new signal came should notify in next check
-            }
-            
-        } while(doConnectivityMonitor);
+        if (connMonitor.signalled)
+        {
+            /* interface changed while the probe was running; check again right away */
+            connMonitor.signalled = false;
+            doConnectivityMonitor = true;
+            NMLOG_INFO("connectivity monitor recieved signal. skping %d sec interval", TempInterval);
+            connMonitor.notifyPreRetry = 1;
+            connMonitor.notifyNow = true;
+            TempInterval = 0;
+        }
 
-        if(!doContinuousMonitor)
-            gInternetState = nsm_internetState::UNKNOWN; // no continous monitor running reset to unknow
-        NMLOG_DEBUG("initial connectivity monitor exit");
+        if(!doConnectivityMonitor)
+        {
+            finishConnectivityMonitor();
+            return;
+        }
+
+        /* the short retries keep their pace, the long captive / limited / no internet waits back off */
+        ProbeScheduleReason scheduleReason = SCHEDULE_RETRY;
+        if (TempInterval == 0)
+            scheduleReason = SCHEDULE_LINK_EVENT;
+        else if (TempInterval == NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL)
+            scheduleReason = (previousInternetState == currentInternetState) ? SCHEDULE_STATE_STABLE : SCHEDULE_STATE_CHANGED;
+        /* wait for next interval */
+        scheduleConnectivityMonitorCheck(scheduleReason, TempInterval);
     }
 
     } // namespace Plugin
@@ -25,6 +25,10 @@
 #include <thread>
 #include <chrono>
 #include <map>
+#include <list>
+#include <functional>
+#include <memory>
+#include <random>
 #include <curl/curl.h>
 #include <condition_variable>
 #include <mutex>
@@ -64,6 +68,8 @@ enum nsm_connectivity_httpcode {
 
 #define NMCONNECTIVITY_CURL_HEAD_REQUEST          true
 #define NMCONNECTIVITY_CURL_GET_REQUEST           false
+#define NMCONNECTIVITY_EARLY_QUORUM               true   // vote as responses arrive, cancel the rest once decided
+#define NMCONNECTIVITY_FULL_VOTE                  false  // wait for every endpoint before voting
 
 #define NMCONNECTIVITY_MONITOR_DEFAULT_INTERVAL   60     // sec
 #define NMCONNECTIVITY_MONITOR_MIN_INTERVAL       5      // sec
@@ -72,6 +78,23 @@ enum nsm_connectivity_httpcode {
 #define NMCONNECTIVITY_CONN_MONITOR_RETRY_COUNT   3      // 3 retry
 #define NMCONNECTIVITY_CAPTIVE_MONITOR_INTERVAL   30     //  sec
 #define NMCONNECTIVITY_CONN_MONITOR_RETRY_INTERVAL   30     //  sec
+#define NMCONNECTIVITY_CURL_DNS_CACHE_TIMEOUT     120    // sec
+#define NMCONNECTIVITY_CURL_MAX_CONNECTION_AGE    110    // sec, keep-alive connection reuse limit
+#define NMCONNECTIVITY_CURL_MAX_IDLE_HANDLES      2      // pooled easy handles per endpoint
+#define NMCONNECTIVITY_REACTOR_MAX_EVENTS         16
+#define NMCONNECTIVITY_SCHEDULER_MAX_BACKOFF      4      // stable state interval grows up to 4 x base interval
+#define NMCONNECTIVITY_SCHEDULER_JITTER_PERCENT   15     // +/- randomization of every interval
+#define NMCONNECTIVITY_CAPTIVE_RECORD_MAX_AGE_MS  120000 // captive portal record older than this needs a new probe
+#define NMCONNECTIVITY_SNAPSHOT_FRESH_MS          2000   // on-demand verdict younger than this is served without probing
+#define NMCONNECTIVITY_RACE_DEFAULT_DELAY_MS      250    // RFC 8305 connection attempt delay
+#define NMCONNECTIVITY_RACE_MIN_DELAY_MS          100
+#define NMCONNECTIVITY_RACE_MAX_DELAY_MS          2000
+#define NMCONNECTIVITY_STATISTICS_MAX_ENDPOINTS   16     // per endpoint statistics kept, least recently probed dropped first
+#define NMCONNECTIVITY_RANKED_ENDPOINTS           1      // endpoints asked by a steady state probe
+#define NMCONNECTIVITY_RANKING_REFRESH_PROBES     10     // every 10th steady state probe asks all endpoints to refresh the ranking
+#define NMCONNECTIVITY_BREAKER_FAILURES           3      // consecutive failures opening the endpoint circuit breaker
+#define NMCONNECTIVITY_BREAKER_COOLDOWN_MS        30000  // first cooldown, doubled on every reopen
+#define NMCONNECTIVITY_BREAKER_MAX_COOLDOWN_MS    600000
 
 namespace WPEFramework
 {
@@ -90,21 +113,395 @@ namespace WPEFramework
                 std::string CachefilePath;
         };
 
+        enum ProbeErrorClass {
+            PROBE_ERROR_NONE,
+            PROBE_ERROR_DNS,
+            PROBE_ERROR_CONNECT,
+            PROBE_ERROR_TLS,
+            PROBE_ERROR_TIMEOUT,
+            PROBE_ERROR_HTTP,           /* transfer completed with a 4xx / 5xx that is not a portal */
+            PROBE_ERROR_OTHER,
+            PROBE_ERROR_CLASS_MAX
+        };
+
+        /* one completed transfer; phase durations in microseconds, connection phases are 0 on a reused connection */
+        struct ProbeTransferSample {
+            std::string endpoint;
+            nsm_ipversion ipversion = NSM_IPRESOLVE_WHATEVER;
+            long responseCode = -1;
+            ProbeErrorClass errorClass = PROBE_ERROR_NONE;
+            bool reusedConnection = false;
+            long dnsUs = 0;
+            long connectUs = 0;
+            long tlsUs = 0;
+            long ttfbUs = 0;             /* request sent to first response byte */
+            long totalUs = 0;
+        };
+
+        /* result of one probe round against all the endpoints */
+        struct ProbeResult {
+            std::vector<int> responses;
+            std::string captivePortalURI;
+            long captiveStatusCode = 0;      /* 302 or 511 when a portal answered */
+            int newConnections = 0;
+            int reusedConnections = 0;
+            long handshakeSavedMs = 0;
+            bool aborted = false;            /* probe engine stopped before the probe completed */
+            bool earlyDecision = false;      /* verdict decided before every endpoint answered */
+            int endpointCount = 0;
+            long decisionLatencyMs = 0;      /* probe start to verdict */
+            std::vector<ProbeTransferSample> samples;
+        };
+
+        struct ProbeEngineStats {
+            uint64_t probes;
+            uint64_t transfers;
+            uint64_t newConnections;
+            uint64_t reusedConnections;
+            uint64_t handshakeSavedMs;       /* total DNS + TCP + TLS time saved by reused connections */
+            long lastProbeHandshakeSavedMs;
+            uint64_t earlyDecisions;
+            uint64_t cancelledTransfers;
+            long lastDecisionLatencyMs;
+        };
+
+        /* captive portal seen by the probes, updated by every completed probe that got a 302 / 511 or a 204 */
+        struct CaptivePortalRecord {
+            bool active = false;             /* portal seen and no 204 since */
+            std::string uri;
+            long statusCode = 0;
+            nsm_ipversion ipversion = NSM_IPRESOLVE_WHATEVER;
+            long detectedTime = 0;           /* monotonic ms the portal was first seen */
+            long lastSeenTime = 0;
+            long updateTime = 0;             /* last probe that said portal or no portal, 0 never */
+        };
+
+        /*
+         * long lived curl probe engine; one reactor thread drives every probe through curl_multi_socket_action
+         * on an epoll set. keep-alive connections, DNS entries and easy handles are kept between the checks.
+         * monitors run on the reactor thread as posted and scheduled tasks instead of owning threads.
+         */
+        class ConnectivityProbeEngine
+        {
+        public:
+            typedef std::function<void(const ProbeResult&)> ProbeCallback;
+            typedef std::function<void()> Task;
+
+            ConnectivityProbeEngine();
+            ~ConnectivityProbeEngine();
+            void stop();
+            /* blocking probe; must not be called on the reactor thread */
+            ProbeResult probe(const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion, bool earlyQuorum);
+            /* callback is invoked on the reactor thread; returns the probe id, 0 on failure */
+            uint32_t submitProbe(const std::vector<std::string>& endpoints, long timeout_ms, bool headReq, nsm_ipversion ipversion, bool earlyQuorum, ProbeCallback callback);
+            /* cancelled probe does not call back */
+            void cancelProbe(uint32_t probeId);
+            bool post(Task task);
+            uint32_t schedule(long delay_ms, Task task);
+            void cancel(uint32_t taskId);
+            bool isReactorThread() const { return std::this_thread::get_id() == reactorThreadId; }
+            /* drop pooled handles and connections, taken by the next probe */
+            void reset() { resetGeneration++; }
+            /* called on the reactor thread for every completed probe before its own callback; set before the first probe */
+            void setProbeObserver(ProbeCallback observer) { probeObserver = observer; }
+            ProbeEngineStats getStats() const;
+            CaptivePortalRecord getCaptivePortalRecord() const;
+
+        private:
+            ConnectivityProbeEngine(const ConnectivityProbeEngine&) = delete;
+            ConnectivityProbeEngine& operator=(const ConnectivityProbeEngine&) = delete;
+
+            struct ProbeRequest;
+            struct ProbeTransfer {
+                ProbeRequest *request;
+                std::string endpoint;
+                std::string poolKey;
+                uint32_t generation;
+                CURL *easyHandle;
+            };
+            struct ProbeRequest {
+                uint32_t id;
+                std::vector<std::string> endpoints;
+                long timeout_ms;
+                bool headReq;
+                nsm_ipversion ipversion;
+                bool earlyQuorum;
+                long startTime;
+                ProbeCallback callback;
+                std::list<ProbeTransfer> transfers;
+                int pending;
+                ProbeResult result;
+            };
+            struct ScheduledTask {
+                long deadline;
+                Task task;
+            };
+
+            void reactorFunction();
+            void runPostedWork();
+            void runDueTasks();
+            void armTaskTimer();
+            void startProbe(ProbeRequest *request);
+            void processCompletedTransfers();
+            void completeProbe(ProbeRequest *request);
+            void cancelTransfers(ProbeRequest *request);
+            void dropProbe(uint32_t probeId);
+            void updateCaptivePortalRecord(const ProbeRequest *request);
+            void abortProbes();
+            CURL* acquireEasyHandle(const std::string& poolKey, const std::string& endpoint, nsm_ipversion ipversion);
+            void releaseEasyHandle(const ProbeTransfer& transfer);
+            void dropIdleHandles();
+            bool createMultiHandle();
+            void recycleConnections();
+            static int socketCallback(CURL *easy, curl_socket_t sockfd, int what, void *userp, void *socketp);
+            static int timerCallback(CURLM *multi, long timeout_ms, void *userp);
+
+            /* reactor */
+            std::thread reactorThread;
+            std::thread::id reactorThreadId;
+            std::atomic<bool> reactorRunning;
+            int epollFd;
+            int wakeupFd;
+            int curlTimerFd;
+            int taskTimerFd;
+
+            /* posted work, guarded by queueMutex */
+            std::mutex queueMutex;
+            std::vector<Task> postedTasks;
+            std::vector<ProbeRequest*> pendingRequests;
+            std::map<uint32_t, ScheduledTask> scheduledTasks;
+            uint32_t nextTaskId;
+            uint32_t nextProbeId;
+
+            /* reactor thread only */
+            CURLM *multiHandle;
+            CURLSH *curlShare;
+            struct curl_slist *curlHeaders;
+            std::multimap<std::string, CURL*> idleHandles;
+            std::map<std::string, long> handshakeCostMs; /* last measured new connection cost per endpoint */
+            std::list<ProbeRequest*> activeRequests;
+            int activeTransfers;
+            uint32_t poolGeneration;
+            bool recyclePending;
+            ProbeCallback probeObserver;
+
+            mutable std::mutex captiveMutex;
+            CaptivePortalRecord captiveRecord;
+
+            std::atomic<uint32_t> resetGeneration;
+            std::atomic<uint64_t> statProbes;
+            std::atomic<uint64_t> statTransfers;
+            std::atomic<uint64_t> statNewConnections;
+            std::atomic<uint64_t> statReusedConnections;
+            std::atomic<uint64_t> statHandshakeSavedMs;
+            std::atomic<long> statLastProbeSavedMs;
+            std::atomic<uint64_t> statEarlyDecisions;
+            std::atomic<uint64_t> statCancelledTransfers;
+            std::atomic<long> statLastDecisionLatencyMs;
+        };
+
+        /* per ip family probe history used to order the dual stack race, reactor thread only */
+        class DualStackHistory
+        {
+        public:
+            struct FamilyHistory {
+                long rttMs = 0;            /* smoothed verdict latency of conclusive probes */
+                float successRate = 0.5;   /* smoothed share of FULLY_CONNECTED verdicts */
+                uint32_t wins = 0;
+                uint32_t probes = 0;
+            };
+
+            void record(nsm_ipversion ipversion, bool fullyConnected, long latencyMs);
+            nsm_ipversion preferredFamily() const;
+            long attemptDelayMs(nsm_ipversion ipversion) const;
+            const FamilyHistory& get(nsm_ipversion ipversion) const { return ipversion == NSM_IPRESOLVE_V4 ? ipv4 : ipv6; }
+        private:
+            FamilyHistory ipv4;
+            FamilyHistory ipv6;
+        };
+
+        struct RaceResult {
+            nsm_ipversion winner = NSM_IPRESOLVE_WHATEVER;   /* family that answered FULLY_CONNECTED first */
+            nsm_internetState internetState = UNKNOWN;
+            nsm_internetState ipv4State = UNKNOWN;
+            nsm_internetState ipv6State = UNKNOWN;
+            long decisionLatencyMs = 0;
+            float confidence = 0;
+            int probes = 0;
+        };
+
+        /* immutable internet state record, replaced as a whole on every update and read without locking */
+        struct InternetStateSnapshot {
+            struct FamilyVerdict {
+                nsm_internetState internetState = UNKNOWN;
+                long probeTime = 0;          /* monotonic ms of the probe, 0 never probed */
+                float confidence = 0;        /* share of the endpoint votes behind the verdict */
+            };
+            uint64_t version = 0;
+            nsm_internetState internetState = UNKNOWN;   /* last notified state */
+            FamilyVerdict verdict[3];                    /* indexed by nsm_ipversion */
+            std::string captivePortalURI;
+            long lastProbeTime = 0;
+        };
+
         class TestConnectivity
         {
             TestConnectivity(const TestConnectivity&) = delete;
             const TestConnectivity& operator=(const TestConnectivity&) = delete;
 
         public:
-            TestConnectivity(const std::vector<std::string>& endpoints, long timeout_ms = 2000, bool  = true, nsm_ipversion ipversion = NSM_IPRESOLVE_WHATEVER);
+            TestConnectivity(ConnectivityProbeEngine& probeEngine, const std::vector<std::string>& endpoints, long timeout_ms = 2000, bool headReq = true, nsm_ipversion ipversion = NSM_IPRESOLVE_WHATEVER, bool earlyQuorum = NMCONNECTIVITY_EARLY_QUORUM);
+            explicit TestConnectivity(const ProbeResult& probeResult);
             ~TestConnectivity(){}
             std::string getCaptivePortal() {return captivePortalURI;}
             nsm_internetState getInternetState(){return internetSate;}
+            long getDecisionLatency() {return decisionLatencyMs;}
+            float getConfidence() {return confidence;}
+
+            typedef std::function<void(const RaceResult&)> RaceCallback;
+            /*
+             * happy eyeballs (RFC 8305) style dual stack check; the preferred family starts first, the other one
+             * after the attempt delay or as soon as the first one fails. first FULLY_CONNECTED verdict wins and
+             * cancels the other probe. must be called on the reactor thread, callback runs there too.
+             */
+            static bool race(ConnectivityProbeEngine& probeEngine, DualStackHistory& history, const std::vector<std::string>& endpoints,
+                                                                                long timeout_ms, bool headReq, RaceCallback callback);
         private:
-            nsm_internetState checkCurlResponse(const std::vector<std::string>& endpoints, long timeout_ms,  bool headReq, nsm_ipversion ipversion);
             nsm_internetState checkInternetStateFromResponseCode(const std::vector<int>& responses);
             std::string captivePortalURI;
             nsm_internetState internetSate;
+            long decisionLatencyMs;
+            float confidence;
+        };
+
+        enum ProbeScheduleReason {
+            SCHEDULE_STATE_STABLE,      /* same verdict as last time */
+            SCHEDULE_STATE_CHANGED,     /* verdict changed, confirm it soon */
+            SCHEDULE_RETRY,             /* monitor retry logic asked for this interval */
+            SCHEDULE_LINK_EVENT         /* interface or ip change */
+        };
+
+        struct ProbeScheduleInfo {
+            long intervalMs;            /* last interval handed out */
+            long nextProbeInMs;         /* -1 when no probe is scheduled */
+            int backoffLevel;
+            uint64_t scheduledProbes;
+            uint64_t avoidedProbes;     /* probes the fixed base interval would have sent in the same time */
+        };
+
+        /* decides the wait before the next connectivity probe of a monitor */
+        class ProbeScheduler
+        {
+        public:
+            ProbeScheduler();
+            virtual ~ProbeScheduler() {}
+            /* baseSec is the interval the monitor logic asks for */
+            long nextIntervalMs(ProbeScheduleReason reason, int baseSec);
+            void clearNextProbe() { nextProbeTime = -1; }
+            ProbeScheduleInfo getInfo() const;
+            virtual void reset() {}
+        protected:
+            virtual long computeIntervalMs(ProbeScheduleReason reason, long baseMs) = 0;
+            std::atomic<int> backoffLevel;
+        private:
+            std::atomic<long> lastIntervalMs;
+            std::atomic<long> nextProbeTime;
+            std::atomic<uint64_t> scheduledProbes;
+            std::atomic<uint64_t> avoidedMilliProbes;
+        };
+
+        /* legacy behaviour, always the interval the monitor asks for */
+        class FixedProbeScheduler : public ProbeScheduler
+        {
+        protected:
+            long computeIntervalMs(ProbeScheduleReason reason, long baseMs) override { return baseMs; }
+        };
+
+        /* exponential backoff while the verdict is stable, fast re-probe on changes, randomized jitter */
+        class AdaptiveProbeScheduler : public ProbeScheduler
+        {
+        public:
+            AdaptiveProbeScheduler();
+            void reset() override { backoffLevel = 0; }
+        protected:
+            long computeIntervalMs(ProbeScheduleReason reason, long baseMs) override;
+        private:
+            std::mt19937 randomGenerator;
+        };
+
+        /*
+         * fixed size log-linear latency histogram in microseconds; 4 linear sub buckets per power of two keep
+         * the bucket error under 25% up to 2^28 us, larger samples are counted in the last bucket.
+         */
+        class LatencyHistogram
+        {
+        public:
+            static const int BUCKETS = 108;
+
+            LatencyHistogram() { clear(); }
+            void clear();
+            void record(long valueUs);
+            uint64_t count() const { return samples; }
+            long min() const { return samples ? minUs : 0; }
+            long max() const { return maxUs; }
+            long mean() const { return samples ? static_cast<long>(sumUs / samples) : 0; }
+            /* upper bound of the bucket holding the given percentile, capped to the largest sample */
+            long percentile(int percent) const;
+
+        private:
+            static int bucketIndex(uint64_t valueUs);
+            static uint64_t bucketUpperBound(int index);
+            uint32_t buckets[BUCKETS];
+            uint64_t samples;
+            uint64_t sumUs;
+            long minUs;
+            long maxUs;
+        };
+
+        struct EndpointStatistics {
+            uint64_t transfers = 0;
+            uint64_t reusedConnections = 0;
+            LatencyHistogram dns;
+            LatencyHistogram connect;
+            LatencyHistogram tls;
+            LatencyHistogram ttfb;
+            LatencyHistogram total;
+            std::map<long, uint64_t> responseCodes;   /* -1 counts transfers without a response */
+            uint64_t errors[PROBE_ERROR_CLASS_MAX] = {};
+            long lastResponseCode = 0;
+            long lastProbeTime = 0;
+        };
+
+        /*
+         * ranks the endpoints by expected probe cost; the smoothed round trip of the successful transfers plus
+         * the smoothed failure share weighted with the probe timeout. an endpoint failing while another one
+         * of the same probe answered is counted as failed, a probe where every endpoint failed says nothing
+         * about the endpoints. repeated failures open a circuit breaker and keep the endpoint out of the
+         * selection for a cooldown that doubles on every reopen.
+         */
+        class EndpointRanker
+        {
+        public:
+            struct EndpointHealth {
+                long rttMs = 0;                  /* smoothed total time of successful transfers */
+                float failureRate = 0;
+                uint32_t samples = 0;
+                uint32_t consecutiveFailures = 0;
+                long cooldownMs = NMCONNECTIVITY_BREAKER_COOLDOWN_MS;
+                long openUntil = 0;              /* monotonic ms, circuit open while in the future */
+                long scoreMs() const { return rttMs + static_cast<long>(failureRate * NMCONNECTIVITY_CURL_REQUEST_TIMEOUT_MS); }
+            };
+
+            EndpointRanker() : selections(0) {}
+            void record(const ProbeResult& result, long now);
+            /* best topK endpoints with a closed circuit, all of them on a refresh round; ranked is false when nothing was left out */
+            std::vector<std::string> select(const std::vector<std::string>& endpoints, size_t topK, long now, bool& ranked);
+            std::map<std::string, EndpointHealth> getHealth() const;
+
+        private:
+            mutable std::mutex rankerMutex;
+            std::map<std::string, EndpointHealth> health;
+            uint32_t selections;
         };
 
         class ConnectivityMonitor
@@ -120,30 +517,89 @@ namespace WPEFramework
             bool isConnectedToInternet(nsm_ipversion ipversion);
             nsm_internetState getInternetState(nsm_ipversion ipversion);
             std::string getCaptivePortalURI();
+            std::shared_ptr<const InternetStateSnapshot> getInternetStateSnapshot() const { return std::atomic_load(&stateSnapshot); }
+            ProbeEngineStats getProbeEngineStats() const { return probeEngine.getStats(); }
+            ProbeScheduleInfo getConnectivityMonitorSchedule() const { return connScheduler->getInfo(); }
+            ProbeScheduleInfo getContinuousMonitorSchedule() const { return contScheduler->getInfo(); }
+            std::map<std::string, EndpointStatistics> getEndpointStatistics() const;
+            std::map<std::string, EndpointRanker::EndpointHealth> getEndpointHealth() const { return endpointRanker.getHealth(); }
+            static const char* getProbeErrorClassString(ProbeErrorClass errorClass);
 
         private:
             ConnectivityMonitor(const ConnectivityMonitor&) = delete;
             ConnectivityMonitor& operator=(const ConnectivityMonitor&) = delete;
-            void connectivityMonitorFunction();
             void notifyInternetStatusChangedEvent(nsm_internetState newState);
+            void publishSnapshot(const std::function<void(InternetStateSnapshot&)>& update);
+            void setFamilyState(nsm_ipversion ipversion, nsm_internetState internetState, float confidence = 0, const std::string& captivePortalURI = "");
+            nsm_internetState runOnDemandProbe(nsm_ipversion ipversion, std::string& captivePortalURI);
+            void recordProbeStatistics(const ProbeResult& result);
+
+            /* on-demand probes, concurrent callers of one ip family share the probe in flight */
+            struct OnDemandProbe {
+                bool inFlight = false;
+                uint64_t generation = 0;
+                nsm_internetState internetState = UNKNOWN;
+                std::string captivePortalURI;
+            };
+
+            /* monitor states below are only touched on the probe engine reactor thread */
+            struct InitialMonitorState {
+                bool active = false;
+                bool probeInFlight = false;
+                bool signalled = false;
+                uint32_t cycle = 0;
+                uint32_t timerId = 0;
+                int notifyPreRetry = 1;
+                bool notifyNow = true;
+                nsm_internetState tempInternetState = UNKNOWN;
+            };
+            struct ContinuousMonitorState {
+                bool active = false;
+                bool probeInFlight = false;
+                bool signalled = false;
+                uint32_t cycle = 0;
+                uint32_t timerId = 0;
+                int notifyPreRetry = 1;
+                nsm_ipversion ipResolveTyp = NSM_IPRESOLVE_WHATEVER;
+            };
+
             /* connectivity monitor */
-            std::thread connectivityMonitorThrd;
-            std::condition_variable cvConnectivityMonitor;
+            void triggerConnectivityMonitor();
+            void runConnectivityMonitorCheck();
+            void onConnectivityMonitorResult(nsm_internetState currentInternetState);
+            void finishConnectivityMonitor();
+            void scheduleConnectivityMonitorCheck(ProbeScheduleReason reason, int intervalSec);
+            InitialMonitorState connMonitor;
+            std::unique_ptr<ProbeScheduler> connScheduler;
             std::atomic<int> continuousMonitorTimeout;
             std::atomic<bool> doConnectivityMonitor;
             std::vector<std::string> connectivityMonitorEndpt;
             /*continuous connectivity monitor */
+            void triggerContinuousMonitor();
+            void runContinuousMonitorCheck();
+            void onContinuousMonitorResult(nsm_internetState currentInternetState);
+            void finishContinuousMonitor();
+            void scheduleContinuousMonitorCheck(ProbeScheduleReason reason, int intervalSec);
+            bool submitContinuousProbe(nsm_ipversion ipResolveTyp, const std::vector<std::string>& endpoints, bool ranked);
+            ContinuousMonitorState contMonitor;
+            std::unique_ptr<ProbeScheduler> contScheduler;
+            DualStackHistory dualStackHistory;
             std::atomic<bool> doContinuousMonitor;
-            std::thread continuousMonitorThrd;
-            std::condition_variable cvContinuousMonitor;
-            void continuousMonitorFunction();
 
             EndpointCache endpointCache;
             std::mutex endpointMutex;
             std::atomic<bool> ginterfaceStatus;
             std::atomic<nsm_internetState> gInternetState;
-            std::atomic<nsm_internetState> gIpv4InternetState;
-            std::atomic<nsm_internetState> gIpv6InternetState;
+            std::shared_ptr<const InternetStateSnapshot> stateSnapshot;   /* std::atomic_load / std::atomic_store only */
+            std::mutex snapshotWriteMutex;
+            std::mutex onDemandMutex;
+            std::condition_variable onDemandCv;
+            OnDemandProbe onDemandProbe[3];
+            mutable std::mutex statisticsMutex;
+            std::map<std::string, EndpointStatistics> endpointStatistics;
+            EndpointRanker endpointRanker;
+            /* last member, the reactor is stopped before the monitor states go away */
+            ConnectivityProbeEngine probeEngine;
         };
     } // namespace Plugin
 } // namespace WPEFramework
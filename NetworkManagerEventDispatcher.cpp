@@ -0,0 +1,354 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include "NetworkManagerEventDispatcher.h"
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        EventDispatcher::Subscriber::Subscriber(Exchange::INetworkManager::INotification* notification)
+            : notification(notification)
+            , removed(false)
+            , slowStrikes(0)
+        {
+            notification->AddRef();
+        }
+
+        EventDispatcher::Subscriber::~Subscriber()
+        {
+            /* last snapshot holding the subscriber is gone */
+            notification->Release();
+        }
+
+        EventDispatcher::EventDispatcher()
+            : ring(NM_EVENT_QUEUE_SIZE)
+            , ringHead(0)
+            , ringCount(0)
+            , overflowing(false)
+            , coalesceWindowMs(NM_EVENT_COALESCE_WINDOW_MS)
+            , running(false)
+            , subscribers(std::make_shared<SubscriberList>())
+            , delivering(nullptr)
+        {
+        }
+
+        EventDispatcher::~EventDispatcher()
+        {
+            stop();
+        }
+
+        const char* EventDispatcher::getEventName(NotificationEventType type)
+        {
+            switch (type)
+            {
+                case NOTIFY_INTERFACE_STATE:        return "onInterfaceStateChange";
+                case NOTIFY_IP_ADDRESS:             return "onIPAddressChange";
+                case NOTIFY_ACTIVE_INTERFACE:       return "onActiveInterfaceChange";
+                case NOTIFY_INTERNET_STATUS:        return "onInternetStatusChange";
+                case NOTIFY_AVAILABLE_SSIDS:        return "onAvailableSSIDs";
+                case NOTIFY_WIFI_STATE:             return "onWiFiStateChange";
+                case NOTIFY_WIFI_SIGNAL_STRENGTH:   return "onWiFiSignalStrengthChange";
+                case NOTIFY_WIFI_SCAN_DELTA:        return "onWiFiScanDelta";
+                case NOTIFY_PING_RESULT:            return "onPingResult";
+                case NOTIFY_TRACE_RESULT:           return "onTraceResult";
+                default:                            return "unknown";
+            }
+        }
+
+        bool EventDispatcher::isLossy(NotificationEventType type)
+        {
+            /* the next signal strength event carries everything the skipped one did */
+            return type == NOTIFY_WIFI_SIGNAL_STRENGTH;
+        }
+
+        void EventDispatcher::start()
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (running)
+                return;
+            running = true;
+            dispatcherThread = std::thread(&EventDispatcher::dispatcherThreadFunction, this);
+        }
+
+        void EventDispatcher::stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (!running)
+                    return;
+                running = false;
+                if (ringCount > 0)
+                    NMLOG_WARNING("dropping %zu undelivered events", ringCount);
+                for (size_t i = 0; i < ringCount; i++)
+                    ring[(ringHead + i) % ring.size()].delivery = nullptr;
+                ringCount = 0;
+            }
+            queueCv.notify_all();
+            if (dispatcherThread.joinable())
+                dispatcherThread.join();
+        }
+
+        std::shared_ptr<const EventDispatcher::SubscriberList> EventDispatcher::snapshot() const
+        {
+            std::lock_guard<std::mutex> lock(subscribersMutex);
+            return subscribers;
+        }
+
+        bool EventDispatcher::subscribe(Exchange::INetworkManager::INotification* notification)
+        {
+            std::lock_guard<std::mutex> lock(subscribersMutex);
+            for (const auto& subscriber : *subscribers)
+            {
+                if (subscriber->notification == notification)
+                    return false;
+            }
+            std::shared_ptr<SubscriberList> updated = std::make_shared<SubscriberList>(*subscribers);
+            updated->push_back(std::make_shared<Subscriber>(notification));
+            subscribers = updated;
+            return true;
+        }
+
+        bool EventDispatcher::unsubscribe(Exchange::INetworkManager::INotification* notification)
+        {
+            std::shared_ptr<Subscriber> removed;
+            {
+                std::lock_guard<std::mutex> lock(subscribersMutex);
+                std::shared_ptr<SubscriberList> updated = std::make_shared<SubscriberList>();
+                for (const auto& subscriber : *subscribers)
+                {
+                    if (subscriber->notification == notification)
+                        removed = subscriber;
+                    else
+                        updated->push_back(subscriber);
+                }
+                if (!removed)
+                    return false;
+                removed->removed = true;
+                subscribers = updated;
+            }
+
+            /* the worker may be inside a callback of this subscriber with an older snapshot */
+            if (std::this_thread::get_id() != dispatcherThread.get_id())
+            {
+                std::unique_lock<std::mutex> lock(deliveringMutex);
+                deliveringCv.wait(lock, [&] { return delivering != removed.get(); });
+            }
+            return true;
+        }
+
+        void EventDispatcher::post(NotificationEventType type, const Delivery& delivery, const std::string& key, bool coalesce)
+        {
+            auto now = std::chrono::steady_clock::now();
+            long windowMs = coalesceWindowMs;
+            if (windowMs <= 0)
+                coalesce = false;
+
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (!running)
+            {
+                NMLOG_WARNING("dispatcher not running, %s dropped", getEventName(type));
+                return;
+            }
+
+            uint32_t merged = 0;
+            auto notBefore = coalesce ? now + std::chrono::milliseconds(windowMs) : now;
+            for (size_t i = ringCount; i > 0; i--)
+            {
+                Event& pending = ring[(ringHead + i - 1) % ring.size()];
+                if (pending.type != type || pending.key != key)
+                    continue;
+                if (coalesce && pending.coalesce)
+                {
+                    merged = pending.merged + 1;
+                    notBefore = pending.notBefore;
+                    for (size_t j = i - 1; j + 1 < ringCount; j++)
+                        ring[(ringHead + j) % ring.size()] = std::move(ring[(ringHead + j + 1) % ring.size()]);
+                    ring[(ringHead + ringCount - 1) % ring.size()].delivery = nullptr;
+                    ringCount--;
+                }
+                break;
+            }
+
+            bool dropped = false;
+            if (ringCount == ring.size())
+            {
+                /* drop the oldest lossy event, or the oldest one when there is none */
+                size_t victim = 0;
+                for (size_t i = 0; i < ringCount; i++)
+                {
+                    if (isLossy(ring[(ringHead + i) % ring.size()].type))
+                    {
+                        victim = i;
+                        break;
+                    }
+                }
+                if (!overflowing)
+                    NMLOG_WARNING("event queue full, dropping %s", getEventName(ring[(ringHead + victim) % ring.size()].type));
+                overflowing = true;
+                for (size_t i = victim; i > 0; i--)
+                    ring[(ringHead + i) % ring.size()] = std::move(ring[(ringHead + i - 1) % ring.size()]);
+                ring[ringHead].delivery = nullptr;
+                ringHead = (ringHead + 1) % ring.size();
+                ringCount--;
+                dropped = true;
+            }
+            else if (overflowing)
+            {
+                NMLOG_INFO("event queue has room again");
+                overflowing = false;
+            }
+
+            Event& event = ring[(ringHead + ringCount) % ring.size()];
+            event.type = type;
+            event.delivery = delivery;
+            event.key = key;
+            event.coalesce = coalesce;
+            event.merged = merged;
+            event.posted = now;
+            event.notBefore = notBefore;
+            ringCount++;
+            uint32_t depth = static_cast<uint32_t>(ringCount);
+            lock.unlock();
+            queueCv.notify_one();
+
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            stats.posted++;
+            stats.events[type]++;
+            if (dropped)
+                stats.dropped++;
+            if (merged)
+            {
+                stats.coalesced++;
+                stats.coalescedEvents[type]++;
+            }
+            if (depth > stats.maxDepth)
+                stats.maxDepth = depth;
+        }
+
+        void EventDispatcher::deliver(Subscriber& subscriber, const Event& event)
+        {
+            bool lossy = isLossy(event.type);
+            {
+                std::lock_guard<std::mutex> statsLock(statsMutex);
+                if (lossy && subscriber.stats.throttled)
+                {
+                    subscriber.stats.skipped++;
+                    return;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(deliveringMutex);
+                if (subscriber.removed)
+                    return;
+                delivering = &subscriber;
+            }
+
+            auto callbackStart = std::chrono::steady_clock::now();
+            event.delivery(subscriber.notification);
+            long callbackUs = static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - callbackStart).count());
+
+            {
+                std::lock_guard<std::mutex> lock(deliveringMutex);
+                delivering = nullptr;
+            }
+            deliveringCv.notify_all();
+
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            subscriber.stats.deliveries++;
+            if (callbackUs > subscriber.stats.maxCallbackUs)
+                subscriber.stats.maxCallbackUs = callbackUs;
+            if (callbackUs > NM_EVENT_SLOW_CALLBACK_MS * 1000L)
+            {
+                subscriber.stats.slowDeliveries++;
+                if (++subscriber.slowStrikes >= NM_EVENT_SLOW_CALLBACK_STRIKES && !subscriber.stats.throttled)
+                {
+                    subscriber.stats.throttled = true;
+                    NMLOG_WARNING("subscriber %p slow (%s took %ld ms), skipping lossy events", subscriber.notification, getEventName(event.type), callbackUs / 1000);
+                }
+            }
+            else
+            {
+                subscriber.slowStrikes = 0;
+                if (subscriber.stats.throttled)
+                {
+                    subscriber.stats.throttled = false;
+                    NMLOG_INFO("subscriber %p keeps up again", subscriber.notification);
+                }
+            }
+        }
+
+        void EventDispatcher::dispatcherThreadFunction()
+        {
+            NMLOG_INFO("event dispatcher started");
+            while (true)
+            {
+                Event event;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCv.wait(lock, [this] { return ringCount > 0 || !running; });
+                    if (!running)
+                        break;
+                    /* head is held for newer states; a post wakes the worker up to look at the new head */
+                    if (ring[ringHead].notBefore > std::chrono::steady_clock::now())
+                    {
+                        queueCv.wait_until(lock, ring[ringHead].notBefore);
+                        continue;
+                    }
+                    event = std::move(ring[ringHead]);
+                    ring[ringHead].delivery = nullptr;
+                    ringHead = (ringHead + 1) % ring.size();
+                    ringCount--;
+                }
+
+                auto picked = std::chrono::steady_clock::now();
+                if (event.merged)
+                    NMLOG_DEBUG("%s %s replaced %u earlier events", getEventName(event.type), event.key.c_str(), event.merged);
+                std::shared_ptr<const SubscriberList> current = snapshot();
+                for (const auto& subscriber : *current)
+                    deliver(*subscriber, event);
+                auto done = std::chrono::steady_clock::now();
+
+                std::lock_guard<std::mutex> statsLock(statsMutex);
+                stats.delivered++;
+                stats.queueLatency.record(static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(picked - event.posted).count()));
+                stats.deliveryLatency.record(static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(done - event.posted).count()));
+            }
+            NMLOG_INFO("event dispatcher stopped");
+        }
+
+        EventDispatcherStatistics EventDispatcher::getStatistics() const
+        {
+            std::shared_ptr<const SubscriberList> current = snapshot();
+            uint32_t depth = 0;
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                depth = static_cast<uint32_t>(ringCount);
+            }
+
+            std::lock_guard<std::mutex> statsLock(statsMutex);
+            EventDispatcherStatistics result = stats;
+            result.depth = depth;
+            for (const auto& subscriber : *current)
+                result.subscribers.push_back(subscriber->stats);
+            return result;
+        }
+    }
+}
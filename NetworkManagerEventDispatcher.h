@@ -0,0 +1,161 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Module.h"
+#include "INetworkManager.h"
+#include "NetworkManagerLogger.h"
+#include "NetworkManagerConnectivity.h"
+
+#define NM_EVENT_QUEUE_SIZE                 256
+#define NM_EVENT_SLOW_CALLBACK_MS           500     // a callback slower than this counts against its subscriber
+#define NM_EVENT_SLOW_CALLBACK_STRIKES      3       // consecutive slow callbacks before a subscriber is throttled
+#define NM_EVENT_COALESCE_WINDOW_MS         100     // a coalescable event waits this long for a newer state
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        enum NotificationEventType {
+            NOTIFY_INTERFACE_STATE,
+            NOTIFY_IP_ADDRESS,
+            NOTIFY_ACTIVE_INTERFACE,
+            NOTIFY_INTERNET_STATUS,
+            NOTIFY_AVAILABLE_SSIDS,
+            NOTIFY_WIFI_STATE,
+            NOTIFY_WIFI_SIGNAL_STRENGTH,
+            NOTIFY_WIFI_SCAN_DELTA,
+            NOTIFY_PING_RESULT,
+            NOTIFY_TRACE_RESULT,
+            NOTIFY_EVENT_MAX
+        };
+
+        struct SubscriberStatistics {
+            uint64_t deliveries = 0;
+            uint64_t slowDeliveries = 0;
+            uint64_t skipped = 0;               /* lossy events not sent while throttled */
+            long maxCallbackUs = 0;
+            bool throttled = false;
+        };
+
+        struct EventDispatcherStatistics {
+            uint32_t depth = 0;
+            uint32_t maxDepth = 0;
+            uint64_t posted = 0;
+            uint64_t delivered = 0;
+            uint64_t dropped = 0;               /* queue overflow */
+            uint64_t coalesced = 0;             /* superseded by a newer event with the same key */
+            uint64_t events[NOTIFY_EVENT_MAX] = {};
+            uint64_t coalescedEvents[NOTIFY_EVENT_MAX] = {};
+            LatencyHistogram queueLatency;      /* post until the worker picks the event up */
+            LatencyHistogram deliveryLatency;   /* post until every subscriber has it */
+            std::vector<SubscriberStatistics> subscribers;
+        };
+
+        /*
+         * Delivers the INotification events on one worker thread, in the order they were posted, so the
+         * reporting threads never wait on a subscriber. Posting goes into a bounded ring, when it is full the
+         * oldest lossy event is dropped first. Subscribers are a copy on write list, the worker walks a
+         * snapshot and Register/Unregister only swap the list.
+         * A subscriber whose callbacks keep taking longer than NM_EVENT_SLOW_CALLBACK_MS is throttled:
+         * lossy events, where the next one supersedes the last, are skipped for it until a callback is fast again.
+         * A coalescable event is held for the coalesce window; a newer coalescable event with the same type and
+         * key posted meanwhile replaces it and takes its place at the tail, keeping the held event's deadline, so
+         * a flapping state is delivered once, as its latest value, within the window. A non coalescable event with
+         * the same key is a barrier, nothing before it is merged with anything after it.
+         */
+        class EventDispatcher
+        {
+            public:
+                typedef std::function<void(Exchange::INetworkManager::INotification*)> Delivery;
+
+                EventDispatcher();
+                ~EventDispatcher();
+                void start();
+                /* pending events are dropped */
+                void stop();
+                /* false when already subscribed, the dispatcher holds a reference while subscribed */
+                bool subscribe(Exchange::INetworkManager::INotification* notification);
+                /* no callback reaches the subscriber once this returns */
+                bool unsubscribe(Exchange::INetworkManager::INotification* notification);
+                void post(NotificationEventType type, const Delivery& delivery, const std::string& key = "", bool coalesce = false);
+                /* 0 delivers every event as soon as the worker gets to it */
+                void setCoalesceWindow(long windowMs) { coalesceWindowMs = windowMs; }
+                EventDispatcherStatistics getStatistics() const;
+                static const char* getEventName(NotificationEventType type);
+
+            private:
+                struct Subscriber {
+                    explicit Subscriber(Exchange::INetworkManager::INotification* notification);
+                    ~Subscriber();
+                    Exchange::INetworkManager::INotification* const notification;
+                    std::atomic<bool> removed;
+                    int slowStrikes;
+                    SubscriberStatistics stats;
+                };
+                typedef std::vector<std::shared_ptr<Subscriber>> SubscriberList;
+
+                struct Event {
+                    NotificationEventType type;
+                    Delivery delivery;
+                    std::string key;
+                    bool coalesce;
+                    uint32_t merged;            /* earlier events this one replaced */
+                    std::chrono::steady_clock::time_point posted;
+                    std::chrono::steady_clock::time_point notBefore;
+                };
+
+                EventDispatcher(const EventDispatcher&) = delete;
+                EventDispatcher& operator=(const EventDispatcher&) = delete;
+                static bool isLossy(NotificationEventType type);
+                void dispatcherThreadFunction();
+                void deliver(Subscriber& subscriber, const Event& event);
+                std::shared_ptr<const SubscriberList> snapshot() const;
+
+                std::vector<Event> ring;
+                size_t ringHead;
+                size_t ringCount;
+                bool overflowing;               /* only the first drop of an overflow is logged */
+                std::atomic<long> coalesceWindowMs;
+                mutable std::mutex queueMutex;
+                std::condition_variable queueCv;
+                bool running;
+                std::thread dispatcherThread;
+
+                std::shared_ptr<const SubscriberList> subscribers;
+                mutable std::mutex subscribersMutex;
+                /* subscriber the worker is calling, unsubscribe waits for it */
+                Subscriber* delivering;
+                std::mutex deliveringMutex;
+                std::condition_variable deliveringCv;
+
+                mutable std::mutex statsMutex;
+                EventDispatcherStatistics stats;
+        };
+    }
+}
@@ -30,6 +30,7 @@
 #include "NetworkManagerLogger.h"
 #include "NetworkManagerGnomeUtils.h"
 #include "NetworkManagerImplementation.h"
+#include "WiFiScanResults.h"
 #include "INetworkManager.h"
 
 namespace WPEFramework
@@ -576,29 +577,31 @@ namespace WPEFramework
             NMLOG_ERROR("Not a wifi object ");
             return;
         }
-        JsonArray ssidList = JsonArray();
-        string ssidListJson;
         NMAccessPoint *ap = nullptr;
         const GPtrArray *accessPoints = nm_device_wifi_get_access_points(wifiDevice);
+        /* typed records only, the JSON text is made later if an onAvailableSSIDs subscriber needs it */
+        std::vector<Exchange::INetworkManager::WiFiAccessPoint> scanResults;
+        scanResults.reserve(accessPoints->len);
         for (guint i = 0; i < accessPoints->len; i++)
         {
-            JsonObject ssidObj;
             ap = static_cast<NMAccessPoint*>(accessPoints->pdata[i]);
-            ssidObj = nmUtils::apToJsonObject(ap);
-            ssidList.Add(ssidObj);
+            if (ap == nullptr)
+                continue;
+            scanResults.emplace_back();
+            nmUtils::apToWiFiAccessPoint(ap, scanResults.back());
         }
-
-        ssidList.ToString(ssidListJson);
         if(_nmEventInstance->debugLogs) {
             _nmEventInstance->debugLogs = false;
             NMLOG_INFO("Number of Access Points Available = %d", static_cast<int>(accessPoints->len));
-            NMLOG_DEBUG("Scanned APIs are  = %s",ssidListJson.c_str());
         }
 
+        std::shared_ptr<const WiFiScanResults> scan = std::make_shared<WiFiScanResults>(std::move(scanResults));
         if(_nmEventInstance->doScanNotify) {
             _nmEventInstance->doScanNotify = false;
-            _instance->ReportAvailableSSIDsEvent(ssidListJson);
+            _instance->ReportAvailableSSIDsEvent(scan);
         }
+        else
+            _instance->SetWiFiScanResults(scan);
     }
 
     void GnomeNetworkManagerEvents::setwifiScanOptions(bool doNotify, bool enableLogs)
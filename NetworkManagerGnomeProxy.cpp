@@ -551,7 +551,8 @@ namespace WPEFramework
         {
             uint32_t rc = Core::ERROR_RPC_CALL_FAILED;
             nmEvent->setwifiScanOptions(true, true);
-            if(wifi->wifiScanRequest(frequency))
+            /* waits for NetworkManager to accept the scan, not for the scan; results come with onAvailableSSIDs */
+            if(wifi->wifiScanRequestAsync(frequency).get())
                 rc = Core::ERROR_NONE;
             return rc;
         }
@@ -611,8 +612,13 @@ namespace WPEFramework
                 NMLOG_WARNING("ssid is invalied");
                 return rc;
             }
-            // Check the last scanning time and if it exceeds 10 sec do a rescanning
-            if(!wifi->isWifiScannedRecently())
+            // Scan only when this SSID was not seen lately, and then for this SSID alone
+            int32_t seenSec = m_wifiScanCache.age(ssid.m_ssid);
+            if(seenSec >= 0 && seenSec <= NM_WIFI_SCAN_CACHE_FRESH_SEC)
+            {
+                NMLOG_INFO("%s seen %d sec ago, connecting without a scan", ssid.m_ssid.c_str(), seenSec);
+            }
+            else
             {
                 nmEvent->setwifiScanOptions(false, true); // not notify scan result but print logs
                 if(!wifi->wifiScanRequest(Exchange::INetworkManager::WiFiFrequency::WIFI_FREQUENCY_WHATEVER, ssid.m_ssid))
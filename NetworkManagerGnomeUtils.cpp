@@ -10,6 +10,7 @@
 
 #include "NetworkManagerLogger.h"
 #include "NetworkManagerGnomeUtils.h"
+#include "WiFiScanResults.h"
 #include "NetworkManagerImplementation.h"
 #include "INetworkManager.h"
 
@@ -180,40 +181,42 @@ namespace WPEFramework
             return freq;
        }
 
-       JsonObject nmUtils::apToJsonObject(NMAccessPoint *ap)
+       void nmUtils::apToWiFiAccessPoint(NMAccessPoint *ap, Exchange::INetworkManager::WiFiAccessPoint& accessPoint)
        {
-            GError *error = NULL;
             GBytes *ssid = NULL;
-            int strength = 0;
-            std::string freq;
-            int security;
-            guint32 flags, wpaFlags, rsnFlags, apFreq;
-            JsonObject ssidObj;
-            if(ap == nullptr)
-                return ssidObj;
+            guint32 flags, wpaFlags, rsnFlags;
+
             ssid = nm_access_point_get_ssid(ap);
             if (ssid)
-            {
-                char *ssidStr = nullptr;
-                ssidStr = nm_utils_ssid_to_utf8((const guint8*)g_bytes_get_data(ssid, NULL), g_bytes_get_size(ssid));
-                string ssidString(ssidStr);
-                ssidObj["ssid"] = ssidString;
-            }
+                accessPoint.m_ssid.assign(static_cast<const char*>(g_bytes_get_data(ssid, NULL)), g_bytes_get_size(ssid));
             else
-                ssidObj["ssid"] = "---"; // hidden ssid TODO modify
-            strength = nm_access_point_get_strength(ap);
-            apFreq   = nm_access_point_get_frequency(ap);
+                accessPoint.m_ssid.clear();
+            accessPoint.m_bssid = WiFiScanResults::bssidFromString(nm_access_point_get_bssid(ap));
+            accessPoint.m_frequency = nm_access_point_get_frequency(ap);
+            accessPoint.m_strength = nm_access_point_get_strength(ap);
+            /* libnm has no dBm; its nl80211 strength is 120 + dBm over -90 .. -20 dBm, so this is the inverse */
+            accessPoint.m_rssi = static_cast<int16_t>(static_cast<int>(accessPoint.m_strength) - 120);
+            accessPoint.m_lastSeen = nm_access_point_get_last_seen(ap);
+
             flags    = nm_access_point_get_flags(ap);
             wpaFlags = nm_access_point_get_wpa_flags(ap);
             rsnFlags = nm_access_point_get_rsn_flags(ap);
-            freq = nmUtils::wifiFrequencyFromAp(apFreq);
-            security = nmUtils::wifiSecurityModeFromAp(flags, wpaFlags, rsnFlags);
-
-            ssidObj["security"] = security;
-            ssidObj["signalStrength"] = strength;
-            ssidObj["frequency"] = freq;
-
-            return ssidObj;
+            accessPoint.m_securityMode = static_cast<Exchange::INetworkManager::WIFISecurityMode>(nmUtils::wifiSecurityModeFromAp(flags, wpaFlags, rsnFlags));
+            accessPoint.m_securityFlags = 0;
+            if (flags & NM_802_11_AP_FLAGS_PRIVACY)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_PRIVACY;
+            if (wpaFlags != NM_802_11_AP_SEC_NONE)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_WPA;
+            if (rsnFlags != NM_802_11_AP_SEC_NONE)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_RSN;
+            if ((wpaFlags | rsnFlags) & NM_802_11_AP_SEC_KEY_MGMT_PSK)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_PSK;
+            if ((wpaFlags | rsnFlags) & NM_802_11_AP_SEC_KEY_MGMT_802_1X)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_8021X;
+            if (rsnFlags & NM_802_11_AP_SEC_KEY_MGMT_SAE)
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_SAE;
+            if (rsnFlags & (NM_802_11_AP_SEC_KEY_MGMT_OWE | NM_802_11_AP_SEC_KEY_MGMT_OWE_TM))
+                accessPoint.m_securityFlags |= Exchange::INetworkManager::WIFI_SECURITY_FLAG_OWE;
        }
 
         void nmUtils::printActiveSSIDsOnly(NMDeviceWifi *wifiDevice)
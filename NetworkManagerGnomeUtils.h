@@ -24,6 +24,7 @@
 #include <iostream>
 #include <atomic>
 #include "Module.h"
+#include "INetworkManager.h"
 
 namespace WPEFramework
 {
@@ -38,7 +39,7 @@ namespace WPEFramework
                static uint8_t wifiSecurityModeFromAp(guint32 flags, guint32 wpaFlags, guint32 rsnFlags);
                static std::string wifiFrequencyFromAp(guint32 apFreq);
                static std::string getSecurityModeString(guint32 flags, guint32 wpaFlags, guint32 rsnFlags);
-               static JsonObject apToJsonObject(NMAccessPoint *ap);
+               static void apToWiFiAccessPoint(NMAccessPoint *ap, Exchange::INetworkManager::WiFiAccessPoint& accessPoint);
                static void printActiveSSIDsOnly(NMDeviceWifi *wifiDevice);
         };
 
@@ -34,76 +34,207 @@ namespace WPEFramework
     namespace Plugin
     {
 
-        wifiManager::wifiManager() : client(nullptr), loop(nullptr), createNewConnection(false) {
+        wifiOperation::~wifiOperation()
+        {
+            /* dropped unstarted when the worker stopped, its caller still gets an answer */
+            if (!done)
+                promise.set_value(false);
+            if (timeout != nullptr)
+                g_source_unref(timeout);
+        }
+
+        void wifiOperation::complete(bool success)
+        {
+            if (done)
+                return;
+            done = true;
+            if (timeout != nullptr)
+                g_source_destroy(timeout);
+            NMLOG_DEBUG("%s %s", name, success ? "done" : "failed");
+            promise.set_value(success);
+        }
+
+        /* an operation handed to a GLib callback; the callback takes the reference back with takeOperation */
+        static gpointer holdOperation(const wifiOperationPtr& operation)
+        {
+            return new wifiOperationPtr(operation);
+        }
+
+        static wifiOperationPtr takeOperation(gpointer user_data)
+        {
+            wifiOperationPtr* held = static_cast<wifiOperationPtr*>(user_data);
+            wifiOperationPtr operation = *held;
+            delete held;
+            return operation;
+        }
+
+        static void releaseOperation(gpointer user_data)
+        {
+            delete static_cast<wifiOperationPtr*>(user_data);
+        }
+
+        static gboolean operationTimeoutCb(gpointer user_data)
+        {
+            wifiOperation *operation = static_cast<wifiOperationPtr*>(user_data)->get();
+            NMLOG_WARNING("%s timed out after %d ms", operation->name, operation->timeoutMs);
+            operation->complete(false);
+            return G_SOURCE_REMOVE;
+        }
+
+        wifiManager::wifiManager() : client(nullptr), loop(nullptr) {
             NMLOG_INFO("wifiManager");
             nmContext = g_main_context_new();
-            g_main_context_push_thread_default(nmContext);
             loop = g_main_loop_new(nmContext, FALSE);
+            workerThread = std::thread(&wifiManager::workerThreadFunction, this);
+        }
+
+        wifiManager::~wifiManager()
+        {
+            NMLOG_INFO("~wifiManager");
+            g_main_loop_quit(loop);
+            if (workerThread.joinable())
+                workerThread.join();
+            if(client != NULL) {
+                if (nmRunningGsignal > 0)
+                    g_signal_handler_disconnect(client, nmRunningGsignal);
+                g_object_unref(client);
+                client = NULL;
+            }
+            g_main_loop_unref(loop);
+            loop = NULL;
+            g_main_context_unref(nmContext);
         }
 
-        bool wifiManager::createClientNewConnection()
+        void wifiManager::workerThreadFunction()
+        {
+            g_main_context_push_thread_default(nmContext);
+            NMLOG_INFO("wifi worker started");
+            g_main_loop_run(loop);
+            /* what is still waiting fails rather than leave its caller blocked */
+            for (auto& waiting : waitingForClient)
+                waiting.first->complete(false);
+            waitingForClient.clear();
+            NMLOG_INFO("wifi worker stopped");
+            g_main_context_pop_thread_default(nmContext);
+        }
+
+        static void nmRunningCb(NMClient *nmClient, GParamSpec *pspec, gpointer user_data)
+        {
+            if (nm_client_get_nm_running(nmClient))
+                NMLOG_INFO("NetworkManager is running, wifi client reloads its objects");
+            else
+                NMLOG_WARNING("NetworkManager stopped, wifi requests fail until it is back");
+        }
+
+        static void clientNewCb(GObject *sourceObject, GAsyncResult *result, gpointer user_data)
         {
             GError *error = NULL;
-            if(client != nullptr)
+            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            NMClient *nmClient = nm_client_new_finish(result, &error);
+            if (nmClient == NULL) {
+                NMLOG_ERROR("Could not connect to NetworkManager: %s.", error ? error->message : "unknown");
+                if (error)
+                    g_error_free(error);
+            }
+            _wifiManager->clientConnected(nmClient);
+        }
+
+        void wifiManager::clientConnected(NMClient *nmClient)
+        {
+            clientConnecting = false;
+            client = nmClient;
+            if (client != nullptr)
             {
-                g_object_unref(client);
-                client = nullptr;
+                /* made once and kept; it follows NetworkManager, restarts included, as nmContext is iterated */
+                nmRunningGsignal = g_signal_connect(client, "notify::" NM_CLIENT_NM_RUNNING, G_CALLBACK(nmRunningCb), this);
+                NMLOG_INFO("wifi client connected to NetworkManager %s", nm_client_get_version(client));
             }
 
-            client = nm_client_new(NULL, &error);
-            if (!client || !loop) {
-                NMLOG_ERROR("Could not connect to NetworkManager: %s.", error->message);
-                g_error_free(error);
-                return false;
+            std::vector<std::pair<wifiOperationPtr, wifiOperationStart>> waiting;
+            waiting.swap(waitingForClient);
+            for (auto& operation : waiting)
+            {
+                if (client == nullptr)
+                    operation.first->complete(false);
+                else
+                    startOperation(operation.first, operation.second);
             }
-            return true;
         }
 
-        bool wifiManager::quit(NMDevice *wifiNMDevice)
+        void wifiManager::startOperation(const wifiOperationPtr& operation, const wifiOperationStart& start)
         {
-            if (wifiNMDevice && wifiDeviceStateGsignal > 0) {
-                g_signal_handler_disconnect(wifiNMDevice, wifiDeviceStateGsignal);
-                wifiDeviceStateGsignal = 0;
+            /* timed out while it waited for the client */
+            if (operation->isDone())
+                return;
+
+            if (client == nullptr)
+            {
+                /* the next request tries again when a connect failed */
+                waitingForClient.push_back(std::make_pair(operation, start));
+                if (!clientConnecting)
+                {
+                    clientConnecting = true;
+                    nm_client_new_async(NULL, clientNewCb, this);
+                }
+                return;
             }
 
-            if(!g_main_loop_is_running(loop)) {
-                NMLOG_ERROR("g_main_loop_is not running");
-                return false;
+            if (!nm_client_get_nm_running(client))
+            {
+                NMLOG_ERROR("NetworkManager is not running, %s failed", operation->name);
+                operation->complete(false);
+                return;
             }
 
-            g_main_loop_quit(loop);
-            return false;
+            if (!start(operation))
+                operation->complete(false);
         }
 
-        static gboolean gmainLoopTimoutCB(gpointer user_data)
+        struct wifiOperationRequest {
+            wifiManager *manager;
+            wifiOperationPtr operation;
+            wifiOperationStart start;
+        };
+
+        static gboolean operationStartCb(gpointer user_data)
         {
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
-            NMLOG_WARNING("GmainLoop ERROR_TIMEDOUT");
-            _wifiManager->isSuccess = false;
-            g_main_loop_quit(_wifiManager->loop);
-            return true;
+            wifiOperationRequest *request = static_cast<wifiOperationRequest*>(user_data);
+            request->manager->startOperation(request->operation, request->start);
+            return G_SOURCE_REMOVE;
+        }
+
+        static void operationRequestFree(gpointer user_data)
+        {
+            delete static_cast<wifiOperationRequest*>(user_data);
+        }
+
+        std::future<bool> wifiManager::submit(const char *name, const wifiOperationStart& start, int timeoutMs)
+        {
+            wifiOperationPtr operation = std::make_shared<wifiOperation>(name, timeoutMs);
+            std::future<bool> result = operation->result();
+
+            /* armed here so the time spent queued counts */
+            operation->timeout = g_timeout_source_new(timeoutMs);
+            g_source_set_callback(operation->timeout, operationTimeoutCb, holdOperation(operation), releaseOperation);
+            g_source_attach(operation->timeout, nmContext);
+
+            /* always queued, never run on the calling thread */
+            wifiOperationRequest *request = new wifiOperationRequest{this, operation, start};
+            GSource *idle = g_idle_source_new();
+            g_source_set_callback(idle, operationStartCb, request, operationRequestFree);
+            g_source_attach(idle, nmContext);
+            g_source_unref(idle);
+            return result;
         }
-    
-        bool wifiManager::wait(GMainLoop *loop, int timeOutMs)
+
+        bool wifiManager::run(const char *name, const wifiOperationStart& start, int timeoutMs)
         {
-            if(g_main_loop_is_running(loop)) {
-                NMLOG_WARNING("g_main_loop_is running");
+            if (std::this_thread::get_id() == workerThread.get_id())
+            {
+                NMLOG_ERROR("%s from the wifi worker would wait for itself", name);
                 return false;
             }
-            source = g_timeout_source_new(timeOutMs);  // 10000ms interval
-            g_source_set_callback(source, (GSourceFunc)gmainLoopTimoutCB, this, NULL);
-            g_source_attach(source, NULL);
-            g_main_loop_run(loop);
-            if(source != nullptr) {
-                if(g_source_is_destroyed(source)) {
-                    NMLOG_WARNING("Source has been destroyed");
-                }
-                else {
-                    g_source_destroy(source);
-                }
-                g_source_unref(source);
-            }
-            return true;
+            return submit(name, start, timeoutMs).get();
         }
 
         NMDevice* wifiManager::getNmDevice()
@@ -239,86 +370,80 @@ namespace WPEFramework
 
         bool wifiManager::isWifiConnected()
         {
-            if(!createClientNewConnection())
-                return false;
-
-            NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
-            if(wifiDevice == NULL) {
-                NMLOG_DEBUG("NMDeviceWifi * NULL !");
-                return false;
-            }
+            return run("isWifiConnected", [this](const wifiOperationPtr& operation) -> bool {
+                NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
+                if(wifiDevice == NULL) {
+                    NMLOG_DEBUG("NMDeviceWifi * NULL !");
+                    return false;
+                }
 
-            NMAccessPoint *activeAP = nm_device_wifi_get_active_access_point(wifiDevice);
-            if(activeAP == NULL) {
-                NMLOG_ERROR("No active access point found !");
-                return false;
-            }
-            else
-                NMLOG_DEBUG("active access point found !");
-            return true;
+                NMAccessPoint *activeAP = nm_device_wifi_get_active_access_point(wifiDevice);
+                if(activeAP == NULL) {
+                    NMLOG_ERROR("No active access point found !");
+                    return false;
+                }
+                else
+                    NMLOG_DEBUG("active access point found !");
+                operation->complete(true);
+                return true;
+            });
         }
 
         bool wifiManager::wifiConnectedSSIDInfo(Exchange::INetworkManager::WiFiSSIDInfo &ssidinfo)
         {
-            if(!createClientNewConnection())
-                return false;
-
-            NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
-            if(wifiDevice == NULL) {
-                NMLOG_DEBUG("NMDeviceWifi * NULL !");
-                return false;
-            }
+            /* ssidinfo is only written by the start, which never runs after the caller stopped waiting */
+            return run("wifiConnectedSSIDInfo", [this, &ssidinfo](const wifiOperationPtr& operation) -> bool {
+                NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
+                if(wifiDevice == NULL) {
+                    NMLOG_DEBUG("NMDeviceWifi * NULL !");
+                    return false;
+                }
 
-            NMAccessPoint *activeAP = nm_device_wifi_get_active_access_point(wifiDevice);
-            if(activeAP == NULL) {
-                NMLOG_ERROR("No active access point found !");
-                return false;
-            }
-            else
-                NMLOG_DEBUG("active access point found !");
+                NMAccessPoint *activeAP = nm_device_wifi_get_active_access_point(wifiDevice);
+                if(activeAP == NULL) {
+                    NMLOG_ERROR("No active access point found !");
+                    return false;
+                }
+                else
+                    NMLOG_DEBUG("active access point found !");
 
-            getApInfo(activeAP, ssidinfo);
-            return true;
+                getApInfo(activeAP, ssidinfo);
+                operation->complete(true);
+                return true;
+            });
         }
 
         static void wifiDisconnectCb(GObject *object, GAsyncResult *result, gpointer user_data)
         {
             NMDevice     *device = NM_DEVICE(object);
             GError       *error = NULL;
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            wifiOperationPtr operation = takeOperation(user_data);
 
             NMLOG_DEBUG("Disconnecting... ");
-            _wifiManager->isSuccess = true;
             if (!nm_device_disconnect_finish(device, result, &error)) {
-                if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
-                    return;
-
                 NMLOG_ERROR("Device '%s' (%s) disconnecting failed: %s",
                             nm_device_get_iface(device),
                             nm_object_get_path(NM_OBJECT(device)),
                             error->message);
                 g_error_free(error);
-                _wifiManager->quit(device);
-                 _wifiManager->isSuccess = false;
+                operation->complete(false);
+                return;
             }
-            _wifiManager->quit(device);
+            operation->complete(true);
         }
 
         bool wifiManager::wifiDisconnect()
         {
-            if(!createClientNewConnection())
-                return false;
-
-            NMDevice *wifiNMDevice = getNmDevice();
-            if(wifiNMDevice == NULL) {
-                NMLOG_DEBUG("NMDeviceWifi NULL !");
-                return false;
-            }
+            return run("wifiDisconnect", [this](const wifiOperationPtr& operation) -> bool {
+                NMDevice *wifiNMDevice = getNmDevice();
+                if(wifiNMDevice == NULL) {
+                    NMLOG_DEBUG("NMDeviceWifi NULL !");
+                    return false;
+                }
 
-            nm_device_disconnect_async(wifiNMDevice, NULL, wifiDisconnectCb, this);
-            wait(loop);
-            NMLOG_DEBUG("Exit");
-            return isSuccess;
+                nm_device_disconnect_async(wifiNMDevice, NULL, wifiDisconnectCb, holdOperation(operation));
+                return true;
+            });
         }
 
         static NMAccessPoint *checkSSIDAvailable(NMDevice *device, const GPtrArray *aps, const char *ssid)
@@ -353,35 +478,42 @@ namespace WPEFramework
         static void wifiConnectCb(GObject *client, GAsyncResult *result, gpointer user_data)
         {
             GError *error = NULL;
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            wifiOperationPtr operation = takeOperation(user_data);
 
-            if (_wifiManager->createNewConnection) {
+            if (operation->createNewConnection) {
                 NMLOG_DEBUG("nm_client_add_and_activate_connection_finish");
-                nm_client_add_and_activate_connection_finish(NM_CLIENT(_wifiManager->client), result, &error);
-                 _wifiManager->isSuccess = true;
+                nm_client_add_and_activate_connection_finish(NM_CLIENT(client), result, &error);
             }
             else {
                 NMLOG_DEBUG("nm_client_activate_connection_finish ");
-                nm_client_activate_connection_finish(NM_CLIENT(_wifiManager->client), result, &error);
-                 _wifiManager->isSuccess = true;
+                nm_client_activate_connection_finish(NM_CLIENT(client), result, &error);
             }
 
             if (error) {
-                 _wifiManager->isSuccess = false;
-                if (_wifiManager->createNewConnection) {
+                if (operation->createNewConnection) {
                     NMLOG_ERROR("Failed to add/activate new connection: %s", error->message);
                 } else {
                     NMLOG_ERROR("Failed to activate connection: %s", error->message);
                 }
+                g_error_free(error);
+                operation->complete(false);
+                return;
             }
-
-            g_main_loop_quit(_wifiManager->loop);
+            operation->complete(true);
         }
 
+        struct wifiConnectionUpdateRequest {
+            wifiOperationPtr operation;
+            NMClient *client;
+        };
+
         static void wifiConnectionUpdate(GObject *rmObject, GAsyncResult *res, gpointer user_data)
         {
             NMRemoteConnection        *remote_con = NM_REMOTE_CONNECTION(rmObject);
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            wifiConnectionUpdateRequest *request = static_cast<wifiConnectionUpdateRequest*>(user_data);
+            wifiOperationPtr operation = request->operation;
+            NMClient *client = request->client;
+            delete request;
             GVariant *ret = NULL;
             GError *error = NULL;
 
@@ -390,16 +522,26 @@ namespace WPEFramework
             if (!ret) {
                 NMLOG_ERROR("Error: %s.", error->message);
                 g_error_free(error);
-                _wifiManager->isSuccess = false;
-                _wifiManager->quit(NULL);
+                operation->complete(false);
                 return;
             }
-            _wifiManager->createNewConnection = false; // no need to create new connection
+            g_variant_unref(ret);
+            /* timed out while the update ran, the caller is gone */
+            if (operation->isDone())
+                return;
+            operation->createNewConnection = false; // no need to create new connection
             nm_client_activate_connection_async(
-                _wifiManager->client, NM_CONNECTION(remote_con), _wifiManager->wifidevice, _wifiManager->objectPath, NULL, wifiConnectCb, _wifiManager);
+                client, NM_CONNECTION(remote_con), operation->device, operation->objectPath.c_str(), NULL, wifiConnectCb, holdOperation(operation));
         }
 
         bool wifiManager::wifiConnect(Exchange::INetworkManager::WiFiConnectTo wifiData)
+        {
+            return run("wifiConnect", [this, wifiData](const wifiOperationPtr& operation) -> bool {
+                return startWifiConnect(operation, wifiData);
+            });
+        }
+
+        bool wifiManager::startWifiConnect(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiConnectTo& wifiData)
         {
             const char *ssid_in = wifiData.m_ssid.c_str();
             const char* password_in = wifiData.m_passphrase.c_str();
@@ -419,9 +561,6 @@ namespace WPEFramework
             bool SSIDmatch = false;
             Exchange::INetworkManager::WiFiSSIDInfo apinfo;
 
-            if(!createClientNewConnection())
-                return false;
-
             if (strlen(ssid_in) > 32)
             {
                 NMLOG_WARNING("ssid length grater than 32");
@@ -432,14 +571,15 @@ namespace WPEFramework
             device = getNmDevice();
             if(device == NULL)
                 return false;
-            wifidevice = device;
+            operation->device = device;
 
             std::string activeSSID;
-            if(getConnectedSSID(NM_DEVICE_WIFI(wifidevice), activeSSID))
+            if(getConnectedSSID(NM_DEVICE_WIFI(device), activeSSID))
             {
                 if(strcmp(ssid_in, activeSSID.c_str()) == 0)
                 {
                     NMLOG_WARNING("ssid already connected !");
+                    operation->complete(true);
                     return true;
                 }
                 else
@@ -631,7 +771,7 @@ namespace WPEFramework
                 }
             }
 
-            objectPath = nm_object_get_path(NM_OBJECT(AccessPoint));
+            operation->objectPath = nm_object_get_path(NM_OBJECT(AccessPoint));
             GVariant *nmDbusConnection = nm_connection_to_dbus(connection, NM_CONNECTION_SERIALIZE_ALL);
             if (NM_IS_REMOTE_CONNECTION(connection))
             {
@@ -641,42 +781,45 @@ namespace WPEFramework
                                             NULL,
                                             NULL,
                                             wifiConnectionUpdate,
-                                            this);
+                                            new wifiConnectionUpdateRequest{operation, client});
             }
             else
             {
-                createNewConnection = true;
-                nm_client_add_and_activate_connection_async(client, connection, device, objectPath, NULL, wifiConnectCb, this);
+                operation->createNewConnection = true;
+                nm_client_add_and_activate_connection_async(client, connection, device, operation->objectPath.c_str(), NULL, wifiConnectCb, holdOperation(operation));
             }
 
-            wait(loop);
-            return isSuccess;
+            return true;
         }
 
         static void addToKnownSSIDsCb(GObject *client, GAsyncResult *result, gpointer user_data)
         {
 
             GError *error = NULL;
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
-            //NMRemoteConnection *connection = NM_REMOTE_CONNECTION(s);
-            if (!nm_client_add_connection_finish(NM_CLIENT(client), result, &error)) {
-                NMLOG_ERROR ("AddToKnownSSIDs Failed");
-                _wifiManager->isSuccess = false;
-            }
-            else
-            {
-                NMLOG_DEBUG ("AddToKnownSSIDs is success");
-                _wifiManager->isSuccess = true;
+            wifiOperationPtr operation = takeOperation(user_data);
+            NMRemoteConnection *connection = nm_client_add_connection_finish(NM_CLIENT(client), result, &error);
+            if (connection == NULL) {
+                NMLOG_ERROR ("AddToKnownSSIDs Failed %s", error ? error->message : "");
+                if (error)
+                    g_error_free(error);
+                operation->complete(false);
+                return;
             }
 
-            g_main_loop_quit(_wifiManager->loop);
+            NMLOG_DEBUG ("AddToKnownSSIDs is success");
+            g_object_unref(connection);
+            operation->complete(true);
         }
 
         bool wifiManager::addToKnownSSIDs(const Exchange::INetworkManager::WiFiConnectTo ssidinfo)
         {
-            if(!createClientNewConnection())
-                return false;
+            return run("addToKnownSSIDs", [this, ssidinfo](const wifiOperationPtr& operation) -> bool {
+                return startAddToKnownSSIDs(operation, ssidinfo);
+            });
+        }
 
+        bool wifiManager::startAddToKnownSSIDs(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiConnectTo& ssidinfo)
+        {
             NMSettingWirelessSecurity *nmSettingsWifiSec;
             NMSettingWireless *nmSettingsWifi;
             const char *uuid = nm_utils_uuid_generate();
@@ -725,149 +868,136 @@ namespace WPEFramework
             }
 
             nm_connection_add_setting(connection, NM_SETTING(nmSettingsWifiSec));
-            nm_client_add_connection_async(client, connection, true, NULL, addToKnownSSIDsCb, this);
-            //wait(loop);
-            // TODO change to GmainLoooprun
-            g_main_loop_unref(loop);
-            return isSuccess;
+            nm_client_add_connection_async(client, connection, true, NULL, addToKnownSSIDsCb, holdOperation(operation));
+            return true;
         }
 
         static void removeKnownSSIDCb(GObject *client, GAsyncResult *result, gpointer user_data)
         {
             GError *error = NULL;
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            wifiOperationPtr operation = takeOperation(user_data);
             NMRemoteConnection *connection = NM_REMOTE_CONNECTION(client);
             if (!nm_remote_connection_delete_finish(connection, result, &error)) {
                 NMLOG_ERROR("RemoveKnownSSID failed %s", error->message);
-                _wifiManager->isSuccess = false;
-            }
-            else
-            {
-                NMLOG_INFO ("RemoveKnownSSID is success");
-                _wifiManager->isSuccess = true;
+                g_error_free(error);
+                operation->complete(false);
+                return;
             }
 
-            g_main_loop_quit(_wifiManager->loop);
+            NMLOG_INFO ("RemoveKnownSSID is success");
+            operation->complete(true);
         }
 
         bool wifiManager::removeKnownSSID(const string& ssid)
         {
-
-            if(!createClientNewConnection())
-                return false;
-
             if(ssid.empty())
                 return false;
-            isSuccess = false;
 
-            NMRemoteConnection* remoteConnection;
-            const GPtrArray* connections = nm_client_get_connections(client);
+            return run("removeKnownSSID", [this, ssid](const wifiOperationPtr& operation) -> bool {
+                NMRemoteConnection* remoteConnection;
+                const GPtrArray* connections = nm_client_get_connections(client);
 
-            for (guint i = 0; i < connections->len; i++)
-            {
-                remoteConnection = NM_REMOTE_CONNECTION(connections->pdata[i]);
-                NMConnection *connection = NM_CONNECTION(connections->pdata[i]);
-                if (NM_IS_SETTING_WIRELESS(nm_connection_get_setting_wireless(connection)))
+                for (guint i = 0; i < connections->len; i++)
                 {
-                    GBytes *ssidBytes = nm_setting_wireless_get_ssid(nm_connection_get_setting_wireless(connection));
-                    if (ssidBytes)
+                    remoteConnection = NM_REMOTE_CONNECTION(connections->pdata[i]);
+                    NMConnection *connection = NM_CONNECTION(connections->pdata[i]);
+                    if (NM_IS_SETTING_WIRELESS(nm_connection_get_setting_wireless(connection)))
                     {
-                        gsize ssidSize;
-                        const guint8 *ssidData = static_cast<const guint8 *>(g_bytes_get_data(ssidBytes, &ssidSize));
-                        std::string ssidstr(reinterpret_cast<const char *>(ssidData), ssidSize);
-                        if (ssid == ssidstr)
+                        GBytes *ssidBytes = nm_setting_wireless_get_ssid(nm_connection_get_setting_wireless(connection));
+                        if (ssidBytes)
                         {
-                            //nm_remote_connection_delete_async(remoteConnection, NULL, removeKnownSSIDCb, this);
-                            // TODO add async
-                            GError *error = NULL;
-                            nm_remote_connection_delete(remoteConnection, NULL, &error);
-                            if (error)
+                            gsize ssidSize;
+                            const guint8 *ssidData = static_cast<const guint8 *>(g_bytes_get_data(ssidBytes, &ssidSize));
+                            std::string ssidstr(reinterpret_cast<const char *>(ssidData), ssidSize);
+                            if (ssid == ssidstr)
                             {
-                                NMLOG_ERROR("RemoveKnownSSID failed %s", error->message);
-                                g_error_free(error);
+                                NMLOG_INFO("removing known ssid %s", ssid.c_str());
+                                // only the first connection with this ssid is removed
+                                nm_remote_connection_delete_async(remoteConnection, NULL, removeKnownSSIDCb, holdOperation(operation));
+                                return true;
                             }
-                            else
-                            {
-                                NMLOG_INFO("RemoveKnownSSID is success %s", ssid.c_str());
-                                isSuccess = true;
-                            }
-                            break; // if remove all connection with same ssid not to break
                         }
                     }
                 }
-            }
-    
-            return isSuccess;
+
+                NMLOG_WARNING("no known ssid %s", ssid.c_str());
+                return false;
+            });
         }
 
         bool wifiManager::getKnownSSIDs(std::list<string>& ssids)
         {
-            if(!createClientNewConnection())
-                return false;
-            const GPtrArray *connections = nm_client_get_connections(client);
-            std::string ssidPrint;
-            for (guint i = 0; i < connections->len; i++)
-            {
-                NMConnection *connection = NM_CONNECTION(connections->pdata[i]);
-
-                if (NM_IS_SETTING_WIRELESS(nm_connection_get_setting_wireless(connection)))
+            /* ssids is only written by the start, which never runs after the caller stopped waiting */
+            return run("getKnownSSIDs", [this, &ssids](const wifiOperationPtr& operation) -> bool {
+                const GPtrArray *connections = nm_client_get_connections(client);
+                std::string ssidPrint;
+                for (guint i = 0; i < connections->len; i++)
                 {
-                    GBytes *ssidBytes = nm_setting_wireless_get_ssid(nm_connection_get_setting_wireless(connection));
-                    if (ssidBytes)
+                    NMConnection *connection = NM_CONNECTION(connections->pdata[i]);
+
+                    if (NM_IS_SETTING_WIRELESS(nm_connection_get_setting_wireless(connection)))
                     {
-                        gsize ssidSize;
-                        const guint8 *ssidData = static_cast<const guint8 *>(g_bytes_get_data(ssidBytes, &ssidSize));
-                        std::string ssidstr(reinterpret_cast<const char *>(ssidData), ssidSize);
-                        if (!ssidstr.empty())
+                        GBytes *ssidBytes = nm_setting_wireless_get_ssid(nm_connection_get_setting_wireless(connection));
+                        if (ssidBytes)
                         {
-                            ssids.push_back(ssidstr);
-                            ssidPrint += ssidstr;
-                            ssidPrint += ", ";
+                            gsize ssidSize;
+                            const guint8 *ssidData = static_cast<const guint8 *>(g_bytes_get_data(ssidBytes, &ssidSize));
+                            std::string ssidstr(reinterpret_cast<const char *>(ssidData), ssidSize);
+                            if (!ssidstr.empty())
+                            {
+                                ssids.push_back(ssidstr);
+                                ssidPrint += ssidstr;
+                                ssidPrint += ", ";
+                            }
                         }
                     }
                 }
-            }
-            if (!ssids.empty())
-            {
-                NMLOG_DEBUG("known wifi connections are %s", ssidPrint.c_str());
-                return true;
-            }
+                if (!ssids.empty())
+                {
+                    NMLOG_DEBUG("known wifi connections are %s", ssidPrint.c_str());
+                    operation->complete(true);
+                    return true;
+                }
 
-            return false;
+                return false;
+            });
         }
 
         static void wifiScanCb(GObject *object, GAsyncResult *result, gpointer user_data)
         {
             GError *error = NULL;
-            wifiManager *_wifiManager = (static_cast<wifiManager*>(user_data));
+            wifiOperationPtr operation = takeOperation(user_data);
             if(nm_device_wifi_request_scan_finish(NM_DEVICE_WIFI(object), result, &error)) {
                  NMLOG_DEBUG("Scanning success");
-                 _wifiManager->isSuccess = true;
-            }
-            else
-            {
-                NMLOG_ERROR("Scanning Failed");
-                _wifiManager->isSuccess = false;
-            }
-            if (error) {
-                NMLOG_ERROR("Scanning Failed Error: %s.", error->message);
-                _wifiManager->isSuccess = false;
-                g_error_free(error);
+                 operation->complete(true);
+                 return;
             }
 
-            g_main_loop_quit(_wifiManager->loop);
+            NMLOG_ERROR("Scanning Failed Error: %s.", error ? error->message : "");
+            if (error)
+                g_error_free(error);
+            operation->complete(false);
         }
 
         bool wifiManager::wifiScanRequest(const Exchange::INetworkManager::WiFiFrequency frequency, std::string ssidReq)
         {
-            if(!createClientNewConnection())
-                return false;
+            return wifiScanRequestAsync(frequency, ssidReq).get();
+        }
+
+        std::future<bool> wifiManager::wifiScanRequestAsync(const Exchange::INetworkManager::WiFiFrequency frequency, std::string ssidReq)
+        {
+            return submit("wifiScanRequest", [this, frequency, ssidReq](const wifiOperationPtr& operation) -> bool {
+                return startWifiScan(operation, frequency, ssidReq);
+            });
+        }
+
+        bool wifiManager::startWifiScan(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiFrequency frequency, const std::string& ssidReq)
+        {
             NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
             if(wifiDevice == NULL) {
                 NMLOG_DEBUG("NMDeviceWifi * NULL !");
                 return false;
             }
-            isSuccess = false;
             if(!ssidReq.empty())
             {
                 NMLOG_INFO("staring wifi scanning .. %s", ssidReq.c_str());
@@ -881,46 +1011,45 @@ namespace WPEFramework
                 g_variant_builder_add(&builder, "{sv}", "ssids", g_variant_builder_end(&array_builder));
                 g_variant_builder_add(&builder, "{sv}", "hidden", g_variant_new_boolean(TRUE));
                 options = g_variant_builder_end(&builder);
-                nm_device_wifi_request_scan_options_async(wifiDevice, options, NULL, wifiScanCb, this);
+                nm_device_wifi_request_scan_options_async(wifiDevice, options, NULL, wifiScanCb, holdOperation(operation));
             }
             else {
                 NMLOG_DEBUG("staring normal wifi scanning");
-                nm_device_wifi_request_scan_async(wifiDevice, NULL, wifiScanCb, this);
+                nm_device_wifi_request_scan_async(wifiDevice, NULL, wifiScanCb, holdOperation(operation));
             }
-            wait(loop);
-            return isSuccess;
+            return true;
         }
 
         bool wifiManager::isWifiScannedRecently(int timelimitInSec)
         {
-            if (!createClientNewConnection())
-                return false;
-
-            NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
-            if (wifiDevice == NULL) {
-                NMLOG_ERROR("Invalid Wi-Fi device.");
-                return false;
-            }
+            return run("isWifiScannedRecently", [this, timelimitInSec](const wifiOperationPtr& operation) -> bool {
+                NMDeviceWifi *wifiDevice = NM_DEVICE_WIFI(getNmDevice());
+                if (wifiDevice == NULL) {
+                    NMLOG_ERROR("Invalid Wi-Fi device.");
+                    return false;
+                }
 
-            gint64 last_scan_time = nm_device_wifi_get_last_scan(wifiDevice);
-            if (last_scan_time <= 0) {
-                NMLOG_INFO("No scan has been performed yet");
-                return false;
-            }
+                gint64 last_scan_time = nm_device_wifi_get_last_scan(wifiDevice);
+                if (last_scan_time <= 0) {
+                    NMLOG_INFO("No scan has been performed yet");
+                    return false;
+                }
 
-            gint64 current_time_in_msec = nm_utils_get_timestamp_msec();
-            gint64 time_difference_in_seconds = (current_time_in_msec - last_scan_time) / 1000;
+                gint64 current_time_in_msec = nm_utils_get_timestamp_msec();
+                gint64 time_difference_in_seconds = (current_time_in_msec - last_scan_time) / 1000;
 
-            NMLOG_DEBUG("Current time in milliseconds: %" G_GINT64_FORMAT, current_time_in_msec);
-            NMLOG_DEBUG("Last scan time in milliseconds: %" G_GINT64_FORMAT, last_scan_time);
-            NMLOG_DEBUG("Time difference in seconds: %" G_GINT64_FORMAT, time_difference_in_seconds);
+                NMLOG_DEBUG("Current time in milliseconds: %" G_GINT64_FORMAT, current_time_in_msec);
+                NMLOG_DEBUG("Last scan time in milliseconds: %" G_GINT64_FORMAT, last_scan_time);
+                NMLOG_DEBUG("Time difference in seconds: %" G_GINT64_FORMAT, time_difference_in_seconds);
 
-            if (time_difference_in_seconds <= timelimitInSec) {
-                return true;
-            }
-            NMLOG_DEBUG("Last Wi-Fi scan exceeded time limit.");
-        return false;
-    }
+                if (time_difference_in_seconds <= timelimitInSec) {
+                    operation->complete(true);
+                    return true;
+                }
+                NMLOG_DEBUG("Last Wi-Fi scan exceeded time limit.");
+                return false;
+            });
+        }
 
 
     } // namespace Plugin
@@ -28,11 +28,52 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <thread>
+#include <future>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define WIFI_OPERATION_TIMEOUT_MS       10000   // an operation NetworkManager has not finished by then fails
 
 namespace WPEFramework
 {
     namespace Plugin
     {
+        /* one request on the wifiManager worker; only the worker touches it, apart from its result */
+        class wifiOperation
+        {
+        public:
+            wifiOperation(const char *name, int timeoutMs) : name(name), timeoutMs(timeoutMs) {}
+            ~wifiOperation();
+            /* the first completion wins; a reply after the timeout, or the timeout after a reply, is ignored */
+            void complete(bool success);
+            bool isDone() const { return done; }
+            std::future<bool> result() { return promise.get_future(); }
+
+            const char *name;
+            int timeoutMs;
+            GSource *timeout = nullptr;
+            /* wifiConnect state, kept per operation so connects never see each other's */
+            bool createNewConnection = false;
+            std::string objectPath;
+            NMDevice *device = nullptr;
+
+        private:
+            bool done = false;
+            std::promise<bool> promise;
+        };
+
+        typedef std::shared_ptr<wifiOperation> wifiOperationPtr;
+        /* runs on the worker; false when the operation failed before reaching NetworkManager, otherwise a callback or the start itself completes it */
+        typedef std::function<bool(const wifiOperationPtr&)> wifiOperationStart;
+
+        /*
+         * WiFi requests to NetworkManager. They run on a worker thread that owns nmContext and the NMClient and
+         * iterates them all the time, so the client is always current and replies are handled as they come.
+         * Each request is a wifiOperation with its own result and timeout; requests do not wait for each other
+         * and the caller only waits for its own, or not at all when it takes the future.
+         */
         class wifiManager
         {
         public:
@@ -47,45 +88,46 @@ namespace WPEFramework
             bool wifiConnectedSSIDInfo(Exchange::INetworkManager::WiFiSSIDInfo &ssidinfo);
             bool wifiConnect(Exchange::INetworkManager::WiFiConnectTo wifiData);
             bool wifiScanRequest(const Exchange::INetworkManager::WiFiFrequency frequency, std::string ssidReq = "");
+            /* true in the future once NetworkManager has accepted the scan; results come with the scan events */
+            std::future<bool> wifiScanRequestAsync(const Exchange::INetworkManager::WiFiFrequency frequency, std::string ssidReq = "");
             bool isWifiScannedRecently(int timelimitInSec = 10); // default 10 sec as shotest scanning interval
             bool getKnownSSIDs(std::list<string>& ssids);
             bool addToKnownSSIDs(const Exchange::INetworkManager::WiFiConnectTo ssidinfo);
             bool removeKnownSSID(const string& ssid);
-            bool quit(NMDevice *wifiNMDevice);
-            bool wait(GMainLoop *loop, int timeOutMs = 10000); // default maximium set as 10 sec
+
+            std::future<bool> submit(const char *name, const wifiOperationStart& start, int timeoutMs = WIFI_OPERATION_TIMEOUT_MS);
+            /* submit and wait for the result */
+            bool run(const char *name, const wifiOperationStart& start, int timeoutMs = WIFI_OPERATION_TIMEOUT_MS);
+            /* called on the worker once the client is ready or failed, starts what was waiting for it */
+            void clientConnected(NMClient *nmClient);
+
         private:
             NMDevice *getNmDevice();
+            void startOperation(const wifiOperationPtr& operation, const wifiOperationStart& start);
+            bool startWifiScan(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiFrequency frequency, const std::string& ssidReq);
+            bool startWifiConnect(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiConnectTo& wifiData);
+            bool startAddToKnownSSIDs(const wifiOperationPtr& operation, const Exchange::INetworkManager::WiFiConnectTo& ssidinfo);
 
         private:
             wifiManager();
-            ~wifiManager() {
-                NMLOG_INFO("~wifiManager");
-                g_main_context_pop_thread_default(nmContext);
-                if(client != NULL) {
-                    g_object_unref(client);
-                    client = NULL;
-                }
-                if(loop != NULL) {
-                    g_main_loop_unref(loop);
-                    loop = NULL;
-                }
-            }
+            ~wifiManager();
 
             wifiManager(wifiManager const&) = delete;
             void operator=(wifiManager const&) = delete;
 
-            bool createClientNewConnection();
+            void workerThreadFunction();
 
         public:
             NMClient *client;
             GMainLoop *loop;
-            gboolean createNewConnection;
             GMainContext *nmContext = nullptr;
-            const char* objectPath;
-            NMDevice *wifidevice;
-            GSource *source;
-            guint wifiDeviceStateGsignal = 0;
-            bool isSuccess = false;
+
+        private:
+            std::thread workerThread;
+            bool clientConnecting = false;
+            guint nmRunningGsignal = 0;
+            /* started before the client was ready, worker only */
+            std::vector<std::pair<wifiOperationPtr, wifiOperationStart>> waitingForClient;
         };
     }   // Plugin
 }   // WPEFramework
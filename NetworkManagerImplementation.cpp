@@ -20,6 +20,8 @@
 #include "NetworkManagerImplementation.h"
 #include "NetworkManagerConnectivity.h"
 #include "WiFiSignalStrengthMonitor.h"
+#include "IcmpPing.h"
+#include "Traceroute.h"
 
 using namespace WPEFramework;
 using namespace WPEFramework::Plugin;
@@ -34,12 +36,18 @@ namespace WPEFramework
         SERVICE_REGISTRATION(NetworkManagerImplementation, NETWORKMANAGER_MAJOR_VERSION, NETWORKMANAGER_MINOR_VERSION, NETWORKMANAGER_PATCH_VERSION);
 
         NetworkManagerImplementation::NetworkManagerImplementation()
-            : _notificationCallbacks({})
+            : m_diagnosticJobs([this](const string& guid, DiagnosticJobType type, const string& jsonOfResult) {
+                ReportDiagnosticResultEvent(guid, type, jsonOfResult);
+            })
         {
             /* Initialize Network Manager */
             NetworkManagerLogger::Init();
 
             LOG_ENTRY_FUNCTION();
+            /* events are delivered from here on, platform_init may already report some */
+            _eventDispatcher.start();
+            /* what earlier instances of the plugin scanned, WiFiConnect skips the scan for an SSID seen lately */
+            m_wifiScanCache.open();
             /* Name says it all */
             platform_init();
 
@@ -55,10 +63,15 @@ namespace WPEFramework
         NetworkManagerImplementation::~NetworkManagerImplementation()
         {
             LOG_ENTRY_FUNCTION();
+            /* a GetPublicIP still waiting on the STUN servers returns now */
+            stunClient.cancel();
             if(m_registrationThread.joinable())
             {
                 m_registrationThread.join();
             }
+            /* a worker still handing a result over posts it while the dispatcher takes posts */
+            m_diagnosticJobs.shutdown();
+            _eventDispatcher.stop();
         }
 
         /**
@@ -67,15 +80,8 @@ namespace WPEFramework
         uint32_t NetworkManagerImplementation::Register(INetworkManager::INotification *notification)
         {
             LOG_ENTRY_FUNCTION();
-            _notificationLock.Lock();
-
             // Make sure we can't register the same notification callback multiple times
-            if (std::find(_notificationCallbacks.begin(), _notificationCallbacks.end(), notification) == _notificationCallbacks.end()) {
-                _notificationCallbacks.push_back(notification);
-                notification->AddRef();
-            }
-
-            _notificationLock.Unlock();
+            _eventDispatcher.subscribe(notification);
 
             return Core::ERROR_NONE;
         }
@@ -86,16 +92,8 @@ namespace WPEFramework
         uint32_t NetworkManagerImplementation::Unregister(INetworkManager::INotification *notification)
         {
             LOG_ENTRY_FUNCTION();
-            _notificationLock.Lock();
-
-            // Make sure we can't register the same notification callback multiple times
-            auto itr = std::find(_notificationCallbacks.begin(), _notificationCallbacks.end(), notification);
-            if (itr != _notificationCallbacks.end()) {
-                (*itr)->Release();
-                _notificationCallbacks.erase(itr);
-            }
-
-            _notificationLock.Unlock();
+            // No callback reaches the notification once it is unsubscribed
+            _eventDispatcher.unsubscribe(notification);
 
             return Core::ERROR_NONE;
         }
@@ -122,6 +120,12 @@ namespace WPEFramework
                 NMLOG_DEBUG("config : stun port %d", m_stunPort);
                 NMLOG_DEBUG("config : stun interval %d", m_stunBindTimeout);
 
+                NMLOG_DEBUG("config : event coalesce window %d ms", config.eventCoalesceMs.Value());
+                _eventDispatcher.setCoalesceWindow(config.eventCoalesceMs.Value());
+
+                NMLOG_DEBUG("config : wifi signal hysteresis %d dB dwell %d ms", config.signalHysteresisDb.Value(), config.signalDwellMs.Value());
+                m_wifiSignalMonitor.configureSignalFilter(static_cast<float>(config.signalHysteresisDb.Value()), static_cast<long>(config.signalDwellMs.Value()));
+
                 NMLOG_DEBUG("config : loglevel %d", config.loglevel.Value());
                 logLevel = static_cast <NMLogging>(config.loglevel.Value());
                 // configure loglevel in libWPEFrameworkNetworkManagerImplementation.so
@@ -262,6 +266,136 @@ namespace WPEFramework
                 return Core::ERROR_GENERAL;
         }
 
+        static JsonObject latencyHistogramToJson(const LatencyHistogram& histogram)
+        {
+            JsonObject latency;
+            latency["count"] = static_cast<uint64_t>(histogram.count());
+            latency["minUs"] = static_cast<int64_t>(histogram.min());
+            latency["meanUs"] = static_cast<int64_t>(histogram.mean());
+            latency["p50Us"] = static_cast<int64_t>(histogram.percentile(50));
+            latency["p90Us"] = static_cast<int64_t>(histogram.percentile(90));
+            latency["p99Us"] = static_cast<int64_t>(histogram.percentile(99));
+            latency["maxUs"] = static_cast<int64_t>(histogram.max());
+            return latency;
+        }
+
+        /* @brief Get the connectivity probe latency histograms and per endpoint health as a JSON document */
+        uint32_t NetworkManagerImplementation::GetConnectivityStatistics(string& statistics /* @out */) const
+        {
+            LOG_ENTRY_FUNCTION();
+            JsonArray endpoints;
+            std::map<std::string, EndpointRanker::EndpointHealth> health = connectivityMonitor.getEndpointHealth();
+            for (const auto& entry : connectivityMonitor.getEndpointStatistics())
+            {
+                const EndpointStatistics& stats = entry.second;
+                JsonObject endpoint;
+                endpoint["endpoint"] = entry.first;
+                endpoint["transfers"] = static_cast<uint64_t>(stats.transfers);
+                endpoint["reusedConnections"] = static_cast<uint64_t>(stats.reusedConnections);
+                endpoint["lastResponseCode"] = static_cast<int64_t>(stats.lastResponseCode);
+                endpoint["dns"] = latencyHistogramToJson(stats.dns);
+                endpoint["connect"] = latencyHistogramToJson(stats.connect);
+                endpoint["tls"] = latencyHistogramToJson(stats.tls);
+                endpoint["ttfb"] = latencyHistogramToJson(stats.ttfb);
+                endpoint["total"] = latencyHistogramToJson(stats.total);
+
+                JsonObject responseCodes;
+                for (const auto& code : stats.responseCodes)
+                {
+                    string responseCode = std::to_string(code.first);
+                    responseCodes[responseCode.c_str()] = static_cast<uint64_t>(code.second);
+                }
+                endpoint["responseCodes"] = responseCodes;
+
+                JsonObject errors;
+                for (int errorClass = PROBE_ERROR_DNS; errorClass < PROBE_ERROR_CLASS_MAX; errorClass++)
+                    errors[ConnectivityMonitor::getProbeErrorClassString(static_cast<ProbeErrorClass>(errorClass))] = static_cast<uint64_t>(stats.errors[errorClass]);
+                endpoint["errors"] = errors;
+
+                auto ranking = health.find(entry.first);
+                if (ranking != health.end())
+                {
+                    endpoint["rankScoreMs"] = static_cast<int64_t>(ranking->second.scoreMs());
+                    endpoint["circuitOpen"] = (ranking->second.openUntil != 0);
+                }
+                endpoints.Add(endpoint);
+            }
+
+            ProbeEngineStats engineStats = connectivityMonitor.getProbeEngineStats();
+            JsonObject engine;
+            engine["probes"] = static_cast<uint64_t>(engineStats.probes);
+            engine["transfers"] = static_cast<uint64_t>(engineStats.transfers);
+            engine["newConnections"] = static_cast<uint64_t>(engineStats.newConnections);
+            engine["reusedConnections"] = static_cast<uint64_t>(engineStats.reusedConnections);
+            engine["handshakeSavedMs"] = static_cast<uint64_t>(engineStats.handshakeSavedMs);
+            engine["earlyDecisions"] = static_cast<uint64_t>(engineStats.earlyDecisions);
+            engine["cancelledTransfers"] = static_cast<uint64_t>(engineStats.cancelledTransfers);
+            engine["lastDecisionLatencyMs"] = static_cast<int64_t>(engineStats.lastDecisionLatencyMs);
+
+            WiFiSignalFilterStats signalStats = m_wifiSignalMonitor.getSignalFilterStats();
+            JsonObject wifiSignal;
+            wifiSignal["rawRssi"] = static_cast<int64_t>(signalStats.rawRssi);
+            wifiSignal["filteredRssi"] = static_cast<int64_t>(signalStats.filteredRssi);
+            wifiSignal["transitions"] = static_cast<uint64_t>(signalStats.transitions);
+            wifiSignal["suppressedTransitions"] = static_cast<uint64_t>(signalStats.suppressedTransitions);
+
+            JsonObject result;
+            result["endpoints"] = endpoints;
+            result["probeEngine"] = engine;
+            result["wifiSignal"] = wifiSignal;
+            result["success"] = true;
+            result.ToString(statistics);
+            return Core::ERROR_NONE;
+        }
+
+        /* @brief Get the event queue depth, delivery latency and per subscriber statistics as a JSON document */
+        uint32_t NetworkManagerImplementation::GetNotificationStatistics(string& statistics /* @out */) const
+        {
+            LOG_ENTRY_FUNCTION();
+            EventDispatcherStatistics stats = _eventDispatcher.getStatistics();
+
+            JsonObject queue;
+            queue["capacity"] = static_cast<uint64_t>(NM_EVENT_QUEUE_SIZE);
+            queue["depth"] = static_cast<uint64_t>(stats.depth);
+            queue["maxDepth"] = static_cast<uint64_t>(stats.maxDepth);
+            queue["posted"] = static_cast<uint64_t>(stats.posted);
+            queue["delivered"] = static_cast<uint64_t>(stats.delivered);
+            queue["dropped"] = static_cast<uint64_t>(stats.dropped);
+            queue["coalesced"] = static_cast<uint64_t>(stats.coalesced);
+
+            JsonObject events;
+            JsonObject coalesced;
+            for (int type = NOTIFY_INTERFACE_STATE; type < NOTIFY_EVENT_MAX; type++)
+            {
+                events[EventDispatcher::getEventName(static_cast<NotificationEventType>(type))] = static_cast<uint64_t>(stats.events[type]);
+                if (stats.coalescedEvents[type])
+                    coalesced[EventDispatcher::getEventName(static_cast<NotificationEventType>(type))] = static_cast<uint64_t>(stats.coalescedEvents[type]);
+            }
+
+            JsonArray subscribers;
+            for (const auto& subscriberStats : stats.subscribers)
+            {
+                JsonObject subscriber;
+                subscriber["deliveries"] = static_cast<uint64_t>(subscriberStats.deliveries);
+                subscriber["slowDeliveries"] = static_cast<uint64_t>(subscriberStats.slowDeliveries);
+                subscriber["skipped"] = static_cast<uint64_t>(subscriberStats.skipped);
+                subscriber["maxCallbackUs"] = static_cast<int64_t>(subscriberStats.maxCallbackUs);
+                subscriber["throttled"] = subscriberStats.throttled;
+                subscribers.Add(subscriber);
+            }
+
+            JsonObject result;
+            result["queue"] = queue;
+            result["queueLatency"] = latencyHistogramToJson(stats.queueLatency);
+            result["deliveryLatency"] = latencyHistogramToJson(stats.deliveryLatency);
+            result["events"] = events;
+            result["coalesced"] = coalesced;
+            result["subscribers"] = subscribers;
+            result["success"] = true;
+            result.ToString(statistics);
+            return Core::ERROR_NONE;
+        }
+
         /* @brief Get the Public IP used for external world communication */
         uint32_t NetworkManagerImplementation::GetPublicIP (const string &ipversion /* @in */,  string& ipAddress /* @out */)
         {
@@ -287,173 +421,243 @@ namespace WPEFramework
             return Core::ERROR_NONE;
         }
 
-        /* @brief Request for ping and get the response in as event. The GUID used in the request will be returned in the event. */
-        uint32_t NetworkManagerImplementation::Ping (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const uint16_t timeOutInSeconds /* @in */, const string guid /* @in */, string& response /* @out */)
-        {   
-            char cmd[100] = "";
-            if(0 == strcasecmp("IPv6", ipversion.c_str()))
-            {   
-                snprintf(cmd, sizeof(cmd), "ping6 -c %d -W %d '%s' 2>&1", noOfRequest, timeOutInSeconds, endpoint.c_str());
+        static JsonArray tripTimesToJson(const std::vector<double>& rtts)
+        {
+            /* per probe in send order, empty for a probe without a reply */
+            JsonArray tripTimes;
+            char value[32];
+            for (double rtt : rtts)
+            {
+                if (rtt < 0)
+                    value[0] = '\0';
+                else
+                    snprintf(value, sizeof(value), "%.3f", rtt);
+                tripTimes.Add(string(value));
             }
-            else
-            {   
-                snprintf(cmd, sizeof(cmd), "ping -c %d -W %d '%s' 2>&1", noOfRequest, timeOutInSeconds, endpoint.c_str());
+            return tripTimes;
+        }
+
+        static string pingResultToJson(const IcmpPingResult& result, bool success, const string& guid)
+        {
+            JsonObject pingResult;
+            string response;
+            char value[32];
+
+            if (!guid.empty())
+                pingResult["guid"] = guid;
+            pingResult["target"] = result.target;
+            pingResult["packetsTransmitted"] = static_cast<uint64_t>(result.transmitted);
+            pingResult["packetsReceived"] = static_cast<uint64_t>(result.received);
+            snprintf(value, sizeof(value), "%.1f", result.loss);
+            pingResult["packetLoss"] = string(value);
+            if (result.received > 0)
+            {
+                snprintf(value, sizeof(value), "%.3f", result.min);
+                pingResult["tripMin"] = string(value);
+                snprintf(value, sizeof(value), "%.3f", result.avg);
+                pingResult["tripAvg"] = string(value);
+                snprintf(value, sizeof(value), "%.3f", result.max);
+                pingResult["tripMax"] = string(value);
+                snprintf(value, sizeof(value), "%.3f", result.stddev);
+                pingResult["tripStdDev"] = string(value);
+            }
+            pingResult["tripTimes"] = tripTimesToJson(result.rtts);
+            pingResult["success"] = success;
+            pingResult["error"] = result.error;
+
+            pingResult.ToString(response);
+            return response;
+        }
+
+        static string traceResultToJson(const TracerouteResult& result, const string& endpoint, const string& guid)
+        {
+            JsonObject traceResult;
+            string response;
+            char value[32];
+
+            /* the traceroute text as before, one array element per hop */
+            JsonArray lines;
+            for (const string& line : Traceroute::toLines(result))
+                lines.Add(line);
+            string linesText;
+            lines.ToString(linesText);
+
+            JsonArray hops;
+            for (const TracerouteHop& hop : result.hops)
+            {
+                JsonObject hopResult;
+                hopResult["hop"] = static_cast<uint64_t>(hop.ttl);
+                hopResult["address"] = hop.address;
+                hopResult["tripTimes"] = tripTimesToJson(hop.rtts);
+                snprintf(value, sizeof(value), "%.1f", hop.loss);
+                hopResult["packetLoss"] = string(value);
+                hops.Add(JsonValue(hopResult));
             }
-            
-            NMLOG_DEBUG ("The Command is %s", cmd);
-            string commandToExecute(cmd);
-            executeExternally(NETMGR_PING, commandToExecute, response);
 
+            if (!guid.empty())
+                traceResult["guid"] = guid;
+            traceResult["target"] = result.target.empty() ? endpoint : result.target;
+            traceResult["results"] = linesText;
+            traceResult["hops"] = hops;
+            traceResult["reached"] = result.reached;
+            traceResult["error"] = result.error;
+            traceResult.ToString(response);
+            return response;
+        }
+
+        /* @brief Request for ping and get the response in as event. The GUID used in the request will be returned in the event. */
+        uint32_t NetworkManagerImplementation::Ping (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const uint16_t timeOutInSeconds /* @in */, const string guid /* @in */, string& response /* @out */)
+        {
+            IcmpPing ping((0 == strcasecmp("IPv6", ipversion.c_str())) ? AF_INET6 : AF_INET);
+            IcmpPingResult result;
+
+            bool success = ping.run(endpoint, noOfRequest, static_cast<uint32_t>(timeOutInSeconds) * 1000, result);
+            response = pingResultToJson(result, success, "");
+            NMLOG_INFO("Response is, %s", response.c_str());
             return Core::ERROR_NONE;
         }
 
         /* @brief Request for trace get the response in as event. The GUID used in the request will be returned in the event. */
         uint32_t NetworkManagerImplementation::Trace (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const string guid /* @in */, string& response /* @out */)
         {
-            char cmd[256] = "";
-            string tempResult = "";
-            if(0 == strcasecmp("IPv6", ipversion.c_str()))
-            {
-                snprintf(cmd, 256, "traceroute6 -w 3 -m 6 -q %d %s 64 2>&1", noOfRequest, endpoint.c_str());
-            }
-            else
+            Traceroute traceroute((0 == strcasecmp("IPv6", ipversion.c_str())) ? AF_INET6 : AF_INET);
+            TracerouteResult result;
+
+            traceroute.run(endpoint, noOfRequest, result);
+            response = traceResultToJson(result, endpoint, "");
+            NMLOG_INFO("Response is, %s", response.c_str());
+
+            return Core::ERROR_NONE;
+        }
+
+        uint32_t NetworkManagerImplementation::submitDiagnostic(const string& guid, const DiagnosticJob& job)
+        {
+            switch (m_diagnosticJobs.submit(guid, job))
             {
-                snprintf(cmd, 256, "traceroute -w 3 -m 6 -q %d %s 52 2>&1", noOfRequest, endpoint.c_str());
+                case DiagnosticJobs::SUBMITTED:
+                    return Core::ERROR_NONE;
+                case DiagnosticJobs::DUPLICATE:
+                    NMLOG_ERROR("diagnostic %s is already queued or running", guid.c_str());
+                    return Core::ERROR_DUPLICATE_KEY;
+                default:
+                    NMLOG_ERROR("too many diagnostics, %s refused", guid.c_str());
+                    return Core::ERROR_UNAVAILABLE;
             }
+        }
 
-            NMLOG_DEBUG ("The Command is %s", cmd);
-            string commandToExecute(cmd);
-            executeExternally(NETMGR_TRACE, commandToExecute, tempResult);
+        /* @brief Start a ping in the background and return at once; the result comes in onPingResult with the GUID, one is made when none is given */
+        uint32_t NetworkManagerImplementation::StartPing (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const uint16_t timeOutInSeconds /* @in */, string& guid /* @inout */)
+        {
+            LOG_ENTRY_FUNCTION();
+            if (guid.empty())
+                guid = DiagnosticJobs::newGuid();
+
+            std::shared_ptr<IcmpPing> ping = std::make_shared<IcmpPing>((0 == strcasecmp("IPv6", ipversion.c_str())) ? AF_INET6 : AF_INET);
+            const string id = guid;
+            DiagnosticJob job;
+            job.type = DIAGNOSTIC_PING;
+            job.run = [ping, id, endpoint, noOfRequest, timeOutInSeconds]() -> string {
+                IcmpPingResult result;
+                bool success = ping->run(endpoint, noOfRequest, static_cast<uint32_t>(timeOutInSeconds) * 1000, result);
+                return pingResultToJson(result, success, id);
+            };
+            job.cancel = [ping]() { ping->cancel(); };
+            job.progress = [ping]() -> uint32_t { return ping->progress(); };
+            return submitDiagnostic(guid, job);
+        }
+
+        /* @brief Start a trace in the background and return at once; the result comes in onTraceResult with the GUID, one is made when none is given */
+        uint32_t NetworkManagerImplementation::StartTrace (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, string& guid /* @inout */)
+        {
+            LOG_ENTRY_FUNCTION();
+            if (guid.empty())
+                guid = DiagnosticJobs::newGuid();
+
+            std::shared_ptr<Traceroute> traceroute = std::make_shared<Traceroute>((0 == strcasecmp("IPv6", ipversion.c_str())) ? AF_INET6 : AF_INET);
+            const string id = guid;
+            DiagnosticJob job;
+            job.type = DIAGNOSTIC_TRACE;
+            job.run = [traceroute, id, endpoint, noOfRequest]() -> string {
+                TracerouteResult result;
+                traceroute->run(endpoint, noOfRequest, result);
+                return traceResultToJson(result, endpoint, id);
+            };
+            job.cancel = [traceroute]() { traceroute->cancel(); };
+            job.progress = [traceroute]() -> uint32_t { return traceroute->progress(); };
+            return submitDiagnostic(guid, job);
+        }
 
-            JsonObject temp;
-            temp["target"] = endpoint;
-            temp["results"] = tempResult;
-            temp.ToString(response);
+        /* @brief Cancel a ping or trace started in the background; its result event still comes, with what it had */
+        uint32_t NetworkManagerImplementation::CancelDiagnostic (const string guid /* @in */)
+        {
+            LOG_ENTRY_FUNCTION();
+            if (m_diagnosticJobs.cancel(guid))
+                return Core::ERROR_NONE;
+            NMLOG_ERROR("no diagnostic %s to cancel", guid.c_str());
+            return Core::ERROR_UNKNOWN_KEY;
+        }
 
+        /* @brief Get whether a ping or trace started in the background is queued or running, and how far it is in percent */
+        uint32_t NetworkManagerImplementation::GetDiagnosticStatus (const string guid /* @in */, string& state /* @out */, uint32_t& progress /* @out */) const
+        {
+            DiagnosticJobState jobState;
+            if (!m_diagnosticJobs.status(guid, jobState, progress))
+                return Core::ERROR_UNKNOWN_KEY;
+            state = (DIAGNOSTIC_RUNNING == jobState) ? "running" : "queued";
             return Core::ERROR_NONE;
         }
 
-        void NetworkManagerImplementation::executeExternally(NetworkEvents event, const string commandToExecute, string& response)
+        void NetworkManagerImplementation::ReportDiagnosticResultEvent(const string& guid, DiagnosticJobType type, const string& jsonOfResult)
         {
-            FILE *pipe = NULL;
-            string output{};
-            char buffer[1024];
-            JsonObject pingResult;
-            int exitStatus;
-
-            pipe = popen(commandToExecute.c_str(), "r");
-            if (pipe == NULL)
-            {   
-                NMLOG_INFO ("%s: failed to open file '%s' for read mode with result: %s", __FUNCTION__, commandToExecute.c_str(), strerror(errno));
-                return;
+            NMLOG_INFO("diagnostic %s done, %s", guid.c_str(), jsonOfResult.c_str());
+            if (DIAGNOSTIC_PING == type)
+            {
+                _eventDispatcher.post(NOTIFY_PING_RESULT, [=](INetworkManager::INotification* callback) {
+                    callback->onPingResult(guid, jsonOfResult);
+                }, guid);
             }
-
-            if (NETMGR_PING == event)
+            else
             {
-                while (!feof(pipe) && fgets(buffer, 1024, pipe) != NULL)
-                {
-                    // remove newline from buffer
-                    buffer[strcspn(buffer, "\n")] = '\0';
-                    string line(buffer);
-
-                    if( line.find( "packet" ) != string::npos )
-                    {
-                        //Example: 10 packets transmitted, 10 packets received, 0% packet loss
-                        stringstream ss( line );
-                        int transCount;
-                        ss >> transCount;
-                        pingResult["packetsTransmitted"] = transCount;
-
-                        string token;
-                        getline( ss, token, ',' );
-                        getline( ss, token, ',' );
-                        stringstream ss2( token );
-                        int rxCount;
-                        ss2 >> rxCount;
-                        pingResult["packetsReceived"] = rxCount;
-
-                        getline( ss, token, ',' );
-                        string prefix = token.substr(0, token.find("%"));
-                        pingResult["packetLoss"] = prefix.c_str();
-
-                    }
-                    else if( line.find( "min/avg/max" ) != string::npos )
-                    {
-                        //Example: round-trip min/avg/max = 17.038/18.310/20.197 ms
-                        stringstream ss( line );
-                        string fullpath;
-                        getline( ss, fullpath, '=' );
-                        getline( ss, fullpath, '=' );
-
-                        string prefix;
-                        int index = fullpath.find("/");
-                        if (index >= 0)
-                        {
-                            prefix = fullpath.substr(0, fullpath.find("/"));
-                            pingResult["tripMin"] = prefix.c_str();
-                        }
-
-                        index = fullpath.find("/");
-                        if (index >= 0)
-                        {
-                            fullpath = fullpath.substr(index + 1, fullpath.length());
-                            prefix = fullpath.substr(0, fullpath.find("/"));
-                            pingResult["tripAvg"] = prefix.c_str();
-                        }
-
-                        index = fullpath.find("/");
-                        if (index >= 0)
-                        {
-                            fullpath = fullpath.substr(index + 1, fullpath.length());
-                            prefix = fullpath.substr(0, fullpath.find("/"));
-                            pingResult["tripMax"] = prefix.c_str();
-                        }
-
-                        index = fullpath.find("/");
-                        if (index >= 0)
-                        {
-                            fullpath = fullpath.substr(index + 1, fullpath.length());
-                            pingResult["tripStdDev"] = fullpath.c_str();
-                        }
-                    }
-                    else if( line.find( "bad" ) != string::npos )
-                    {
-                        pingResult["success"] = false;
-                        pingResult["error"] = "Bad Address";
-                    }
-                }
-                exitStatus = pclose(pipe);
-                // Check the exit status to determine if the command was successful
-                if (WIFEXITED(exitStatus) && WEXITSTATUS(exitStatus) == 0) {
-                    pingResult["success"] = true;
-                    pingResult["error"] = "";
-                } else {
-                    pingResult["success"] = false;
-                    pingResult["error"] = "Could not ping endpoint";
-                }
+                _eventDispatcher.post(NOTIFY_TRACE_RESULT, [=](INetworkManager::INotification* callback) {
+                    callback->onTraceResult(guid, jsonOfResult);
+                }, guid);
+            }
+        }
 
-                pingResult.ToString(response);
-                NMLOG_INFO("Response is, %s", response.c_str());
+        /* @brief Get the access points of the last scan as typed records; the same scan onAvailableSSIDs carries as JSON */
+        uint32_t NetworkManagerImplementation::GetWiFiScanResults(IWiFiAccessPointIterator*& accessPoints /* @out */) const
+        {
+            LOG_ENTRY_FUNCTION();
+            std::shared_ptr<const WiFiScanResults> scan;
+            {
+                std::lock_guard<std::mutex> lock(m_wifiScanLock);
+                scan = m_wifiScanResults;
             }
-            else if (NETMGR_TRACE == event)
+            if (!scan)
             {
+                NMLOG_WARNING("no wifi scan completed yet");
+                return Core::ERROR_UNAVAILABLE;
+            }
 
-                // We return the entire output of the trace command but since this contains newlines it is not valid as
-                // a json value so we will parse the output into an array of strings, one element for each line.
-                JsonArray list;
-                while (!feof(pipe) && fgets(buffer, 1024, pipe) != NULL)
-                {
-                    // remove newline from buffer
-                    buffer[strcspn(buffer, "\n")] = ' ';
-                    string line(buffer);
-                    list.Add(line);
-                }
+            using Implementation = RPC::IteratorType<Exchange::INetworkManager::IWiFiAccessPointIterator>;
+            accessPoints = Core::Service<Implementation>::Create<Exchange::INetworkManager::IWiFiAccessPointIterator>(scan->accessPoints());
+            return Core::ERROR_NONE;
+        }
 
-                pclose(pipe);
-                list.ToString(response);
-                NMLOG_INFO("Response is, %s", response.c_str());
+        /* @brief Get the access point table onWiFiScanDelta events apply to and its sequence; read it again when a sequence is skipped */
+        uint32_t NetworkManagerImplementation::GetWiFiScanTable(uint32_t& sequence /* @out */, IWiFiAccessPointIterator*& accessPoints /* @out */) const
+        {
+            LOG_ENTRY_FUNCTION();
+            std::vector<WiFiScanTable::AccessPoint> table;
+            {
+                std::lock_guard<std::mutex> lock(m_wifiScanLock);
+                sequence = m_wifiScanTable.sequence();
+                table = m_wifiScanTable.accessPoints();
             }
-            return;
+
+            using Implementation = RPC::IteratorType<Exchange::INetworkManager::IWiFiAccessPointIterator>;
+            accessPoints = Core::Service<Implementation>::Create<Exchange::INetworkManager::IWiFiAccessPointIterator>(table);
+            return Core::ERROR_NONE;
         }
 
         // WiFi Specific Methods
@@ -495,11 +699,11 @@ namespace WPEFramework
             }
 
             NMLOG_INFO("Posting onInterfaceStateChange %s", interface.c_str());
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            /* link and IP states of one interface supersede each other, added and removed are always delivered */
+            bool coalesce = (Exchange::INetworkManager::INTERFACE_ADDED != state && Exchange::INetworkManager::INTERFACE_REMOVED != state);
+            _eventDispatcher.post(NOTIFY_INTERFACE_STATE, [=](INetworkManager::INotification* callback) {
                 callback->onInterfaceStateChange(state, interface);
-            }
-            _notificationLock.Unlock();
+            }, interface, coalesce);
         }
 
         void NetworkManagerImplementation::ReportIPAddressChangedEvent(const string& interface, bool isAcquired, bool isIPv6, const string& ipAddress)
@@ -512,44 +716,67 @@ namespace WPEFramework
             }
 
             NMLOG_INFO("Posting onIPAddressChange %s", ipAddress.c_str());
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            /* an interface has several IPv6 addresses, only a flap of the same address is merged */
+            string key = interface + (isIPv6 ? "/ipv6/" : "/ipv4/") + ipAddress;
+            _eventDispatcher.post(NOTIFY_IP_ADDRESS, [=](INetworkManager::INotification* callback) {
                 callback->onIPAddressChange(interface, isAcquired, isIPv6, ipAddress);
-            }
-            _notificationLock.Unlock();
+            }, key, true);
         }
 
         void NetworkManagerImplementation::ReportActiveInterfaceChangedEvent(const string prevActiveInterface, const string currentActiveinterface)
         {
             LOG_ENTRY_FUNCTION();
             NMLOG_INFO("Posting onActiveInterfaceChange %s", currentActiveinterface.c_str());
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            _eventDispatcher.post(NOTIFY_ACTIVE_INTERFACE, [=](INetworkManager::INotification* callback) {
                 callback->onActiveInterfaceChange(prevActiveInterface, currentActiveinterface);
-            }
-            _notificationLock.Unlock();
+            });
         }
 
         void NetworkManagerImplementation::ReportInternetStatusChangedEvent(const InternetStatus oldState, const InternetStatus newstate)
         {
             LOG_ENTRY_FUNCTION();
             NMLOG_INFO("Posting onInternetStatusChange");
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            _eventDispatcher.post(NOTIFY_INTERNET_STATUS, [=](INetworkManager::INotification* callback) {
                 callback->onInternetStatusChange(oldState, newstate);
+            });
+        }
+
+        void NetworkManagerImplementation::SetWiFiScanResults(const std::shared_ptr<const WiFiScanResults>& scan)
+        {
+            WiFiScanDelta delta;
+            bool changed = false;
+            {
+                std::lock_guard<std::mutex> lock(m_wifiScanLock);
+                m_wifiScanResults = scan;
+                changed = m_wifiScanTable.update(*scan, delta);
             }
-            _notificationLock.Unlock();
+            m_wifiScanCache.update(scan->accessPoints());
+            if (changed)
+                ReportWiFiScanDeltaEvent(delta);
         }
 
-        void NetworkManagerImplementation::ReportAvailableSSIDsEvent(const string jsonOfWiFiScanResults)
+        void NetworkManagerImplementation::ReportWiFiScanDeltaEvent(const WiFiScanDelta& delta)
         {
             LOG_ENTRY_FUNCTION();
-            _notificationLock.Lock();
-            NMLOG_INFO("Posting onAvailableSSIDs result is, %s", jsonOfWiFiScanResults.c_str());
-            for (const auto callback : _notificationCallbacks) {
+            NMLOG_INFO("Posting onWiFiScanDelta %u, %zu bytes", delta.sequence, delta.added.size() + delta.changed.size() + delta.removed.size());
+            /* in sequence and never merged, a client that misses one reads the table again */
+            std::shared_ptr<const WiFiScanDelta> shared = std::make_shared<WiFiScanDelta>(delta);
+            _eventDispatcher.post(NOTIFY_WIFI_SCAN_DELTA, [shared](INetworkManager::INotification* callback) {
+                callback->onWiFiScanDelta(shared->sequence, shared->added, shared->changed, shared->removed);
+            });
+        }
+
+        void NetworkManagerImplementation::ReportAvailableSSIDsEvent(const std::shared_ptr<const WiFiScanResults>& scan)
+        {
+            LOG_ENTRY_FUNCTION();
+            SetWiFiScanResults(scan);
+            NMLOG_INFO("Posting onAvailableSSIDs");
+            /* the queue and every subscriber hold the same scan; its JSON is made on the dispatcher thread, once */
+            _eventDispatcher.post(NOTIFY_AVAILABLE_SSIDS, [scan](INetworkManager::INotification* callback) {
+                const string& jsonOfWiFiScanResults = scan->json();
+                NMLOG_DEBUG("onAvailableSSIDs result is, %s", jsonOfWiFiScanResults.c_str());
                 callback->onAvailableSSIDs(jsonOfWiFiScanResults);
-            }
-            _notificationLock.Unlock();
+            });
         }
 
         void NetworkManagerImplementation::ReportWiFiStateChangedEvent(const INetworkManager::WiFiState state)
@@ -560,23 +787,18 @@ namespace WPEFramework
                 m_wifiSignalMonitor.startWiFiSignalStrengthMonitor(DEFAULT_WIFI_SIGNAL_TEST_INTERVAL_SEC);
 
             NMLOG_INFO("Posting onWiFiStateChange");
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            _eventDispatcher.post(NOTIFY_WIFI_STATE, [=](INetworkManager::INotification* callback) {
                 callback->onWiFiStateChange(state);
-            }
-            _notificationLock.Unlock();
+            });
         }
 
         void NetworkManagerImplementation::ReportWiFiSignalStrengthChangedEvent(const string ssid, const string signalLevel, const WiFiSignalQuality signalQuality)
         {
             LOG_ENTRY_FUNCTION();
             NMLOG_INFO("Posting onWiFiSignalStrengthChange");
-            _notificationLock.Lock();
-            for (const auto callback : _notificationCallbacks) {
+            _eventDispatcher.post(NOTIFY_WIFI_SIGNAL_STRENGTH, [=](INetworkManager::INotification* callback) {
                 callback->onWiFiSignalStrengthChange(ssid, signalLevel, signalQuality);
-                
-            }
-            _notificationLock.Unlock();
+            });
         }
     }
 }
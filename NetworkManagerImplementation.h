@@ -34,6 +34,10 @@ using namespace std;
 #include "WiFiSignalStrengthMonitor.h"
 #include "NetworkManagerConnectivity.h"
 #include "NetworkManagerStunClient.h"
+#include "NetworkManagerEventDispatcher.h"
+#include "WiFiScanResults.h"
+#include "WiFiScanCache.h"
+#include "DiagnosticJobs.h"
 
 #define LOG_ENTRY_FUNCTION() { NMLOG_DEBUG("Entering=%s", __FUNCTION__ ); }
 
@@ -43,11 +47,6 @@ namespace WPEFramework
     {
         class NetworkManagerImplementation : public Exchange::INetworkManager
         {
-        enum NetworkEvents {
-                NETMGR_PING,
-                NETMGR_TRACE,
-            };
-
         class Config : public Core::JSON::Container {
         private:
             Config(const Config&);
@@ -112,9 +111,15 @@ namespace WPEFramework
         public:
             Config()
                 : Core::JSON::Container()
+                , eventCoalesceMs(NM_EVENT_COALESCE_WINDOW_MS)
+                , signalHysteresisDb(static_cast<uint32_t>(WIFI_SIGNAL_HYSTERESIS_DB))
+                , signalDwellMs(WIFI_SIGNAL_MIN_DWELL_MS)
                 {
                     Add(_T("connectivity"), &connectivityConf);
                     Add(_T("stun"), &stun);
+                    Add(_T("eventcoalescems"), &eventCoalesceMs);
+                    Add(_T("signalhysteresisdb"), &signalHysteresisDb);
+                    Add(_T("signaldwellms"), &signalDwellMs);
                     Add(_T("loglevel"), &loglevel);
                 }
             ~Config() override = default;
@@ -122,6 +127,9 @@ namespace WPEFramework
         public:
             ConnectivityConf connectivityConf;
             Stun stun;
+            Core::JSON::DecUInt32 eventCoalesceMs;
+            Core::JSON::DecUInt32 signalHysteresisDb;
+            Core::JSON::DecUInt32 signalDwellMs;
             Core::JSON::DecUInt32 loglevel;
         };
 
@@ -165,6 +173,10 @@ namespace WPEFramework
             /* @brief Initiate a WIFI Scan; This is Async method and returns the scan results as Event */
             uint32_t StartWiFiScan(const WiFiFrequency frequency /* @in */);
             uint32_t StopWiFiScan(void) override;
+            /* @brief Get the access points of the last scan as typed records; the same scan onAvailableSSIDs carries as JSON */
+            uint32_t GetWiFiScanResults(IWiFiAccessPointIterator*& accessPoints /* @out */) const override;
+            /* @brief Get the access point table onWiFiScanDelta events apply to and its sequence; read it again when a sequence is skipped */
+            uint32_t GetWiFiScanTable(uint32_t& sequence /* @out */, IWiFiAccessPointIterator*& accessPoints /* @out */) const override;
 
             uint32_t GetKnownSSIDs(IStringIterator*& ssids /* @out */) override;
             uint32_t AddToKnownSSIDs(const WiFiConnectTo& ssid /* @in */) override;
@@ -196,6 +208,10 @@ namespace WPEFramework
             uint32_t StartConnectivityMonitoring(const uint32_t interval/* @in */) override;
             /* @brief Stop The Internet Connectivity Monitoring */ 
             uint32_t StopConnectivityMonitoring(void) const override;
+            /* @brief Get the connectivity probe latency histograms and per endpoint health as a JSON document */
+            uint32_t GetConnectivityStatistics(string& statistics /* @out */) const override;
+            /* @brief Get the event queue depth, delivery latency and per subscriber statistics as a JSON document */
+            uint32_t GetNotificationStatistics(string& statistics /* @out */) const override;
 
             /* @brief Get the Public IP used for external world communication */
             uint32_t GetPublicIP (const string &ipversion /* @in */,  string& ipAddress /* @out */) override;
@@ -205,6 +221,14 @@ namespace WPEFramework
 
             /* @brief Request for trace get the response in as event. The GUID used in the request will be returned in the event. */
             uint32_t Trace (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const string guid /* @in */, string& response /* @out */) override;
+            /* @brief Start a ping in the background and return at once; the result comes in onPingResult with the GUID, one is made when none is given */
+            uint32_t StartPing (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, const uint16_t timeOutInSeconds /* @in */, string& guid /* @inout */) override;
+            /* @brief Start a trace in the background and return at once; the result comes in onTraceResult with the GUID, one is made when none is given */
+            uint32_t StartTrace (const string ipversion /* @in */,  const string endpoint /* @in */, const uint32_t noOfRequest /* @in */, string& guid /* @inout */) override;
+            /* @brief Cancel a ping or trace started in the background; its result event still comes, with what it had */
+            uint32_t CancelDiagnostic (const string guid /* @in */) override;
+            /* @brief Get whether a ping or trace started in the background is queued or running, and how far it is in percent */
+            uint32_t GetDiagnosticStatus (const string guid /* @in */, string& state /* @out */, uint32_t& progress /* @out */) const override;
 
             uint32_t GetSupportedSecurityModes(ISecurityModeIterator*& securityModes /* @out */) const override;
 
@@ -219,7 +243,11 @@ namespace WPEFramework
             void ReportIPAddressChangedEvent(const string& interface, bool isAcquired, bool isIPv6, const string& ipAddress);
             void ReportActiveInterfaceChangedEvent(const string prevActiveInterface, const string currentActiveinterface);
             void ReportInternetStatusChangedEvent(const InternetStatus oldState, const InternetStatus newstate);
-            void ReportAvailableSSIDsEvent(const string jsonOfWiFiScanResults);
+            /* keeps the scan as the last one and posts it; subscribers share it and the JSON is made once */
+            void ReportAvailableSSIDsEvent(const std::shared_ptr<const WiFiScanResults>& scan);
+            /* keeps the scan as the last one without onAvailableSSIDs, for scans nobody asked to be told about; onWiFiScanDelta still goes out */
+            void SetWiFiScanResults(const std::shared_ptr<const WiFiScanResults>& scan);
+            void ReportWiFiScanDeltaEvent(const WiFiScanDelta& delta);
             void ReportWiFiStateChangedEvent(const INetworkManager::WiFiState state);
             void ReportWiFiSignalStrengthChangedEvent(const string ssid , const string signalLevel , const WiFiSignalQuality signalQuality);
 
@@ -227,11 +255,17 @@ namespace WPEFramework
             void platform_init();
             void retryIarmEventRegistration();
             void threadEventRegistration();
-            void executeExternally(NetworkEvents event, const string commandToExecute, string& response);
+            uint32_t submitDiagnostic(const string& guid, const DiagnosticJob& job);
+            void ReportDiagnosticResultEvent(const string& guid, DiagnosticJobType type, const string& jsonOfResult);
 
         private:
-            std::list<Exchange::INetworkManager::INotification *> _notificationCallbacks;
-            Core::CriticalSection _notificationLock;
+            EventDispatcher _eventDispatcher;
+            std::shared_ptr<const WiFiScanResults> m_wifiScanResults;
+            WiFiScanTable m_wifiScanTable;
+            WiFiScanCache m_wifiScanCache;
+            mutable std::mutex m_wifiScanLock;
+            /* shut down in the destructor before _eventDispatcher stops, so no result is posted to a stopped dispatcher */
+            DiagnosticJobs m_diagnosticJobs;
             string m_defaultInterface;
             string m_publicIP;
             stun::client stunClient;
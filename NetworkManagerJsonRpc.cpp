@@ -18,6 +18,7 @@
 **/
 
 #include "NetworkManager.h"
+#include "WiFiScanResults.h"
 
 #define LOG_INPARAM() { string json; parameters.ToString(json); NMLOG_DEBUG("%s : params=%s", __FUNCTION__, json.c_str() ); }
 #define LOG_OUTPARAM() { string json; response.ToString(json); NMLOG_INFO("%s : response=%s", __FUNCTION__,  json.c_str() ); }
@@ -55,11 +56,18 @@ namespace WPEFramework
             Register("GetCaptivePortalURI",               &NetworkManager::GetCaptivePortalURI, this);
             Register("StartConnectivityMonitoring",       &NetworkManager::StartConnectivityMonitoring, this);
             Register("StopConnectivityMonitoring",        &NetworkManager::StopConnectivityMonitoring, this);
+            Register("GetConnectivityStatistics",         &NetworkManager::GetConnectivityStatistics, this);
+            Register("GetNotificationStatistics",         &NetworkManager::GetNotificationStatistics, this);
             Register("GetPublicIP",                       &NetworkManager::GetPublicIP, this);
             Register("Ping",                              &NetworkManager::Ping, this);
             Register("Trace",                             &NetworkManager::Trace, this);
+            Register("StartPing",                         &NetworkManager::StartPing, this);
+            Register("StartTrace",                        &NetworkManager::StartTrace, this);
+            Register("CancelDiagnostic",                  &NetworkManager::CancelDiagnostic, this);
+            Register("GetDiagnosticStatus",               &NetworkManager::GetDiagnosticStatus, this);
             Register("StartWiFiScan",                     &NetworkManager::StartWiFiScan, this);
             Register("StopWiFiScan",                      &NetworkManager::StopWiFiScan, this);
+            Register("GetWiFiScanTable",                  &NetworkManager::GetWiFiScanTable, this);
             Register("GetKnownSSIDs",                     &NetworkManager::GetKnownSSIDs, this);
             Register("AddToKnownSSIDs",                   &NetworkManager::AddToKnownSSIDs, this);
             Register("RemoveKnownSSID",                   &NetworkManager::RemoveKnownSSID, this);
@@ -94,11 +102,18 @@ namespace WPEFramework
             Unregister("GetCaptivePortalURI");
             Unregister("StartConnectivityMonitoring");
             Unregister("StopConnectivityMonitoring");
+            Unregister("GetConnectivityStatistics");
+            Unregister("GetNotificationStatistics");
             Unregister("GetPublicIP");
             Unregister("Ping");
             Unregister("Trace");
+            Unregister("StartPing");
+            Unregister("StartTrace");
+            Unregister("CancelDiagnostic");
+            Unregister("GetDiagnosticStatus");
             Unregister("StartWiFiScan");
             Unregister("StopWiFiScan");
+            Unregister("GetWiFiScanTable");
             Unregister("GetKnownSSIDs");
             Unregister("AddToKnownSSIDs");
             Unregister("RemoveKnownSSID");
@@ -632,6 +647,48 @@ namespace WPEFramework
             return rc;
         }
 
+        uint32_t NetworkManager::GetConnectivityStatistics(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            string statistics;
+
+            if (_networkManager)
+                rc = _networkManager->GetConnectivityStatistics(statistics);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                JsonObject reply;
+                reply.FromString(statistics);
+                response = reply;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
+        uint32_t NetworkManager::GetNotificationStatistics(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            string statistics;
+
+            if (_networkManager)
+                rc = _networkManager->GetNotificationStatistics(statistics);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                JsonObject reply;
+                reply.FromString(statistics);
+                response = reply;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
         uint32_t NetworkManager::GetPublicIP(const JsonObject& parameters, JsonObject& response)
         {
             LOG_INPARAM();
@@ -765,6 +822,111 @@ namespace WPEFramework
             return rc;
         }
 
+        uint32_t NetworkManager::StartPing(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            string guid{};
+            if (parameters.HasLabel("endpoint"))
+            {
+                const string endpoint = parameters["endpoint"].String();
+                string ipversion{"IPv4"};
+                uint32_t noOfRequest = 3;
+                uint16_t timeOutInSeconds = 5;
+
+                if (parameters.HasLabel("ipversion"))
+                    ipversion = parameters["ipversion"].String();
+
+                if (parameters.HasLabel("noOfRequest"))
+                    noOfRequest  = parameters["noOfRequest"].Number();
+
+                if (parameters.HasLabel("timeout"))
+                    timeOutInSeconds  = parameters["timeout"].Number();
+
+                if (parameters.HasLabel("guid"))
+                    guid = parameters["guid"].String();
+
+                if (_networkManager)
+                    rc = _networkManager->StartPing(ipversion, endpoint, noOfRequest, timeOutInSeconds, guid);
+                else
+                    rc = Core::ERROR_UNAVAILABLE;
+            }
+
+            if (Core::ERROR_NONE == rc)
+            {
+                response["guid"] = guid;
+                response["success"] = true;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
+        uint32_t NetworkManager::StartTrace(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            const string ipversion      = parameters["ipversion"].String();
+            const string endpoint       = parameters["endpoint"].String();
+            const uint32_t noOfRequest  = parameters["packets"].Number();
+            string guid                 = parameters["guid"].String();
+
+            if (_networkManager)
+                rc = _networkManager->StartTrace(ipversion, endpoint, noOfRequest, guid);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                response["guid"] = guid;
+                response["success"] = true;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
+        uint32_t NetworkManager::CancelDiagnostic(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            const string guid = parameters["guid"].String();
+
+            if (_networkManager)
+                rc = _networkManager->CancelDiagnostic(guid);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                response["success"] = true;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
+        uint32_t NetworkManager::GetDiagnosticStatus(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            const string guid = parameters["guid"].String();
+            string state{};
+            uint32_t progress = 0;
+
+            if (_networkManager)
+                rc = _networkManager->GetDiagnosticStatus(guid, state, progress);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                response["guid"] = guid;
+                response["state"] = state;
+                response["progress"] = static_cast<uint64_t>(progress);
+                response["success"] = true;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
         uint32_t NetworkManager::StartWiFiScan(const JsonObject& parameters, JsonObject& response)
         {
             LOG_INPARAM();
@@ -802,6 +964,44 @@ namespace WPEFramework
             return rc;
         }
 
+        uint32_t NetworkManager::GetWiFiScanTable(const JsonObject& parameters, JsonObject& response)
+        {
+            LOG_INPARAM();
+            uint32_t rc = Core::ERROR_GENERAL;
+            uint32_t sequence = 0;
+            Exchange::INetworkManager::IWiFiAccessPointIterator* accessPoints{};
+
+            if (_networkManager)
+                rc = _networkManager->GetWiFiScanTable(sequence, accessPoints);
+            else
+                rc = Core::ERROR_UNAVAILABLE;
+
+            if (Core::ERROR_NONE == rc)
+            {
+                /* same records as the onWiFiScanDelta arrays */
+                string table = "[";
+                if (accessPoints != nullptr)
+                {
+                    Exchange::INetworkManager::WiFiAccessPoint _resultItem_{};
+                    while (accessPoints->Next(_resultItem_) == true)
+                    {
+                        if (table.size() > 1)
+                            table += ',';
+                        WiFiScanResults::appendJson(table, _resultItem_, true);
+                    }
+                    accessPoints->Release();
+                }
+                table += ']';
+                JsonArray ssids;
+                ssids.FromString(table);
+                response["sequence"] = static_cast<uint64_t>(sequence);
+                response["ssids"] = ssids;
+                response["success"] = true;
+            }
+            LOG_OUTPARAM();
+            return rc;
+        }
+
         uint32_t NetworkManager::GetKnownSSIDs(const JsonObject& parameters, JsonObject& response)
         {
             LOG_INPARAM();
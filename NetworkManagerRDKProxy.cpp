@@ -501,7 +501,7 @@ namespace WPEFramework
                         string json;
                         ssids.ToString(json);
 
-                        ::_instance->ReportAvailableSSIDsEvent(json);
+                        ::_instance->ReportAvailableSSIDsEvent(std::make_shared<WiFiScanResults>(std::move(json)));
                     }
                     case IARM_BUS_WIFI_MGR_EVENT_onWIFIStateChanged:
                     {
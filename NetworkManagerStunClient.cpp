@@ -6,10 +6,12 @@
 #include <ifaddrs.h>
 #include <netdb.h>
 #include <net/if.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
 #include <algorithm>
 #include <exception>
 #include <limits>
@@ -20,15 +22,15 @@
 #include <thread>
 #include <iostream>
 
-#define STUN_DEFAULT_WAIT_INTERVAL 2000 //miliseconds
-#define STUN_DEFAULT_MAX_ATTEMPTS 30
+#define STUN_RTO_INITIAL_MS 500 // RFC 5389 7.2.1, doubles with each retransmission
+#define STUN_MAX_TRANSMISSIONS 7 // Rc
+#define STUN_LAST_WAIT_RTO 16 // Rm, the wait after the last one in initial RTOs
 
 //#define _STUN_DEBUG 1
 //#define _STUN_USE_MSGHDR
 
 namespace stun {
 namespace details {
-  static int constexpr binding_requests_max = 9;
   static std::chrono::milliseconds binding_requests_wait_time_max(1600);
 
   static char const * family_to_string(int family) {
@@ -52,12 +54,12 @@ namespace details {
   };
 
   #ifdef _STUN_DEBUG
-  void dump_buffer(char const * prefix, buffer const & buff)
+  void dump_buffer(char const * prefix, byte_span buff)
   {
     if (prefix)
       printf("%s", prefix);
-    for (uint8_t b : buff)
-      printf("0x%02x ", b);
+    for (size_t i = 0; i < buff.size(); ++i)
+      printf("0x%02x ", buff.data()[i]);
     printf("\n");
     return;
   }
@@ -240,46 +242,301 @@ namespace details {
 
 }  // end namespace details
 
-attribute const * message::find_attribute(uint16_t attr_type) const
+bool byte_span::read_u8(size_t offset, uint8_t & value) const
 {
-  std::vector<attribute>::const_iterator itr = std::find_if (
-    std::begin(m_attrs), std::end(m_attrs), [attr_type](attribute const & attr) {
-      return attr_type == attr.type;
-    });
-  if (itr == m_attrs.end())
-    return nullptr;
-  attribute const & temp = *itr;
-  return &temp;
+  if (offset >= m_size)
+    return false;
+  value = m_data[offset];
+  return true;
 }
 
+bool byte_span::read_u16(size_t offset, uint16_t & value) const
+{
+  if (offset > m_size || m_size - offset < 2)
+    return false;
+  value = static_cast<uint16_t>((m_data[offset] << 8) | m_data[offset + 1]);
+  return true;
+}
+
+bool byte_span::read_u32(size_t offset, uint32_t & value) const
+{
+  if (offset > m_size || m_size - offset < 4)
+    return false;
+  value = (uint32_t(m_data[offset]) << 24) | (uint32_t(m_data[offset + 1]) << 16)
+    | (uint32_t(m_data[offset + 2]) << 8) | uint32_t(m_data[offset + 3]);
+  return true;
+}
+
+bool byte_span::subspan(size_t offset, size_t length, byte_span & span) const
+{
+  if (offset > m_size || m_size - offset < length)
+    return false;
+  span = byte_span(m_data + offset, length);
+  return true;
+}
+
+uint32_t crc32(byte_span bytes)
+{
+  // ISO 3309 / zlib CRC-32, the one FINGERPRINT uses; the table is made once
+  struct table_type {
+    uint32_t entries[256];
+    table_type() {
+      for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+          c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+        entries[i] = c;
+      }
+    }
+  };
+  static table_type const table;
+
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < bytes.size(); ++i)
+    crc = table.entries[(crc ^ bytes.data()[i]) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffffffff;
+}
+
+message_writer::message_writer(uint8_t * buffer, size_t capacity)
+  : m_buffer(buffer)
+  , m_capacity(capacity)
+  , m_size(0)
+  , m_ok(false)
+{
+}
+
+void message_writer::write_u16(size_t offset, uint16_t value)
+{
+  m_buffer[offset] = static_cast<uint8_t>(value >> 8);
+  m_buffer[offset + 1] = static_cast<uint8_t>(value);
+}
+
+void message_writer::write_u32(size_t offset, uint32_t value)
+{
+  m_buffer[offset] = static_cast<uint8_t>(value >> 24);
+  m_buffer[offset + 1] = static_cast<uint8_t>(value >> 16);
+  m_buffer[offset + 2] = static_cast<uint8_t>(value >> 8);
+  m_buffer[offset + 3] = static_cast<uint8_t>(value);
+}
+
+bool message_writer::reserve(size_t length)
+{
+  // the message length is 16 bits and counts whole 4 byte words
+  if (!m_ok || m_size < header_size || m_capacity - m_size < length || m_size + length - header_size > 0xfffc)
+    m_ok = false;
+  return m_ok;
+}
+
+void message_writer::begin(uint16_t type, transaction_id const & id)
+{
+  if (m_buffer == nullptr || m_capacity < header_size) {
+    m_ok = false;
+    return;
+  }
+  m_ok = true;
+  // the top 2 bits of the type are zero
+  write_u16(0, type & 0x3fff);
+  write_u16(2, 0);
+  write_u32(4, magic_cookie);
+  std::copy(id.begin(), id.end(), m_buffer + 8);
+  m_size = header_size;
+}
+
+void message_writer::add_attribute(uint16_t type, byte_span value)
+{
+  size_t const padded = (value.size() + 3) & ~size_t(3);
+  if (value.size() > 0xffff || !reserve(4 + padded))
+    return;
+  write_u16(m_size, type);
+  write_u16(m_size + 2, static_cast<uint16_t>(value.size()));
+  if (value.size() > 0)
+    memcpy(m_buffer + m_size + 4, value.data(), value.size());
+  memset(m_buffer + m_size + 4 + value.size(), 0, padded - value.size());
+  m_size += 4 + padded;
+  write_u16(2, static_cast<uint16_t>(m_size - header_size));
+}
+
+void message_writer::add_xor_mapped_address(sockaddr_storage const & addr)
+{
+  uint8_t value[20] = {};
+  size_t length = 0;
+  if (addr.ss_family == AF_INET) {
+    sockaddr_in const * v4 = reinterpret_cast<sockaddr_in const *>(&addr);
+    uint16_t port = ntohs(v4->sin_port) ^ (magic_cookie >> 16);
+    uint32_t ip = ntohl(v4->sin_addr.s_addr) ^ magic_cookie;
+    value[1] = 1;
+    value[2] = static_cast<uint8_t>(port >> 8);
+    value[3] = static_cast<uint8_t>(port);
+    value[4] = static_cast<uint8_t>(ip >> 24);
+    value[5] = static_cast<uint8_t>(ip >> 16);
+    value[6] = static_cast<uint8_t>(ip >> 8);
+    value[7] = static_cast<uint8_t>(ip);
+    length = 8;
+  }
+  else if (addr.ss_family == AF_INET6 && m_ok) {
+    sockaddr_in6 const * v6 = reinterpret_cast<sockaddr_in6 const *>(&addr);
+    uint16_t port = ntohs(v6->sin6_port) ^ (magic_cookie >> 16);
+    value[1] = 2;
+    value[2] = static_cast<uint8_t>(port >> 8);
+    value[3] = static_cast<uint8_t>(port);
+    // xored with the cookie and the transaction id, bytes 4 to 19 of the header
+    for (int i = 0; i < 16; ++i)
+      value[4 + i] = v6->sin6_addr.s6_addr[i] ^ m_buffer[4 + i];
+    length = 20;
+  }
+  else {
+    m_ok = false;
+    return;
+  }
+  add_attribute(attribute_type::xor_mapped_address, byte_span(value, length));
+}
 
-buffer message::encode() const
+void message_writer::add_fingerprint()
 {
-  buffer bytes;
-  encoder::encode_u16(bytes, m_header.message_type);
-  encoder::encode_u16(bytes, m_header.message_length);
-  for (uint8_t b : m_header.transaction_id)
-    bytes.push_back(static_cast<uint8_t>(b));
-  for (attribute const & v : m_attrs) {
-    encoder::encode_u16(bytes, v.type);
-    encoder::encode_u16(bytes, v.length);
-    bytes.insert(std::end(bytes), std::begin(v.value), std::end(v.value));
+  if (!reserve(8))
+    return;
+  // the length already counts the FINGERPRINT when its CRC is taken
+  write_u16(2, static_cast<uint16_t>(m_size + 8 - header_size));
+  uint32_t const crc = crc32(byte_span(m_buffer, m_size)) ^ fingerprint_xor;
+  write_u16(m_size, attribute_type::fingerprint);
+  write_u16(m_size + 2, 4);
+  write_u32(m_size + 4, crc);
+  m_size += 8;
+}
+
+bool message_reader::parse(byte_span bytes)
+{
+  m_bytes = byte_span();
+  m_type = 0;
+
+  uint16_t type = 0, length = 0;
+  uint32_t cookie = 0;
+  if (!bytes.read_u16(0, type) || !bytes.read_u16(2, length) || !bytes.read_u32(4, cookie))
+    return false;
+  if ((type & 0xc000) != 0 || (length & 3) != 0 || cookie != magic_cookie)
+    return false;
+
+  byte_span message;
+  if (!bytes.subspan(0, header_size + length, message))
+    return false;
+
+  // every attribute within the length, FINGERPRINT only as the last one and right
+  for (size_t offset = header_size; offset < message.size(); ) {
+    uint16_t attr_type = 0, attr_length = 0;
+    byte_span value;
+    if (!message.read_u16(offset, attr_type) || !message.read_u16(offset + 2, attr_length)
+      || !message.subspan(offset + 4, attr_length, value))
+      return false;
+    size_t const next = offset + 4 + ((attr_length + 3u) & ~3u);
+    if (next > message.size())
+      return false;
+
+    if (attr_type == attribute_type::fingerprint) {
+      uint32_t crc = 0;
+      if (attr_length != 4 || next != message.size() || !value.read_u32(0, crc))
+        return false;
+      if (crc != (crc32(byte_span(message.data(), offset)) ^ fingerprint_xor))
+        return false;
+    }
+    offset = next;
   }
-  return bytes;
+
+  m_bytes = message;
+  m_type = type;
+  return true;
 }
 
-message * message_factory::create_binding_request()
+bool message_reader::has_id(transaction_id const & id) const
 {
-  message * change_request = new message();
-  change_request->m_header.message_type = 1;
-  change_request->m_header.message_length = 8;
-  details::random_fill(std::begin(change_request->m_header.transaction_id),
-    std::end(change_request->m_header.transaction_id));
+  byte_span id_bytes;
+  return m_bytes.subspan(8, id.size(), id_bytes) && std::equal(id.begin(), id.end(), id_bytes.data());
+}
 
-  // CHANGE-REQUEST
-  change_request->m_attrs.push_back({3, 4, {0, 0, 0, 0}});
+bool message_reader::find(uint16_t attr_type, byte_span & value) const
+{
+  // parse() checked the layout, the reads here cannot fail on a parsed message
+  for (size_t offset = header_size; offset < m_bytes.size(); ) {
+    uint16_t type = 0, length = 0;
+    if (!m_bytes.read_u16(offset, type) || !m_bytes.read_u16(offset + 2, length))
+      return false;
+    if (type == attr_type)
+      return m_bytes.subspan(offset + 4, length, value);
+    offset += 4 + ((length + 3u) & ~3u);
+  }
+  return false;
+}
 
-  return change_request;
+bool message_reader::decode_address(byte_span value, bool xored, sockaddr_storage & addr) const
+{
+  uint8_t family = 0;
+  uint16_t port = 0;
+  if (!value.read_u8(1, family) || !value.read_u16(2, port))
+    return false;
+  if (xored)
+    port ^= magic_cookie >> 16;
+
+  addr = sockaddr_storage();
+  if (family == 1) {
+    uint32_t ip = 0;
+    if (value.size() != 8 || !value.read_u32(4, ip))
+      return false;
+    sockaddr_in * v4 = reinterpret_cast<sockaddr_in *>(&addr);
+    v4->sin_family = AF_INET;
+    v4->sin_port = htons(port);
+    v4->sin_addr.s_addr = htonl(xored ? (ip ^ magic_cookie) : ip);
+    return true;
+  }
+  if (family == 2) {
+    if (value.size() != 20)
+      return false;
+    sockaddr_in6 * v6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+    v6->sin6_family = AF_INET6;
+    v6->sin6_port = htons(port);
+    for (int i = 0; i < 16; ++i)
+      v6->sin6_addr.s6_addr[i] = value.data()[4 + i] ^ (xored ? m_bytes.data()[4 + i] : 0);
+    return true;
+  }
+  return false;
+}
+
+bool message_reader::mapped_address(sockaddr_storage & addr) const
+{
+  byte_span value;
+  if (find(attribute_type::xor_mapped_address, value))
+    return decode_address(value, true, addr);
+  if (find(attribute_type::mapped_address, value))
+    return decode_address(value, false, addr);
+  return false;
+}
+
+bool message_reader::error_code(uint16_t & code) const
+{
+  byte_span value;
+  uint8_t error_class = 0, number = 0;
+  if (!find(attribute_type::error_code, value) || !value.read_u8(2, error_class) || !value.read_u8(3, number))
+    return false;
+  code = static_cast<uint16_t>((error_class & 0x07) * 100 + number);
+  return true;
+}
+
+bool message_reader::has_unknown_required() const
+{
+  static uint16_t const known[] = {
+    attribute_type::mapped_address, attribute_type::username, attribute_type::message_integrity,
+    attribute_type::error_code, attribute_type::unknown_attributes, attribute_type::realm,
+    attribute_type::nonce, attribute_type::message_integrity_sha256, attribute_type::password_algorithm,
+    attribute_type::userhash, attribute_type::xor_mapped_address
+  };
+  for (size_t offset = header_size; offset < m_bytes.size(); ) {
+    uint16_t type = 0, length = 0;
+    if (!m_bytes.read_u16(offset, type) || !m_bytes.read_u16(offset + 2, length))
+      return false;
+    // 0x0000 to 0x7fff are comprehension required
+    if (type < 0x8000 && std::find(std::begin(known), std::end(known), type) == std::end(known))
+      return true;
+    offset += 4 + ((length + 3u) & ~3u);
+  }
+  return false;
 }
 
 client::client()
@@ -292,6 +549,8 @@ client::client()
     , m_last_result()
     , m_verbose(true)
     , m_fd(-1)
+    , m_active(nullptr)
+    , m_cancelled(false)
 {
 }
 
@@ -314,6 +573,23 @@ bool client::bind(
     bool dirty = false;
     bool ret_ok = false;
 
+    /*cancelled for good, a caller that comes or waited for the lock after it does not bind again*/
+    if (m_cancelled)
+    {
+        result.invalidate();
+        return false;
+    }
+
+    /*one bind at a time, a caller that waited gets the result of the one before it from the cache*/
+    std::lock_guard<std::mutex> bind_guard(m_bind_lock);
+
+    if (m_cancelled)
+    {
+        verbose("client::bind cancelled\n");
+        result.invalidate();
+        return false;
+    }
+
     if(m_server.hostname != hostname)
     {
         m_server.hostname = hostname;
@@ -379,76 +655,54 @@ bool client::bind(
     try
     #endif
     {
-        int interval_wait_time = STUN_DEFAULT_WAIT_INTERVAL;
-        int num_attempts = STUN_DEFAULT_MAX_ATTEMPTS;
-        int total_time = 0;
-        int sleep_time = 1;
+        binder request(m_verbose);
+        bool cancelled;
+        {
+            /*a cancel between the check above and here finds no binder to stop, so look again*/
+            std::lock_guard<std::mutex> guard(m_active_lock);
+            cancelled = m_cancelled;
+            if (!cancelled)
+                m_active = &request;
+        }
+
+        if (!cancelled)
+            ret_ok = request.run(parse_servers(hostname, port), m_interface, m_protocol, std::chrono::seconds(m_bind_timeout), result);
+
+        {
+            std::lock_guard<std::mutex> guard(m_active_lock);
+            m_active = nullptr;
+        }
 
-        std::chrono::milliseconds wait_time(interval_wait_time);
-        for (int i = 0; i < num_attempts && total_time < m_bind_timeout; ++i)
+        if (ret_ok)
         {
-            verbose("client::bind sending bind request\n");
-
-            std::unique_ptr<stun::message> binding_response = send_binding_request(wait_time);
-
-            total_time += interval_wait_time;/*FXIME should do a clock delta and not use wait_time which is the max*/
-            /*do a multiple of 2 sleep -- FIXIME should use cond variable so user to cancel this*/
-            if (i > 0)
-            {
-                if (total_time + sleep_time > m_bind_timeout)
-                    sleep_time = m_bind_timeout - total_time;
-                if (sleep_time < 0)
-                    break;
-                sleep(sleep_time);
-                total_time += sleep_time;
-                if (sleep_time < 32)/*put some max limit on how long we wait*/
-                    sleep_time *= 2;
-            }
-            if (binding_response)
-            {
-                stun::attribute const * mapped_address = binding_response->find_attribute(stun::attribute_type::mapped_address);
-                if (mapped_address)
-                {
-                    sockaddr_storage addr = stun::attributes::mapped_address(*mapped_address).addr();
-
-                    result.public_ip = m_last_result.public_ip = stun::sockaddr_to_string(addr);
-
-                    m_last_cache_time = std::chrono::steady_clock::now();
-
-                    verbose("client::bind success: public_ip=%s\n", result.public_ip.c_str());
-
-                    ret_ok = true;
-                }
-                else
-                {
-                    verbose("client::bind failed: ip missing from binding response\n");
-                }
-            }
-            else
-            {
-                verbose("client::bind failed: no response received from server\n");
-            }
+            m_last_result = result;
+            m_last_cache_time = std::chrono::steady_clock::now();
+            verbose("client::bind success: public_ip=%s\n", result.public_ip.c_str());
         }
     }
 #ifdef __cpp_exceptions
     catch (std::exception const & err)
     {
+        std::lock_guard<std::mutex> guard(m_active_lock);
+        m_active = nullptr;
         verbose("client::bind failed: %s\n", err.what());
     }
 #endif
 
-    if (m_fd != -1)
-    {
-        close(m_fd);
-        m_fd = -1;
-    }
-
     if(!ret_ok)
       result.invalidate();
 
     return ret_ok;
 }
 
+void client::cancel()
+{
+  std::lock_guard<std::mutex> guard(m_active_lock);
+  m_cancelled = true;
+  if (m_active)
+    m_active->cancel();
+}
+
 void client::create_udp_socket(int inet_family)
 {
   if (inet_family != AF_INET && inet_family != AF_INET6)
@@ -498,30 +752,25 @@ void client::create_udp_socket(int inet_family)
   return;
 }
 
-message * client::send_message(sockaddr_storage const & remote_addr, message const & req,
-  std::chrono::milliseconds wait_time, int * local_iface_index)
+bool client::send_message(sockaddr_storage const & remote_addr, byte_span request,
+  std::chrono::milliseconds wait_time, uint8_t * response_buffer, size_t capacity,
+  message_reader & response, int * local_iface_index)
 {
   if (m_fd < 0)
-      return nullptr;
-
-  buffer bytes = req.encode();
+      return false;
 
   STUN_TRACE("remote_addr:%s\n", sockaddr_to_string(remote_addr).c_str());
 
   #ifdef _STUN_DEBUG
-  details::dump_buffer("STUN >>> ", bytes);
+  details::dump_buffer("STUN >>> ", request);
   #endif
 
   verbose("sending messsage\n");
 
-  ssize_t n = sendto(m_fd, &bytes[0], bytes.size(), 0, (sockaddr *) &remote_addr, details::socket_length(remote_addr));
+  ssize_t n = sendto(m_fd, request.data(), request.size(), 0, (sockaddr *) &remote_addr, details::socket_length(remote_addr));
   if (n < 0)
     details::throw_error("failed to send packet. %s", strerror(errno));
 
-  bytes.resize(0);
-  bytes.reserve(256);
-  bytes.resize(256);
-
   sockaddr_storage from_addr = {};
 
   fd_set rfds;
@@ -541,7 +790,7 @@ message * client::send_message(sockaddr_storage const & remote_addr, message con
   int ret = select(m_fd + 1, &rfds, nullptr, nullptr, &timeout);
   if (ret == 0) {
     STUN_TRACE("select timeout out\n");
-    return nullptr;
+    return false;
   }
 
   //
@@ -566,8 +815,8 @@ message * client::send_message(sockaddr_storage const & remote_addr, message con
     struct msghdr msg = {};
     struct iovec iov = {};
 
-    iov.iov_base = &bytes[0];
-    iov.iov_len = bytes.size();
+    iov.iov_base = response_buffer;
+    iov.iov_len = capacity;
 
     msg.msg_flags = 0;
     msg.msg_iov = &iov;
@@ -592,20 +841,20 @@ message * client::send_message(sockaddr_storage const & remote_addr, message con
   #else
   do {
     socklen_t len = sizeof(sockaddr_storage);
-    n = recvfrom(m_fd, &bytes[0], bytes.size(), MSG_WAITALL, (sockaddr *) &from_addr, &len);
+    n = recvfrom(m_fd, response_buffer, capacity, MSG_WAITALL, (sockaddr *) &from_addr, &len);
   } while (n == -2 && errno == EINTR);
   #endif
 
-  if (n < 0)
+  if (n < 0) {
     details::throw_error("error receiving on socket. %s", strerror(errno));
-  else
-    bytes.resize(n);
+    return false;
+  }
 
   #ifdef _STUN_DEBUG
-  details::dump_buffer("STUN <<< ", bytes);
+  details::dump_buffer("STUN <<< ", byte_span(response_buffer, n));
   #endif
 
-  return decoder::decode_message(bytes, nullptr);
+  return response.parse(byte_span(response_buffer, n));
 }
 
 void client::verbose(char const * format, ...)
@@ -627,9 +876,10 @@ network_access_type client::discover_network_access_type(server const & srv)
 
   sockaddr_storage server_addr = {};
 
-  std::unique_ptr<message> binding_response;
+  sockaddr_storage mapped = {};
+  bool binding_response = false;
   for (sockaddr_storage const & addr : addrs) {
-    binding_response = this->send_binding_request(addr, wait_time);
+    binding_response = this->send_binding_request(addr, wait_time, mapped);
     if (binding_response) {
       server_addr = addr;
       break;
@@ -655,132 +905,274 @@ network_access_type client::discover_network_access_type(server const & srv)
   return network_access_type::unknown;
 }
 
-std::unique_ptr<message> client::send_binding_request(std::chrono::milliseconds wait_time)
+bool client::send_binding_request(sockaddr_storage const & addr,
+  std::chrono::milliseconds wait_time, sockaddr_storage & mapped)
 {
-  std::unique_ptr<message> binding_response;
-  std::vector<sockaddr_storage> addrs = details::resolve_hostname(m_server.hostname, m_server.port, m_protocol);
-  for (sockaddr_storage const & addr : addrs) {
-    binding_response = this->send_binding_request(addr, wait_time);
-    if (binding_response)
-      break;
-    else
-      wait_time = std::min(wait_time * 2, details::binding_requests_wait_time_max);
-  }
-  return binding_response;
+  this->verbose("sending binding request with wait time:%lld ms\n", static_cast<long long>(wait_time.count()));
+  this->create_udp_socket(addr.ss_family);
+
+  transaction_id id;
+  details::random_fill(id.begin(), id.end());
+  uint8_t request[header_size + 8];
+  message_writer writer(request, sizeof(request));
+  writer.begin(message_type::binding_request, id);
+  writer.add_fingerprint();
+
+  uint8_t response_buffer[max_message_size];
+  message_reader response;
+  return this->send_message(addr, writer.bytes(), wait_time, response_buffer, sizeof(response_buffer), response)
+    && response.type() == message_type::binding_response
+    && response.has_id(id)
+    && !response.has_unknown_required()
+    && response.mapped_address(mapped);
 }
 
-std::unique_ptr<message> client::send_binding_request(sockaddr_storage const & addr, 
-  std::chrono::milliseconds wait_time)
+binder::binder(bool verbose)
+  : m_verbose(verbose)
+  , m_cancel_fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
 {
-  this->verbose("sending binding request with wait time:%lld ms\n", wait_time.count());
-  this->create_udp_socket(addr.ss_family);
-  std::unique_ptr<message> binding_request(message_factory::create_binding_request());
-  std::unique_ptr<message> binding_response(this->send_message(addr, *binding_request, wait_time));
-  return binding_response;
 }
 
-attributes::address::address(attribute const & attr)
+binder::~binder()
 {
-  size_t offset = 0;
+  if (m_cancel_fd != -1)
+    close(m_cancel_fd);
+}
 
-  // the family is actually 8-bits, but the pkt has a 1 byte padding
-  // for alignment
-  uint16_t family = decoder::decode_u16(attr.value, &offset);
-  if (family == 1) {
-    sockaddr_in * v4 = reinterpret_cast<sockaddr_in *>(&m_addr);
-    v4->sin_port = decoder::decode_u16(attr.value, &offset);
-    v4->sin_addr.s_addr = htonl(decoder::decode_u32(attr.value, &offset));
-    m_addr = * reinterpret_cast<sockaddr_storage *>(v4);
-    m_addr.ss_family = AF_INET;
-  }
-  else if (family == 2) {
-    sockaddr_in6 * v6 = reinterpret_cast<sockaddr_in6 *>(&m_addr);
-    v6->sin6_port = decoder::decode_u16(attr.value, &offset);
-    for (int i = 0; i < 16; ++i)
-      v6->sin6_addr.s6_addr[i] = attr.value[offset + i];
-    m_addr = * reinterpret_cast<sockaddr_storage *>(v6);
-    m_addr.ss_family = AF_INET6;
-  }
-  else
-    details::throw_error("invalid mapped address family:%d", family);
+void binder::cancel()
+{
+  uint64_t one = 1;
+  if (m_cancel_fd != -1 && write(m_cancel_fd, &one, sizeof(one)) < 0)
+    verbose("binder::cancel failed. %s\n", strerror(errno));
 }
 
-uint32_t decoder::decode_u32(buffer const & buff, size_t * offset)
+void binder::verbose(char const * format, ...)
 {
-  uint32_t const * p = reinterpret_cast<uint32_t const *>(&buff[*offset]);
-  uint32_t value = ntohl(*p);
-  *offset += 4;
-  return value;
+  if (!m_verbose)
+    return;
+  va_list ap;
+  va_start(ap, format);
+  printf("STUN:");
+  vprintf(format, ap);
+  va_end(ap);
+  return;
 }
 
-uint16_t decoder::decode_u16(buffer const & buff, size_t * offset)
+int binder::open_socket(int inet_family, std::string const & interface)
 {
-  uint16_t const * p = reinterpret_cast<uint16_t const *>(&buff[*offset]);
-  uint16_t value = ntohs(*p);
-  *offset += 2;
-  return value;
+  int soc = socket(inet_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (soc < 0) {
+    verbose("binder: error creating udp/%s socket. %s\n", details::family_to_string(inet_family), strerror(errno));
+    return -1;
+  }
+
+  if (!interface.empty()) {
+    sockaddr_storage local_addr = {};
+    #ifdef __cpp_exceptions
+    try
+    #endif
+    {
+      local_addr = details::get_interface_address(interface, inet_family);
+    }
+    #ifdef __cpp_exceptions
+    catch (std::exception const & err)
+    {
+      verbose("binder: %s\n", err.what());
+    }
+    #endif
+    if (local_addr.ss_family != inet_family
+      || ::bind(soc, reinterpret_cast<sockaddr const *>(&local_addr), details::socket_length(local_addr)) < 0) {
+      verbose("binder: failed to bind to local interface %s\n", interface.c_str());
+      close(soc);
+      return -1;
+    }
+  }
+  return soc;
 }
 
-message * decoder::decode_message(buffer const & buff, size_t * offset)
+int binder::receive(int fd, std::vector<destination> & destinations, sockaddr_storage & mapped)
 {
-  size_t temp_offset = 0;
-  if (offset)
-    temp_offset = *offset;
+  uint8_t bytes[max_message_size];
+  sockaddr_storage from_addr = {};
+  socklen_t len = sizeof(from_addr);
+  ssize_t n = recvfrom(fd, bytes, sizeof(bytes), 0, reinterpret_cast<sockaddr *>(&from_addr), &len);
+  if (n < 0)
+    return (errno == EINTR) ? -1 : -2;
 
-  // TODO: use a factory
-  // create  a map[ message_type ] = message_factory_method
+  message_reader response;
+  if (!response.parse(byte_span(bytes, n)))
+    return -1;
 
-  message * new_message = nullptr;
-  message_header header;
-  header.message_type = decoder::decode_u16(buff, &temp_offset);
-  header.message_length = decoder::decode_u16(buff, &temp_offset);
-  if (header.message_type == message_type::binding_response) {
-    for (size_t i = 0, n = header.transaction_id.size(); i < n; ++i)
-      header.transaction_id[i] = buff[temp_offset++ + i];
-    new_message = new message();
-    new_message->m_header = header;
-    while (temp_offset < buff.size())
-      new_message->m_attrs.push_back(decoder::decode_attr(buff, &temp_offset)); 
+  int index = -1;
+  for (size_t i = 0; i < destinations.size(); ++i) {
+    if (response.has_id(destinations[i].id)) {
+      index = static_cast<int>(i);
+      break;
+    }
   }
-  else {
-    // TODO: unsupported message type
+  if (index < 0)
+    return -1;
+
+  if (response.type() == message_type::binding_error_response) {
+    uint16_t code = 0;
+    response.error_code(code);
+    verbose("binder: error %u from %s\n", code, sockaddr_to_string(from_addr).c_str());
+    destinations[index].failed = true;
+    return -1;
   }
+  if (response.type() != message_type::binding_response)
+    return -1;
 
-  if (offset)
-    *offset = temp_offset;
-
-  return new_message;
+  if (response.has_unknown_required() || !response.mapped_address(mapped)) {
+    verbose("binder: response from %s has no usable mapped address\n", sockaddr_to_string(from_addr).c_str());
+    destinations[index].failed = true;
+    return -1;
+  }
+  verbose("binder: response from %s\n", sockaddr_to_string(from_addr).c_str());
+  return index;
 }
 
-attribute decoder::decode_attr(buffer const & buff, size_t * offset)
+bool binder::run(std::vector<server> const & servers,
+  std::string const & interface,
+  protocol proto,
+  std::chrono::milliseconds timeout,
+  bind_result& result)
 {
-  attribute t = {};
-  t.type = decoder::decode_u16(buff, offset);
-  t.length = decoder::decode_u16(buff, offset);
-  t.value.insert(std::end(t.value), std::begin(buff) + *offset,
-      std::begin(buff) + *offset + t.length);
-  *offset += t.value.size();
-  return t;
-}
+  int const family = (proto == protocol::af_inet6) ? AF_INET6 : AF_INET;
 
-void encoder::encode_u16(buffer & buff, uint16_t n)
-{
-  uint16_t temp = htons(n);
-  uint8_t * p = reinterpret_cast< uint8_t * >(&temp);
-  buff.push_back(p[0]);
-  buff.push_back(p[1]);
-  return;
+  std::vector<destination> destinations;
+  std::set<std::string> already_seen;
+  for (server const & srv : servers) {
+    std::vector<sockaddr_storage> addrs;
+    #ifdef __cpp_exceptions
+    try
+    #endif
+    {
+      addrs = details::resolve_hostname(srv.hostname, srv.port, proto);
+    }
+    #ifdef __cpp_exceptions
+    catch (std::exception const & err)
+    {
+      verbose("binder: cannot resolve %s. %s\n", srv.hostname.c_str(), err.what());
+    }
+    #endif
+    for (sockaddr_storage const & addr : addrs) {
+      std::string const key = sockaddr_to_string(addr) + "/" + std::to_string(details::sockaddr_get_port(addr));
+      if (!already_seen.insert(key).second)
+        continue;
+      destination dest;
+      dest.addr = addr;
+      details::random_fill(dest.id.begin(), dest.id.end());
+      message_writer writer(dest.request.data(), dest.request.size());
+      writer.begin(message_type::binding_request, dest.id);
+      writer.add_fingerprint();
+      dest.request_size = writer.size();
+      dest.failed = false;
+      destinations.push_back(dest);
+      verbose("binder: server %s\n", key.c_str());
+    }
+  }
+  if (destinations.empty()) {
+    verbose("binder: no %s server address\n", details::family_to_string(family));
+    return false;
+  }
+
+  details::file_descriptor fd(open_socket(family, interface));
+  if (fd < 0)
+    return false;
+
+  auto const start = std::chrono::steady_clock::now();
+  auto deadline = start + timeout;
+  auto next_send = start;
+  std::chrono::milliseconds rto(STUN_RTO_INITIAL_MS);
+  int transmissions = 0;
+
+  while (true) {
+    auto now = std::chrono::steady_clock::now();
+    if (transmissions < STUN_MAX_TRANSMISSIONS && now >= next_send) {
+      for (destination & dest : destinations) {
+        if (dest.failed)
+          continue;
+        if (sendto(fd, dest.request.data(), dest.request_size, 0, reinterpret_cast<sockaddr const *>(&dest.addr), details::socket_length(dest.addr)) < 0) {
+          verbose("binder: failed to send to %s. %s\n", sockaddr_to_string(dest.addr).c_str(), strerror(errno));
+          if (errno == ENETUNREACH || errno == EHOSTUNREACH || errno == EINVAL)
+            dest.failed = true;
+        }
+      }
+      if (++transmissions < STUN_MAX_TRANSMISSIONS) {
+        next_send = now + rto;
+        rto *= 2;
+      }
+      else
+        deadline = std::min(deadline, now + std::chrono::milliseconds(STUN_RTO_INITIAL_MS * STUN_LAST_WAIT_RTO));
+    }
+
+    if (std::all_of(destinations.begin(), destinations.end(), [](destination const & dest) { return dest.failed; })) {
+      verbose("binder: no server can give the mapped address\n");
+      return false;
+    }
+    if (now >= deadline) {
+      verbose("binder: no response in %lld ms\n", static_cast<long long>(timeout.count()));
+      return false;
+    }
+
+    auto wake = (transmissions < STUN_MAX_TRANSMISSIONS) ? std::min(next_send, deadline) : deadline;
+    int const wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wake - now).count()) + 1;
+    pollfd fds[2] = { { fd, POLLIN, 0 }, { m_cancel_fd, POLLIN, 0 } };
+    int ret = poll(fds, (m_cancel_fd != -1) ? 2 : 1, wait_ms);
+    if (ret < 0 && errno != EINTR) {
+      verbose("binder: poll failed. %s\n", strerror(errno));
+      return false;
+    }
+    if (ret > 0 && (fds[1].revents & POLLIN)) {
+      verbose("binder: cancelled\n");
+      return false;
+    }
+    if (ret > 0 && (fds[0].revents & POLLIN)) {
+      sockaddr_storage mapped = {};
+      int index;
+      while ((index = receive(fd, destinations, mapped)) != -2) {
+        if (index >= 0) {
+          result.public_ip = sockaddr_to_string(mapped);
+          verbose("binder: public_ip=%s after %lld ms\n", result.public_ip.c_str(),
+            static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()));
+          return true;
+        }
+      }
+    }
+  }
 }
 
-void encoder::encode_u32(buffer & buff, uint32_t n)
+std::vector<server> parse_servers(std::string const & list, uint16_t default_port)
 {
-  uint32_t temp = htons(n);
-  uint8_t * p = reinterpret_cast<uint8_t *>(&temp);
-  buff.push_back(p[0]);
-  buff.push_back(p[1]);
-  buff.push_back(p[2]);
-  buff.push_back(p[3]);
-  return;
+  std::vector<server> servers;
+  std::stringstream items(list);
+  std::string item;
+  while (std::getline(items, item, ',')) {
+    item.erase(0, item.find_first_not_of(" \t"));
+    item.erase(item.find_last_not_of(" \t") + 1);
+    if (item.empty())
+      continue;
+
+    std::string host = item;
+    std::string port;
+    if (item[0] == '[') {
+      size_t close_bracket = item.find(']');
+      if (close_bracket == std::string::npos)
+        continue;
+      host = item.substr(1, close_bracket - 1);
+      if (close_bracket + 1 < item.size() && item[close_bracket + 1] == ':')
+        port = item.substr(close_bracket + 2);
+    }
+    else if (item.find(':') != std::string::npos && item.find(':') == item.rfind(':')) {
+      host = item.substr(0, item.find(':'));
+      port = item.substr(item.find(':') + 1);
+    }
+
+    unsigned long number = port.empty() ? 0 : strtoul(port.c_str(), nullptr, 10);
+    servers.push_back(server(host, (number > 0 && number <= 0xffff) ? static_cast<uint16_t>(number) : default_port));
+  }
+  return servers;
 }
 
 std::string sockaddr_to_string(sockaddr_storage const & addr)
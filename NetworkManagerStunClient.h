@@ -2,9 +2,10 @@
 #define STUN_CLIENT_H
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
-#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <netinet/in.h>
@@ -12,13 +13,6 @@
 namespace stun
 {
 
-class encoder;
-class decoder;
-class message;
-class message_factory;
-
-using buffer = std::vector<uint8_t>;
-
 enum class network_access_type {
   udp_blocked,
   open_internet,
@@ -31,97 +25,123 @@ enum class network_access_type {
 };
 
 namespace message_type {
-  static uint16_t constexpr binding_request = 0x001;
+  static uint16_t constexpr binding_request = 0x0001;
   static uint16_t constexpr binding_response = 0x0101;
   static uint16_t constexpr binding_error_response = 0x0111;
-  static uint16_t constexpr shared_secret_request = 0x0002;
-  static uint16_t constexpr shared_secret_response = 0x0102;
-  static uint16_t constexpr shared_secret_error_response = 0x0112;
+  static uint16_t constexpr binding_indication = 0x0011;
 }
 
 namespace attribute_type {
-  static uint16_t constexpr mapped_address = 0x001;
-  static uint16_t constexpr response_address = 0x0002;
-  static uint16_t constexpr change_request = 0x0003;
-  static uint16_t constexpr source_address = 0x004;
-  static uint16_t constexpr changed_address = 0x005;
+  static uint16_t constexpr mapped_address = 0x0001;
   static uint16_t constexpr username = 0x0006;
-  static uint16_t constexpr password = 0x0007;
   static uint16_t constexpr message_integrity = 0x0008;
   static uint16_t constexpr error_code = 0x0009;
   static uint16_t constexpr unknown_attributes = 0x000a;
-  static uint16_t constexpr reflected_from = 0x000b;
+  static uint16_t constexpr realm = 0x0014;
+  static uint16_t constexpr nonce = 0x0015;
+  static uint16_t constexpr message_integrity_sha256 = 0x001c;
+  static uint16_t constexpr password_algorithm = 0x001d;
+  static uint16_t constexpr userhash = 0x001e;
+  static uint16_t constexpr xor_mapped_address = 0x0020;
+  static uint16_t constexpr password_algorithms = 0x8002;
+  static uint16_t constexpr alternate_domain = 0x8003;
+  static uint16_t constexpr software = 0x8022;
+  static uint16_t constexpr alternate_server = 0x8023;
+  static uint16_t constexpr fingerprint = 0x8028;
 }
 
-struct attribute {
-  uint16_t type;
-  uint16_t length;
-  std::vector<uint8_t> value;
-};
+// RFC 5389/8489: the first 4 bytes of the 16 byte RFC 3489 transaction id
+static uint32_t constexpr magic_cookie = 0x2112a442;
+static uint32_t constexpr fingerprint_xor = 0x5354554e;
+static size_t constexpr header_size = 20;
+// what a message over UDP is kept to without path MTU discovery, RFC 8489 6.1
+static size_t constexpr max_message_size = 548;
 
-namespace attributes {
-  class address {
-  public:
-    address(attribute const & attr);
-    inline sockaddr_storage addr() const {
-      return m_addr;
-    }
-  private:
-    sockaddr_storage m_addr;
-  };
-  struct mapped_address : public address {
-    mapped_address(attribute const & attr) : address(attr) { }
-  };
-  struct source_address : public address {
-    source_address(attribute const & attr) : address(attr) { }
-  };
-  struct changed_address : public address {
-    changed_address(attribute const & attr) : address(attr) { }
-  };
-}
+using transaction_id = std::array<uint8_t, 12>;
 
-struct message_header {
-  uint16_t message_type;
-  uint16_t message_length;
-  std::array<uint8_t, 16> transaction_id;
-};
-
-class message {
-  friend class encoder;
-  friend class decoder;
-  friend class message_factory;
+/*
+ * Bytes someone else owns. Every read says whether it was in range, so a parser never reads past the end
+ * and needs no copy of what it parses.
+ */
+class byte_span {
 public:
-  buffer encode() const;
-  inline std::vector<attribute> const & attributes() const {
-    return m_attrs;
-  }
+  byte_span() : m_data(nullptr), m_size(0) { }
+  byte_span(uint8_t const * data, size_t size) : m_data(data), m_size(size) { }
 
-  attribute const * find_attribute(uint16_t attr_type) const;
+  uint8_t const * data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  bool read_u8(size_t offset, uint8_t & value) const;
+  bool read_u16(size_t offset, uint16_t & value) const;
+  bool read_u32(size_t offset, uint32_t & value) const;
+  bool subspan(size_t offset, size_t length, byte_span & span) const;
 
 private:
-  message_header  m_header;
-  std::vector<attribute> m_attrs;
+  uint8_t const * m_data;
+  size_t m_size;
 };
 
-class message_factory final {
+/*
+ * Encodes a message into a buffer the caller owns, a stack array for everything this client sends.
+ * An attribute that does not fit makes the writer fail, ok() then stays false and size() 0.
+ */
+class message_writer {
 public:
-  static message * create_binding_request();
-};
+  message_writer(uint8_t * buffer, size_t capacity);
 
-class decoder final {
-public:
-  static uint16_t  decode_u16(buffer const & buff, size_t * offset);
-  static uint32_t  decode_u32(buffer const & buff, size_t * offset);
-  static attribute decode_attr(buffer const & buff, size_t * offset);
-  static message * decode_message(buffer const & buff, size_t * offset);
+  void begin(uint16_t type, transaction_id const & id);
+  // value padded to 4 bytes
+  void add_attribute(uint16_t type, byte_span value);
+  void add_xor_mapped_address(sockaddr_storage const & addr);
+  // the CRC-32 of everything before it, so it goes last
+  void add_fingerprint();
+
+  bool ok() const { return m_ok; }
+  size_t size() const { return m_ok ? m_size : 0; }
+  byte_span bytes() const { return byte_span(m_buffer, size()); }
+
+private:
+  void write_u16(size_t offset, uint16_t value);
+  void write_u32(size_t offset, uint32_t value);
+  bool reserve(size_t length);
+
+  uint8_t * m_buffer;
+  size_t m_capacity;
+  size_t m_size;
+  bool m_ok;
 };
 
-class encoder final {
+/*
+ * Checks a message in place: the header, the magic cookie, that every attribute lies within the length
+ * and that a FINGERPRINT, when there is one, is the last attribute and matches. Attributes are then found
+ * by walking the bytes again; a message has a handful, so that beats decoding them into a container.
+ */
+class message_reader {
 public:
-  static void encode_u16(buffer & buff, uint16_t n);
-  static void encode_u32(buffer & buff, uint32_t n);
+  message_reader() : m_bytes(), m_type(0) { }
+
+  // false when bytes are not a STUN message, the reader then holds none
+  bool parse(byte_span bytes);
+
+  uint16_t type() const { return m_type; }
+  bool has_id(transaction_id const & id) const;
+  bool find(uint16_t attr_type, byte_span & value) const;
+  // XOR-MAPPED-ADDRESS, or MAPPED-ADDRESS from a server that only speaks RFC 3489
+  bool mapped_address(sockaddr_storage & addr) const;
+  // class * 100 + number
+  bool error_code(uint16_t & code) const;
+  // a comprehension required attribute this client does not know; a response with one is discarded
+  bool has_unknown_required() const;
+
+private:
+  bool decode_address(byte_span value, bool xored, sockaddr_storage & addr) const;
+
+  byte_span m_bytes;
+  uint16_t m_type;
 };
 
+uint32_t crc32(byte_span bytes);
+
 struct server {
   server(std::string const& h, uint16_t p)
     : hostname(h), port(p)
@@ -142,11 +162,54 @@ struct bind_result {
   std::string public_ip;
 };
 
+/*
+ * One binding, sent to every address of every server at once from one non blocking socket. The requests
+ * go out again on the RFC 5389 schedule, the RTO doubling from 500 ms, until a server answers with its
+ * XOR-MAPPED-ADDRESS (or the MAPPED-ADDRESS of an RFC 3489 server), every server has answered with an
+ * error, the timeout passes or cancel() is called.
+ */
+class binder {
+public:
+  explicit binder(bool verbose);
+  ~binder();
+
+  bool run(std::vector<server> const & servers,
+    std::string const & interface,
+    protocol proto,
+    std::chrono::milliseconds timeout,
+    bind_result& result);
+
+  // from any thread; run returns false at once, or right away when it has not started yet
+  void cancel();
+
+private:
+  struct destination {
+    sockaddr_storage addr;
+    transaction_id id;
+    // binding request with FINGERPRINT, encoded once and sent again as it is
+    std::array<uint8_t, header_size + 8> request;
+    size_t request_size;
+    bool failed;
+  };
+
+  binder(binder const &) = delete;
+  binder & operator=(binder const &) = delete;
+
+  void verbose(char const * format, ...) __attribute__((format(printf, 2, 3)));
+  int open_socket(int inet_family, std::string const & interface);
+  // index of the destination a binding response answers, -1 for anything else, -2 when nothing is left to read
+  int receive(int fd, std::vector<destination> & destinations, sockaddr_storage & mapped);
+
+  bool m_verbose;
+  int m_cancel_fd;
+};
+
 class client {
 public:
   client();
   ~client();
 
+  // hostname may list several servers, comma separated, each as host or host:port ([v6]:port)
   bool bind(std::string const & hostname, 
     uint16_t port,
     std::string const & interface, 
@@ -157,6 +220,9 @@ public:
 
   network_access_type discover_network_access_type(server const & srv);
 
+  // from any thread; the bind in progress, if any, fails at once and so does every bind after it
+  void cancel();
+
   inline void set_verbose(bool b) {
     m_verbose = b;
   }
@@ -164,13 +230,13 @@ private:
   void verbose(char const * format, ...) __attribute__((format(printf, 2, 3)));
   void create_udp_socket(int inet_family);
 
-  std::unique_ptr<message> send_binding_request(std::chrono::milliseconds wait_time);
+  bool send_binding_request(sockaddr_storage const & addr,
+    std::chrono::milliseconds wait_time, sockaddr_storage & mapped);
 
-  std::unique_ptr<message> send_binding_request(sockaddr_storage const & addr,
-    std::chrono::milliseconds wait_time);
-
-  message * send_message(sockaddr_storage const & remote_adr, message const & req,
-    std::chrono::milliseconds wait_time, int * local_iface_index = nullptr);
+  // the response is parsed in response_buffer, which it refers to
+  bool send_message(sockaddr_storage const & remote_adr, byte_span request,
+    std::chrono::milliseconds wait_time, uint8_t * response_buffer, size_t capacity,
+    message_reader & response, int * local_iface_index = nullptr);
 
 private:
   server m_server;
@@ -182,10 +248,16 @@ private:
   bind_result m_last_result;
   bool m_verbose;
   int m_fd;
+  std::mutex m_bind_lock;
+  std::mutex m_active_lock;
+  binder * m_active;
+  std::atomic<bool> m_cancelled;
 };
 
 std::string sockaddr_to_string(sockaddr_storage const & addr);
 
+std::vector<server> parse_servers(std::string const & list, uint16_t default_port);
+
 }
 
 #endif
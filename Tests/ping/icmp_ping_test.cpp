@@ -0,0 +1,237 @@
+#include "IcmpPing.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+
+/*
+ * IcmpPing against the loopback, on whatever ICMP socket the host allows. The raw socket fallback is then
+ * run again in a network namespace of its own, where ping sockets are off and echo requests can be left
+ * unanswered, with echo replies of another run flooding the socket.
+ */
+
+using namespace WPEFramework::Plugin;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* label, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL: %s: %s\n", label, what);
+            failures++;
+        }
+    }
+
+    long elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    bool writeFile(const char* path, const char* value)
+    {
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        bool written = write(fd, value, strlen(value)) == static_cast<ssize_t>(strlen(value));
+        close(fd);
+        return written;
+    }
+
+    const char* loopback(int family)
+    {
+        return (family == AF_INET6) ? "::1" : "127.0.0.1";
+    }
+
+    /* echo replies from the loopback for every sequence of a run, with an identifier and payload of their own */
+    class ForeignReplies
+    {
+        public:
+            ForeignReplies(int family)
+                : family(family), fd(-1), stopping(false), sent(0)
+            {
+                fd = socket(family, SOCK_RAW | SOCK_CLOEXEC, (family == AF_INET6) ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP));
+                if (fd >= 0)
+                    sender = std::thread(&ForeignReplies::flood, this);
+            }
+
+            ~ForeignReplies()
+            {
+                stopping = true;
+                if (sender.joinable())
+                    sender.join();
+                if (fd >= 0)
+                    close(fd);
+            }
+
+            bool ok() const { return fd >= 0; }
+
+            const int family;
+            int fd;
+            std::atomic<bool> stopping;
+            std::atomic<int> sent;
+
+        private:
+            void flood()
+            {
+                sockaddr_storage address;
+                socklen_t addressLen = 0;
+                if (!IcmpPing::resolve(loopback(family), family, address, addressLen))
+                    return;
+
+                std::random_device random;
+                uint8_t packet[8 + ICMP_PING_PAYLOAD_SIZE];
+                memset(packet, 0, sizeof(packet));
+                packet[0] = (family == AF_INET6) ? 129 : 0;
+                packet[4] = static_cast<uint8_t>(random());
+                packet[5] = static_cast<uint8_t>(random());
+                for (size_t i = 8; i < sizeof(packet); i++)
+                    packet[i] = static_cast<uint8_t>(random());
+
+                for (uint16_t sequence = 0; !stopping; sequence = (sequence + 1) % 8)
+                {
+                    packet[2] = packet[3] = 0;
+                    packet[6] = sequence >> 8;
+                    packet[7] = sequence & 0xFF;
+                    /* ICMPv6 is summed by the kernel */
+                    if (family == AF_INET)
+                    {
+                        uint16_t sum = IcmpPing::checksum(packet, sizeof(packet));
+                        packet[2] = sum >> 8;
+                        packet[3] = sum & 0xFF;
+                    }
+                    if (sendto(fd, packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&address), addressLen) == static_cast<ssize_t>(sizeof(packet)))
+                        sent++;
+                    usleep(1000);
+                }
+            }
+
+            std::thread sender;
+    };
+
+    /* false when no ICMP socket could be opened, the rest of the run is skipped then */
+    bool testLoopback(int family)
+    {
+        const char* label = loopback(family);
+        IcmpPing ping(family);
+        IcmpPingResult result;
+        bool ok = ping.run(label, 5, 1000, result, 50);
+        printf("%-32s ok=%d %u/%u loss=%.0f%% min/avg/max %.3f/%.3f/%.3f ms %s\n", label, ok, result.received, result.transmitted,
+               result.loss, result.min, result.avg, result.max, result.error.c_str());
+        if (result.error == "Could not open ICMP socket")
+            return false;
+
+        check(ok, label, "no reply from the loopback");
+        check(result.target == label, label, "wrong target");
+        check(result.transmitted == 5 && result.received == 5, label, "not every probe sent and answered");
+        check(result.loss == 0, label, "loss on the loopback");
+        check(result.rtts.size() == 5, label, "not one rtt per probe");
+        for (double rtt : result.rtts)
+            check(rtt >= 0 && rtt < 1000, label, "rtt out of range");
+        check(result.min >= 0 && result.min <= result.avg && result.avg <= result.max, label, "min <= avg <= max does not hold");
+        check(result.stddev >= 0 && result.stddev <= result.max - result.min, label, "stddev out of range");
+        check(ping.progress() == 100, label, "progress not 100 at the end");
+        return true;
+    }
+
+    void testCancel(int family)
+    {
+        IcmpPing ping(family);
+        IcmpPingResult result;
+        /* 100 probes 200 ms apart take 20 s, the cancel comes after a few */
+        std::thread canceller([&ping] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            ping.cancel();
+        });
+        auto const start = std::chrono::steady_clock::now();
+        bool ok = ping.run(loopback(family), 100, 1000, result);
+        long took = elapsedMs(start);
+        canceller.join();
+        printf("%-32s ok=%d %u/%u %ld ms %s\n", "cancel", ok, result.received, result.transmitted, took, result.error.c_str());
+
+        check(!ok && result.error == "Cancelled", "cancel", "run not cancelled");
+        check(took < 300 + 2 * ICMP_CANCEL_CHECK_MS, "cancel", "cancel did not stop the run");
+        check(result.transmitted > 0 && result.transmitted < 100, "cancel", "wrong number of probes sent");
+        check(result.rtts.size() == result.transmitted, "cancel", "rtts of probes never sent");
+        check(ping.progress() == 100, "cancel", "progress not 100 at the end");
+    }
+
+    /* loopback up in a network namespace of this process, nothing else of the host is touched after this */
+    bool privateNetwork()
+    {
+        if (unshare(CLONE_NEWNET) < 0)
+            return false;
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        struct ifreq request;
+        memset(&request, 0, sizeof(request));
+        strncpy(request.ifr_name, "lo", sizeof(request.ifr_name) - 1);
+        bool up = fd >= 0 && ioctl(fd, SIOCGIFFLAGS, &request) == 0;
+        request.ifr_flags |= IFF_UP;
+        up = up && ioctl(fd, SIOCSIFFLAGS, &request) == 0;
+        if (fd >= 0)
+            close(fd);
+        /* no ping sockets for anyone, IcmpPing falls back to a raw socket */
+        return up && writeFile("/proc/sys/net/ipv4/ping_group_range", "1\t0");
+    }
+
+    void testRawFilter(int family)
+    {
+        const char* label = (family == AF_INET6) ? "raw filter ::1" : "raw filter 127.0.0.1";
+        const char* ignore = (family == AF_INET6) ? "/proc/sys/net/ipv6/icmp/echo_ignore_all" : "/proc/sys/net/ipv4/icmp_echo_ignore_all";
+        ForeignReplies foreign(family);
+        check(foreign.ok(), label, "no raw socket for the foreign replies");
+        if (!foreign.ok())
+            return;
+
+        /* only the foreign replies come back, none of them is this run's */
+        IcmpPing ping(family);
+        IcmpPingResult result;
+        check(writeFile(ignore, "1"), label, "echo requests still answered");
+        bool ok = ping.run(loopback(family), 5, 300, result, 50);
+        printf("%-32s unanswered ok=%d %u/%u with %d foreign replies\n", label, ok, result.received, result.transmitted, static_cast<int>(foreign.sent));
+        check(!ok && result.transmitted == 5 && result.received == 0, label, "foreign reply taken for this run's");
+
+        /* and the run's own replies are still taken among them */
+        writeFile(ignore, "0");
+        ok = ping.run(loopback(family), 5, 1000, result, 50);
+        printf("%-32s answered ok=%d %u/%u with %d foreign replies\n", label, ok, result.received, result.transmitted, static_cast<int>(foreign.sent));
+        check(ok && result.received == 5 && result.loss == 0, label, "own replies not taken among foreign ones");
+        check(foreign.sent > 0, label, "no foreign reply sent");
+    }
+}
+
+int main()
+{
+    if (!testLoopback(AF_INET))
+    {
+        printf("%-32s skipped, no ICMP socket\n", "loopback");
+        return 0;
+    }
+    if (!testLoopback(AF_INET6))
+        printf("%-32s skipped, no ICMPv6 socket\n", "::1");
+    testCancel(AF_INET);
+
+    if (privateNetwork())
+    {
+        testRawFilter(AF_INET);
+        testRawFilter(AF_INET6);
+    }
+    else
+        printf("%-32s skipped, no network namespace of its own (CAP_SYS_ADMIN)\n", "raw filter");
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+#include "WiFiScanResults.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+
+/*
+ * Time per scan of the onAvailableSSIDs event, from the access point records to the message each subscriber
+ * gets. The old way built a JsonArray of JsonObjects and serialized it, and every subscriber parsed that text
+ * back into a JsonArray and serialized it again. Now the text is made once by WiFiScanResults and each
+ * subscriber embeds it as it is. Arguments: scans, access points per scan, subscribers.
+ */
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace
+{
+    /* NetworkManager::AvailableSSIDsParams */
+    class AvailableSSIDsParams : public Core::JSON::Container
+    {
+        public:
+            AvailableSSIDsParams()
+                : Core::JSON::Container()
+                , ssids(false)
+            {
+                Add(_T("ssids"), &ssids);
+            }
+
+            Core::JSON::String ssids;
+    };
+
+    std::vector<WiFiScanResults::AccessPoint> scanOf(unsigned long count)
+    {
+        std::vector<WiFiScanResults::AccessPoint> accessPoints(count);
+        for (unsigned long i = 0; i < count; i++)
+        {
+            WiFiScanResults::AccessPoint& accessPoint = accessPoints[i];
+            accessPoint.m_ssid = (i % 7 == 0) ? "Caf\xc3\xa9 \"guest\" " + std::to_string(i) : "network-" + std::to_string(i);
+            accessPoint.m_bssid = 0x0200000000ULL + i;
+            accessPoint.m_frequency = (i % 2) ? 5180 : 2412;
+            accessPoint.m_rssi = static_cast<int16_t>(-40 - static_cast<int>(i % 50));
+            accessPoint.m_strength = static_cast<uint8_t>(100 - i % 50);
+            accessPoint.m_securityMode = Exchange::INetworkManager::WIFI_SECURITY_WPA2_PSK_AES;
+            accessPoint.m_securityFlags = 0;
+            accessPoint.m_lastSeen = -1;
+        }
+        return accessPoints;
+    }
+
+    double usPerScan(std::chrono::steady_clock::time_point start, unsigned long scans)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / scans;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const unsigned long scans = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+    const unsigned long count = argc > 2 ? strtoul(argv[2], nullptr, 10) : 60;
+    const unsigned long subscribers = argc > 3 ? strtoul(argv[3], nullptr, 10) : 3;
+    if (scans == 0 || subscribers == 0)
+        return 1;
+
+    const std::vector<WiFiScanResults::AccessPoint> records = scanOf(count);
+
+    /* the message sizes are summed so the loops are not optimized away */
+    size_t oldBytes = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long scan = 0; scan < scans; scan++)
+    {
+        JsonArray ssidList;
+        for (const auto& accessPoint : records)
+        {
+            JsonObject ssidObj;
+            ssidObj["ssid"] = accessPoint.m_ssid;
+            ssidObj["security"] = static_cast<int>(accessPoint.m_securityMode);
+            ssidObj["signalStrength"] = static_cast<int>(accessPoint.m_strength);
+            ssidObj["frequency"] = WiFiScanResults::frequencyBand(accessPoint.m_frequency);
+            ssidList.Add(ssidObj);
+        }
+        string ssidListJson;
+        ssidList.ToString(ssidListJson);
+
+        for (unsigned long subscriber = 0; subscriber < subscribers; subscriber++)
+        {
+            JsonArray scanResults;
+            JsonObject result;
+            scanResults.FromString(ssidListJson);
+            result["ssids"] = scanResults;
+            string message;
+            result.ToString(message);
+            oldBytes += message.size();
+        }
+    }
+    const double before = usPerScan(start, scans);
+
+    size_t newBytes = 0;
+    string lastMessage;
+    start = std::chrono::steady_clock::now();
+    for (unsigned long scan = 0; scan < scans; scan++)
+    {
+        std::vector<WiFiScanResults::AccessPoint> accessPoints(records);
+        std::shared_ptr<const WiFiScanResults> shared = std::make_shared<WiFiScanResults>(std::move(accessPoints));
+
+        for (unsigned long subscriber = 0; subscriber < subscribers; subscriber++)
+        {
+            AvailableSSIDsParams result;
+            result.ssids = shared->json();
+            lastMessage.clear();
+            result.ToString(lastMessage);
+            newBytes += lastMessage.size();
+        }
+    }
+    const double after = usPerScan(start, scans);
+
+    printf("%lu scans of %lu access points to %lu subscribers: per subscriber serialization %.1f us, shared text %.1f us, %zu and %zu bytes per message\n",
+           scans, count, subscribers, before, after, oldBytes / (scans * subscribers), newBytes / (scans * subscribers));
+
+    /* what the subscribers get now is still the event the old way made */
+    JsonObject message;
+    return (message.FromString(lastMessage) && message["ssids"].Array().Length() == count) ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#include "WiFiScanResults.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * WiFiScanResults from the JSON text of the IARM event: a scan that parses is published as it came, text that
+ * does not is published as a JSON string so the onAvailableSSIDs event it is embedded in stays valid JSON.
+ */
+
+using namespace WPEFramework;
+using namespace WPEFramework::Plugin;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* label, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL: %s: %s\n", label, what);
+            failures++;
+        }
+    }
+
+    /* NetworkManager::AvailableSSIDsParams */
+    class AvailableSSIDsParams : public Core::JSON::Container
+    {
+        public:
+            AvailableSSIDsParams()
+                : Core::JSON::Container()
+                , ssids(false)
+            {
+                Add(_T("ssids"), &ssids);
+            }
+
+            Core::JSON::String ssids;
+    };
+
+    /* the event as a subscriber gets it, parsed back */
+    bool publish(const WiFiScanResults& scan, JsonObject& event)
+    {
+        AvailableSSIDsParams result;
+        result.ssids = scan.json();
+        string message;
+        result.ToString(message);
+        return event.FromString(message);
+    }
+}
+
+int main()
+{
+    {
+        const char* iarm = "[{\"ssid\":\"home\",\"security\":6,\"signalStrength\":\"-48.000000\",\"frequency\":\"5.000000\"},"
+                           "{\"ssid\":\"home\",\"security\":6,\"signalStrength\":\"-71.000000\",\"frequency\":\"2.400000\"}]";
+        WiFiScanResults scan{std::string(iarm)};
+        const std::vector<WiFiScanResults::AccessPoint>& accessPoints = scan.accessPoints();
+        check(accessPoints.size() == 2, "iarm", "access points not parsed");
+        if (accessPoints.size() == 2)
+        {
+            check(accessPoints[0].m_frequency == 5000 && accessPoints[0].m_rssi == -48 && accessPoints[0].m_bssid == 0, "iarm", "record values");
+            check(WiFiScanResults::keyOf(accessPoints[0]) != WiFiScanResults::keyOf(accessPoints[1]), "iarm", "bands of one SSID share a key");
+            check(WiFiScanResults::keyOf(accessPoints[0]) > 0xFFFFFFFFFFFFULL, "iarm", "key in the BSSID range");
+        }
+        check(scan.json() == iarm, "iarm", "text not published as it came");
+        JsonObject event;
+        check(publish(scan, event) && event["ssids"].Array().Length() == 2, "iarm", "event does not parse");
+    }
+
+    {
+        const char* truncated = "[{\"ssid\":\"home\",\"security\":6,\"signalStr";
+        WiFiScanResults scan{std::string(truncated)};
+        check(scan.accessPoints().empty(), "malformed", "access points from text that does not parse");
+        check(!scan.json().empty() && scan.json()[0] == '"', "malformed", "text not quoted");
+        JsonObject event;
+        check(publish(scan, event), "malformed", "event does not parse");
+        check(event["ssids"].String() == truncated, "malformed", "quoted text is not the text");
+    }
+
+    {
+        WiFiScanResults scan{std::string()};
+        check(scan.json() == "[]", "empty", "empty text not an empty array");
+    }
+
+    {
+        /* json() first, as the dispatcher thread may get to it before anything reads the records */
+        WiFiScanResults scan{std::string("{\"ssid\":")};
+        check(scan.json()[0] == '"', "json first", "text not quoted");
+        check(scan.accessPoints().empty(), "json first", "access points from text that does not parse");
+    }
+
+    {
+        std::vector<WiFiScanResults::AccessPoint> accessPoints(1);
+        accessPoints[0].m_ssid = "guest \"5G\"";
+        accessPoints[0].m_bssid = 0x0200000000ULL;
+        accessPoints[0].m_frequency = 5180;
+        accessPoints[0].m_rssi = -55;
+        accessPoints[0].m_strength = 90;
+        accessPoints[0].m_securityMode = Exchange::INetworkManager::WIFI_SECURITY_WPA2_PSK_AES;
+        accessPoints[0].m_securityFlags = 0;
+        accessPoints[0].m_lastSeen = -1;
+        WiFiScanResults scan(std::move(accessPoints));
+        JsonObject event;
+        check(publish(scan, event) && event["ssids"].Array().Length() == 1, "records", "event does not parse");
+        check(scan.json().find("\"ssid\":\"guest \\\"5G\\\"\"") != std::string::npos, "records", "ssid not escaped");
+    }
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+#include "NetworkManagerStunClient.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+/*
+ * binder and client against STUN servers on the loopback, each a thread with its own UDP socket that
+ * answers binding requests the way a real server, a broken one or a silent one would.
+ */
+
+using namespace stun;
+
+namespace {
+  int failures = 0;
+
+  void check(bool condition, char const * label, char const * what) {
+    if (!condition) {
+      fprintf(stderr, "FAIL: %s: %s\n", label, what);
+      failures++;
+    }
+  }
+
+  enum class mode {
+    answer,
+    silent,
+    error,
+    bad_fingerprint
+  };
+
+  class responder {
+  public:
+    // drop is the number of requests ignored before the first answer, to make the client send again
+    responder(int family, mode how, int drop = 0)
+      : m_mode(how), m_drop(drop), m_requests(0), m_stop(false), m_fd(-1), m_port(0)
+    {
+      m_fd = socket(family, SOCK_DGRAM, 0);
+      if (m_fd < 0)
+        return;
+      sockaddr_storage addr = {};
+      socklen_t length;
+      if (family == AF_INET) {
+        sockaddr_in * v4 = reinterpret_cast<sockaddr_in *>(&addr);
+        v4->sin_family = AF_INET;
+        v4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        length = sizeof(sockaddr_in);
+      }
+      else {
+        sockaddr_in6 * v6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+        v6->sin6_family = AF_INET6;
+        v6->sin6_addr = in6addr_loopback;
+        length = sizeof(sockaddr_in6);
+      }
+      if (::bind(m_fd, reinterpret_cast<sockaddr *>(&addr), length) < 0 || getsockname(m_fd, reinterpret_cast<sockaddr *>(&addr), &length) < 0) {
+        close(m_fd);
+        m_fd = -1;
+        return;
+      }
+      m_port = ntohs(family == AF_INET ? reinterpret_cast<sockaddr_in *>(&addr)->sin_port : reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port);
+      m_thread = std::thread(&responder::serve, this);
+    }
+
+    ~responder()
+    {
+      m_stop = true;
+      if (m_thread.joinable())
+        m_thread.join();
+      if (m_fd != -1)
+        close(m_fd);
+    }
+
+    bool ok() const { return m_fd != -1; }
+    int requests() const { return m_requests; }
+    std::string server(char const * host) const { return std::string(host) + ":" + std::to_string(m_port); }
+
+  private:
+    void serve()
+    {
+      while (!m_stop) {
+        pollfd fds = { m_fd, POLLIN, 0 };
+        if (poll(&fds, 1, 20) <= 0)
+          continue;
+
+        uint8_t request[max_message_size];
+        sockaddr_storage from;
+        socklen_t from_length = sizeof(from);
+        ssize_t n = recvfrom(m_fd, request, sizeof(request), 0, reinterpret_cast<sockaddr *>(&from), &from_length);
+        message_reader reader;
+        if (n < 0 || !reader.parse(byte_span(request, n)) || reader.type() != message_type::binding_request)
+          continue;
+        if (m_requests++ < m_drop || m_mode == mode::silent)
+          continue;
+
+        transaction_id id;
+        memcpy(id.data(), request + 8, id.size());
+        uint8_t response[max_message_size];
+        message_writer writer(response, sizeof(response));
+        if (m_mode == mode::error) {
+          uint8_t const error[] = { 0, 0, 4, 0, 'B', 'a', 'd' };
+          writer.begin(message_type::binding_error_response, id);
+          writer.add_attribute(attribute_type::error_code, byte_span(error, sizeof(error)));
+        }
+        else {
+          writer.begin(message_type::binding_response, id);
+          writer.add_xor_mapped_address(from);
+        }
+        writer.add_fingerprint();
+        if (m_mode == mode::bad_fingerprint)
+          response[writer.size() - 1] ^= 0x01;
+        sendto(m_fd, response, writer.size(), 0, reinterpret_cast<sockaddr *>(&from), from_length);
+      }
+    }
+
+    mode const m_mode;
+    int const m_drop;
+    std::atomic<int> m_requests;
+    std::atomic<bool> m_stop;
+    int m_fd;
+    uint16_t m_port;
+    std::thread m_thread;
+  };
+
+  long elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  // cancel_after_ms above 0 cancels the binder from another thread
+  bool bind_once(char const * label, std::string const & servers, protocol proto, int timeout_ms, std::string & public_ip, long & took_ms, int cancel_after_ms = 0) {
+    binder request(false);
+    bind_result result;
+    std::thread canceller;
+    if (cancel_after_ms > 0)
+      canceller = std::thread([&request, cancel_after_ms] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(cancel_after_ms));
+        request.cancel();
+      });
+    auto const start = std::chrono::steady_clock::now();
+    bool ok = request.run(parse_servers(servers, 3478), "", proto, std::chrono::milliseconds(timeout_ms), result);
+    took_ms = elapsed_ms(start);
+    if (canceller.joinable())
+      canceller.join();
+    public_ip = result.public_ip;
+    printf("%-32s ok=%d ip=%s %ld ms\n", label, ok, public_ip.c_str(), took_ms);
+    return ok;
+  }
+}
+
+int main() {
+  std::string ip;
+  long took;
+
+  {
+    responder server(AF_INET, mode::answer);
+    check(server.ok(), "single", "no loopback socket");
+    check(bind_once("single", server.server("127.0.0.1"), protocol::af_inet, 5000, ip, took), "single", "no binding");
+    check(ip == "127.0.0.1", "single", "wrong mapped address");
+  }
+
+  {
+    // every server is asked at once, a silent one does not hold the answer of another back
+    responder silent(AF_INET, mode::silent);
+    responder server(AF_INET, mode::answer);
+    check(bind_once("silent and answering", silent.server("127.0.0.1") + "," + server.server("127.0.0.1"), protocol::af_inet, 5000, ip, took), "silent and answering", "no binding");
+    check(took < 400, "silent and answering", "answer waited for the silent server");
+    check(silent.requests() >= 1, "silent and answering", "silent server not asked");
+  }
+
+  {
+    responder server(AF_INET, mode::answer, 2);
+    check(bind_once("retransmission", server.server("127.0.0.1"), protocol::af_inet, 5000, ip, took), "retransmission", "no binding");
+    check(server.requests() == 3, "retransmission", "request not sent again");
+    // 500 ms and 1000 ms RTOs before the third request
+    check(took >= 1400 && took < 2500, "retransmission", "not on the RTO schedule");
+  }
+
+  {
+    responder server(AF_INET, mode::error);
+    check(!bind_once("error response", server.server("127.0.0.1"), protocol::af_inet, 5000, ip, took), "error response", "bound on an error");
+    check(took < 400, "error response", "waited after every server failed");
+  }
+
+  {
+    responder server(AF_INET, mode::bad_fingerprint);
+    check(!bind_once("bad fingerprint", server.server("127.0.0.1"), protocol::af_inet, 1000, ip, took), "bad fingerprint", "response with a bad FINGERPRINT taken");
+    check(took >= 900, "bad fingerprint", "gave up before the timeout");
+  }
+
+  {
+    responder silent(AF_INET, mode::silent);
+    check(!bind_once("timeout", silent.server("127.0.0.1"), protocol::af_inet, 1200, ip, took), "timeout", "bound without an answer");
+    check(took >= 1100 && took < 1600, "timeout", "timeout not kept");
+  }
+
+  {
+    responder silent(AF_INET, mode::silent);
+    check(!bind_once("binder cancel", silent.server("127.0.0.1"), protocol::af_inet, 10000, ip, took, 200), "binder cancel", "bound without an answer");
+    check(took < 600, "binder cancel", "cancel did not stop the binding");
+  }
+
+  {
+    responder server(AF_INET6, mode::answer);
+    if (server.ok()) {
+      check(bind_once("ipv6", server.server("[::1]"), protocol::af_inet6, 5000, ip, took), "ipv6", "no binding");
+      check(ip == "::1", "ipv6", "wrong mapped address");
+    }
+    else
+      printf("%-32s skipped, no ::1\n", "ipv6");
+  }
+
+  {
+    // a GetPublicIP waiting on the bind lock while the manager goes away must not bind after the cancel
+    responder silent(AF_INET, mode::silent);
+    client stun_client;
+    stun_client.set_verbose(false);
+    bind_result first, second;
+    bool first_ok = true, second_ok = true;
+    auto const start = std::chrono::steady_clock::now();
+    std::thread first_bind([&] { first_ok = stun_client.bind(silent.server("127.0.0.1"), 3478, "", protocol::af_inet, 10, 0, first); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread second_bind([&] { second_ok = stun_client.bind(silent.server("127.0.0.1"), 3478, "", protocol::af_inet, 10, 0, second); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int const requests = silent.requests();
+    stun_client.cancel();
+    first_bind.join();
+    second_bind.join();
+    took = elapsed_ms(start);
+    printf("%-32s first=%d second=%d %ld ms\n", "client cancel", first_ok, second_ok, took);
+    check(!first_ok && !second_ok, "client cancel", "bound after the cancel");
+    check(took < 600, "client cancel", "cancel did not stop both binds");
+    check(silent.requests() == requests, "client cancel", "waiting bind sent requests after the cancel");
+
+    bind_result later;
+    auto const later_start = std::chrono::steady_clock::now();
+    check(!stun_client.bind(silent.server("127.0.0.1"), 3478, "", protocol::af_inet, 10, 0, later), "client cancel", "bind after the cancel");
+    check(elapsed_ms(later_start) < 100, "client cancel", "bind after the cancel waited for the servers");
+  }
+
+  printf("%d failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "NetworkManagerStunClient.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+/*
+ * Encode and decode time of a binding response with XOR-MAPPED-ADDRESS and FINGERPRINT, the message every
+ * GetPublicIP waits for. The argument is the number of messages, each is done on the stack without a copy.
+ */
+
+using namespace stun;
+
+namespace {
+  double ns_per_message(std::chrono::steady_clock::time_point start, unsigned long count) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+  }
+}
+
+int main(int argc, char * argv[]) {
+  unsigned long const count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+  if (count == 0)
+    return 1;
+
+  sockaddr_storage addr = {};
+  sockaddr_in * v4 = reinterpret_cast<sockaddr_in *>(&addr);
+  v4->sin_family = AF_INET;
+  v4->sin_port = htons(54321);
+  v4->sin_addr.s_addr = htonl(0xc0000221);
+  transaction_id id = {};
+  uint8_t buffer[max_message_size];
+
+  // the sizes are summed so the loops are not optimized away
+  size_t total = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < count; i++) {
+    id[0] = static_cast<uint8_t>(i);
+    message_writer writer(buffer, sizeof(buffer));
+    writer.begin(message_type::binding_response, id);
+    writer.add_xor_mapped_address(addr);
+    writer.add_fingerprint();
+    total += writer.size();
+  }
+  double const encode = ns_per_message(start, count);
+
+  message_writer writer(buffer, sizeof(buffer));
+  writer.begin(message_type::binding_response, id);
+  writer.add_xor_mapped_address(addr);
+  writer.add_fingerprint();
+  size_t decoded = 0;
+  start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < count; i++) {
+    message_reader reader;
+    sockaddr_storage mapped;
+    if (reader.parse(writer.bytes()) && reader.has_id(id) && reader.mapped_address(mapped))
+      decoded++;
+  }
+  double const decode = ns_per_message(start, count);
+
+  printf("%lu messages of %zu bytes: encode %.0f ns, decode %.0f ns\n", count, total / count, encode, decode);
+  return decoded == count ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#include "NetworkManagerStunClient.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+/*
+ * message_reader gets what the network sends, so it is fed mutated copies of valid messages, each in a
+ * heap block of its exact size so a sanitizer build catches the smallest overread. Built with
+ * STUN_LIBFUZZER the same checks run under libFuzzer instead of the mutation loop in main.
+ */
+
+using namespace stun;
+
+namespace {
+  // every accessor, on whatever parse accepted
+  void exercise(uint8_t const * data, size_t size) {
+    message_reader reader;
+    if (!reader.parse(byte_span(data, size)))
+      return;
+
+    transaction_id id = {};
+    reader.has_id(id);
+    sockaddr_storage addr;
+    reader.mapped_address(addr);
+    uint16_t code;
+    reader.error_code(code);
+    reader.has_unknown_required();
+    byte_span value;
+    reader.find(attribute_type::software, value);
+    reader.find(attribute_type::fingerprint, value);
+  }
+}
+
+#ifdef STUN_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const * data, size_t size) {
+  exercise(data, size);
+  return 0;
+}
+#else
+namespace {
+  int failures = 0;
+
+  void fail(char const * what) {
+    fprintf(stderr, "FAIL: %s\n", what);
+    failures++;
+  }
+
+  sockaddr_storage make_address(int family, char const * ip, uint16_t port) {
+    sockaddr_storage addr = {};
+    if (family == AF_INET) {
+      sockaddr_in * v4 = reinterpret_cast<sockaddr_in *>(&addr);
+      v4->sin_family = AF_INET;
+      v4->sin_port = htons(port);
+      inet_pton(AF_INET, ip, &v4->sin_addr);
+    }
+    else {
+      sockaddr_in6 * v6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+      v6->sin6_family = AF_INET6;
+      v6->sin6_port = htons(port);
+      inet_pton(AF_INET6, ip, &v6->sin6_addr);
+    }
+    return addr;
+  }
+
+  bool same_address(sockaddr_storage const & a, sockaddr_storage const & b) {
+    if (a.ss_family != b.ss_family)
+      return false;
+    if (a.ss_family == AF_INET) {
+      sockaddr_in const * x = reinterpret_cast<sockaddr_in const *>(&a);
+      sockaddr_in const * y = reinterpret_cast<sockaddr_in const *>(&b);
+      return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
+    }
+    sockaddr_in6 const * x = reinterpret_cast<sockaddr_in6 const *>(&a);
+    sockaddr_in6 const * y = reinterpret_cast<sockaddr_in6 const *>(&b);
+    return x->sin6_port == y->sin6_port && memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(x->sin6_addr)) == 0;
+  }
+
+  std::vector<uint8_t> to_vector(message_writer const & writer) {
+    byte_span bytes = writer.bytes();
+    return std::vector<uint8_t>(bytes.data(), bytes.data() + bytes.size());
+  }
+
+  // valid messages of every kind the reader handles, checked to come back as they were written
+  std::vector<std::vector<uint8_t>> make_seeds() {
+    std::vector<std::vector<uint8_t>> seeds;
+    transaction_id id;
+    for (size_t i = 0; i < id.size(); i++)
+      id[i] = static_cast<uint8_t>(i * 7 + 1);
+    uint8_t buffer[max_message_size];
+    uint8_t const software[] = { 'n', 'm' };
+
+    sockaddr_storage const addresses[] = {
+      make_address(AF_INET, "192.0.2.33", 4242),
+      make_address(AF_INET6, "2001:db8::1:2", 4243)
+    };
+    for (sockaddr_storage const & addr : addresses) {
+      message_writer writer(buffer, sizeof(buffer));
+      writer.begin(message_type::binding_response, id);
+      writer.add_attribute(attribute_type::software, byte_span(software, sizeof(software)));
+      writer.add_xor_mapped_address(addr);
+      writer.add_fingerprint();
+
+      message_reader reader;
+      sockaddr_storage mapped;
+      if (!writer.ok() || !reader.parse(writer.bytes()))
+        fail("binding response does not parse");
+      else if (reader.type() != message_type::binding_response || !reader.has_id(id))
+        fail("binding response header changed");
+      else if (!reader.mapped_address(mapped) || !same_address(mapped, addr))
+        fail("XOR-MAPPED-ADDRESS changed");
+      else if (reader.has_unknown_required())
+        fail("binding response has an unknown attribute");
+      seeds.push_back(to_vector(writer));
+    }
+
+    // RFC 3489 server, MAPPED-ADDRESS only
+    {
+      uint8_t const mapped_v4[] = { 0, 1, 0x10, 0x92, 198, 51, 100, 7 };
+      message_writer writer(buffer, sizeof(buffer));
+      writer.begin(message_type::binding_response, id);
+      writer.add_attribute(attribute_type::mapped_address, byte_span(mapped_v4, sizeof(mapped_v4)));
+
+      message_reader reader;
+      sockaddr_storage mapped;
+      if (!reader.parse(writer.bytes()) || !reader.mapped_address(mapped) || !same_address(mapped, make_address(AF_INET, "198.51.100.7", 4242)))
+        fail("MAPPED-ADDRESS changed");
+      seeds.push_back(to_vector(writer));
+    }
+
+    // 420 with the attribute the server did not know, and one this client does not know either
+    {
+      uint8_t const error[] = { 0, 0, 4, 20, 'U', 'n', 'k', 'n', 'o', 'w', 'n' };
+      uint8_t const unknown[] = { 0x00, 0x31 };
+      message_writer writer(buffer, sizeof(buffer));
+      writer.begin(message_type::binding_error_response, id);
+      writer.add_attribute(attribute_type::error_code, byte_span(error, sizeof(error)));
+      writer.add_attribute(attribute_type::unknown_attributes, byte_span(unknown, sizeof(unknown)));
+      writer.add_attribute(0x0031, byte_span(unknown, sizeof(unknown)));
+      writer.add_fingerprint();
+
+      message_reader reader;
+      uint16_t code = 0;
+      if (!reader.parse(writer.bytes()) || !reader.error_code(code) || code != 420)
+        fail("ERROR-CODE changed");
+      else if (!reader.has_unknown_required())
+        fail("unknown comprehension required attribute not seen");
+      seeds.push_back(to_vector(writer));
+    }
+
+    {
+      message_writer writer(buffer, sizeof(buffer));
+      writer.begin(message_type::binding_request, id);
+      writer.add_fingerprint();
+      seeds.push_back(to_vector(writer));
+
+      // a flipped FINGERPRINT bit is a different message, not this one
+      std::vector<uint8_t> corrupted = seeds.back();
+      corrupted.back() ^= 0x01;
+      message_reader reader;
+      if (reader.parse(byte_span(corrupted.data(), corrupted.size())))
+        fail("bad FINGERPRINT accepted");
+    }
+
+    // an attribute that does not fit fails the writer instead of overrunning the buffer
+    {
+      uint8_t small[header_size + 4];
+      message_writer writer(small, sizeof(small));
+      writer.begin(message_type::binding_request, id);
+      writer.add_fingerprint();
+      if (writer.ok() || writer.size() != 0)
+        fail("writer overflow not reported");
+    }
+    return seeds;
+  }
+
+  void mutate(std::mt19937 & rng, std::vector<uint8_t> & message) {
+    int const mutations = 1 + rng() % 4;
+    for (int i = 0; i < mutations && !message.empty(); i++) {
+      switch (rng() % 5) {
+        case 0:
+          message[rng() % message.size()] ^= static_cast<uint8_t>(1 << (rng() % 8));
+          break;
+        case 1:
+          message[rng() % message.size()] = static_cast<uint8_t>(rng());
+          break;
+        case 2:
+          message.resize(rng() % (message.size() + 1));
+          break;
+        case 3:
+          if (message.size() < max_message_size)
+            message.insert(message.begin() + rng() % (message.size() + 1), static_cast<uint8_t>(rng()));
+          break;
+        default:
+          // the length fields are what a parser trusts most
+          if (message.size() >= 4)
+            message[2 + rng() % 2] = static_cast<uint8_t>(rng());
+          break;
+      }
+    }
+  }
+}
+
+int main(int argc, char * argv[]) {
+  unsigned long const iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  unsigned long const seed = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5389;
+
+  std::vector<std::vector<uint8_t>> const seeds = make_seeds();
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+  unsigned long accepted = 0;
+  for (unsigned long i = 0; i < iterations; i++) {
+    std::vector<uint8_t> message = seeds[rng() % seeds.size()];
+    mutate(rng, message);
+
+    std::unique_ptr<uint8_t[]> exact(new uint8_t[message.empty() ? 1 : message.size()]);
+    if (!message.empty())
+      memcpy(exact.get(), message.data(), message.size());
+    message_reader reader;
+    if (reader.parse(byte_span(exact.get(), message.size())))
+      accepted++;
+    exercise(exact.get(), message.size());
+  }
+
+  printf("%lu mutated messages, %lu parsed, seed %lu, %d failures\n", iterations, accepted, seed, failures);
+  return failures == 0 ? 0 : 1;
+}
+#endif
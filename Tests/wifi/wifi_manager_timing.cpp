@@ -0,0 +1,119 @@
+#include "NetworkManagerGnomeWIFI.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <thread>
+#include <vector>
+
+/*
+ * Time per wifiManager request against the NetworkManager running on this host, for the requests the plugin
+ * makes most: getKnownSSIDs and the isWifiScannedRecently check before a connect. A request that does nothing
+ * on the worker gives the cost of the queueing alone, and an NMClient made and dropped per call gives what
+ * every request paid when each made its own client. Arguments: calls per request, threads making them at once.
+ * Without a running NetworkManager it says so and exits 0, a machine with no WiFi device times the failures.
+ */
+
+using namespace WPEFramework::Plugin;
+
+namespace
+{
+    typedef std::function<void()> request;
+
+    double elapsedUs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* each thread makes calls requests one after the other, the latency of every one is kept */
+    void timeRequest(const char* label, const request& call, unsigned long calls, unsigned long threads)
+    {
+        std::vector<std::vector<double>> perThread(threads);
+        std::vector<std::thread> callers;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned long t = 0; t < threads; t++)
+        {
+            callers.emplace_back([&call, &perThread, calls, t] {
+                perThread[t].reserve(calls);
+                for (unsigned long i = 0; i < calls; i++)
+                {
+                    std::chrono::steady_clock::time_point callStart = std::chrono::steady_clock::now();
+                    call();
+                    perThread[t].push_back(elapsedUs(callStart));
+                }
+            });
+        }
+        for (auto& caller : callers)
+            caller.join();
+        const double wall = elapsedUs(start);
+
+        std::vector<double> latencies;
+        for (const auto& latency : perThread)
+            latencies.insert(latencies.end(), latency.begin(), latency.end());
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0;
+        for (double latency : latencies)
+            sum += latency;
+        printf("%-24s %6zu calls: avg %8.1f us, median %8.1f us, p95 %8.1f us, max %8.1f us, %8.0f calls/s\n", label, latencies.size(),
+               sum / latencies.size(), latencies[latencies.size() / 2], latencies[latencies.size() * 95 / 100], latencies.back(),
+               latencies.size() / (wall / 1000000));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const unsigned long calls = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200;
+    const unsigned long threads = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+    if (calls == 0 || threads == 0)
+        return 1;
+
+    /* a log line per request would be timed with it */
+    NetworkManagerLogger::SetLevel(NetworkManagerLogger::WARNING_LEVEL);
+    wifiManager* wifi = wifiManager::getInstance();
+
+    /* the first request makes the client */
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool running = wifi->run("nmRunning", [](const wifiOperationPtr& operation) -> bool {
+        operation->complete(true);
+        return true;
+    }, 5000);
+    const double firstUs = elapsedUs(start);
+    if (!running)
+    {
+        printf("skipped, NetworkManager is not running\n");
+        return 0;
+    }
+    printf("client ready in %.1f ms, %lu calls on each of %lu threads\n", firstUs / 1000, calls, threads);
+
+    timeRequest("worker round trip", [wifi] {
+        wifi->run("nothing", [](const wifiOperationPtr& operation) -> bool {
+            operation->complete(true);
+            return true;
+        });
+    }, calls, threads);
+
+    bool scanned = false;
+    timeRequest("isWifiScannedRecently", [wifi, &scanned] {
+        scanned = wifi->isWifiScannedRecently();
+    }, calls, threads);
+
+    size_t known = 0;
+    timeRequest("getKnownSSIDs", [wifi, &known] {
+        std::list<std::string> ssids;
+        wifi->getKnownSSIDs(ssids);
+        known = ssids.size();
+    }, calls, threads);
+
+    /* what each request paid before, fewer calls as each one loads every NetworkManager object */
+    timeRequest("NMClient per request", [] {
+        GError* error = nullptr;
+        NMClient* client = nm_client_new(nullptr, &error);
+        if (client != nullptr)
+            g_object_unref(client);
+        g_clear_error(&error);
+    }, std::max(calls / 10, 1UL), 1);
+
+    printf("scanned within 10 sec: %s, %zu known SSIDs\n", scanned ? "yes" : "no", known);
+    return 0;
+}
@@ -0,0 +1,310 @@
+#include "WpaCtrlClient.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * WpaCtrlClient against a fake wpa_supplicant: a UNIX datagram socket in a scratch control directory
+ * that answers the commands the signal monitor sends, and can be told to mix unsolicited events and
+ * stale replies into its answers or to go away and come back like a restarted supplicant.
+ */
+
+using namespace WPEFramework::Plugin;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* label, const char* what)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "FAIL: %s: %s\n", label, what);
+            failures++;
+        }
+    }
+
+    bool equals(const char* value, size_t valueLen, const char* expected)
+    {
+        return valueLen == strlen(expected) && memcmp(value, expected, valueLen) == 0;
+    }
+
+    const char* statusReply =
+        "bssid=a0:b5:3c:11:22:33\n"
+        "freq=5180\n"
+        "ssid=home network\n"
+        "id=0\n"
+        "mode=station\n"
+        "key_mgmt=WPA2-PSK\n"
+        "wpa_state=COMPLETED\n"
+        "ip_address=192.168.1.20\n"
+        "address=02:00:00:00:01:00";
+
+    const char* signalPollReply =
+        "RSSI=-57\n"
+        "LINKSPEED=866\n"
+        "NOISE=9999\n"
+        "FREQUENCY=5180\n";
+
+    class FakeSupplicant
+    {
+        public:
+            FakeSupplicant(const std::string& path)
+                : path(path), fd(-1), stopping(false), requests(0), eventBeforeReply(false), staleAfterReply(false), attachedLen(0)
+            {
+                memset(&attachedAddr, 0, sizeof(attachedAddr));
+                fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+                struct sockaddr_un addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+                unlink(path.c_str());
+                if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+                {
+                    perror("fake wpa_supplicant");
+                    exit(2);
+                }
+                serverThread = std::thread(&FakeSupplicant::serve, this);
+            }
+
+            ~FakeSupplicant()
+            {
+                stopping = true;
+                serverThread.join();
+                ::close(fd);
+                unlink(path.c_str());
+            }
+
+            /* to the client that sent ATTACH, like wpa_supplicant's own event messages */
+            void event(const char* text)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (attachedLen > 0)
+                    sendto(fd, text, strlen(text), 0, reinterpret_cast<struct sockaddr*>(&attachedAddr), attachedLen);
+            }
+
+            std::string lastCommand()
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                return last;
+            }
+
+            const std::string path;
+            int fd;
+            std::atomic<bool> stopping;
+            std::atomic<int> requests;
+            /* "<3>CTRL-EVENT-SCAN-STARTED" before each reply, as an attached socket gets it */
+            std::atomic<bool> eventBeforeReply;
+            /* a second reply after each one, as a reply to a timed out request arrives */
+            std::atomic<bool> staleAfterReply;
+
+        private:
+            void serve()
+            {
+                while (!stopping)
+                {
+                    struct pollfd pfd = { fd, POLLIN, 0 };
+                    if (poll(&pfd, 1, 20) <= 0)
+                        continue;
+
+                    char command[256];
+                    struct sockaddr_un from;
+                    socklen_t fromLen = sizeof(from);
+                    ssize_t len = recvfrom(fd, command, sizeof(command) - 1, 0, reinterpret_cast<struct sockaddr*>(&from), &fromLen);
+                    if (len < 0)
+                        continue;
+                    command[len] = '\0';
+                    /* taken as the command comes in, the test changes them once it has the reply */
+                    bool eventFirst = eventBeforeReply;
+                    bool staleAfter = staleAfterReply;
+                    requests++;
+
+                    const char* reply = "UNKNOWN COMMAND\n";
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        last = command;
+                        if (strcmp(command, "ATTACH") == 0)
+                        {
+                            attachedAddr = from;
+                            attachedLen = fromLen;
+                        }
+                    }
+                    if (strcmp(command, "PING") == 0)
+                        reply = "PONG\n";
+                    else if (strcmp(command, "STATUS") == 0)
+                        reply = statusReply;
+                    else if (strcmp(command, "SIGNAL_POLL") == 0)
+                        reply = signalPollReply;
+                    else if (strcmp(command, "ATTACH") == 0 || strcmp(command, "DETACH") == 0 || strncmp(command, "SIGNAL_MONITOR", 14) == 0)
+                        reply = "OK\n";
+
+                    if (eventFirst)
+                    {
+                        const char* event = "<3>CTRL-EVENT-SCAN-STARTED ";
+                        sendto(fd, event, strlen(event), 0, reinterpret_cast<struct sockaddr*>(&from), fromLen);
+                    }
+                    sendto(fd, reply, strlen(reply), 0, reinterpret_cast<struct sockaddr*>(&from), fromLen);
+                    if (staleAfter)
+                    {
+                        const char* stale = "STALE\n";
+                        sendto(fd, stale, strlen(stale), 0, reinterpret_cast<struct sockaddr*>(&from), fromLen);
+                    }
+                }
+            }
+
+            std::thread serverThread;
+            std::mutex lock;
+            std::string last;
+            struct sockaddr_un attachedAddr;
+            socklen_t attachedLen;
+    };
+
+    void testFindValue()
+    {
+        const char* value = nullptr;
+        size_t valueLen = 0;
+
+        check(WpaCtrlClient::findValue(statusReply, strlen(statusReply), "ssid", value, valueLen) && equals(value, valueLen, "home network"), "findValue", "ssid");
+        check(WpaCtrlClient::findValue(statusReply, strlen(statusReply), "bssid", value, valueLen) && equals(value, valueLen, "a0:b5:3c:11:22:33"), "findValue", "bssid");
+        /* last line without a newline */
+        check(WpaCtrlClient::findValue(statusReply, strlen(statusReply), "address", value, valueLen) && equals(value, valueLen, "02:00:00:00:01:00"), "findValue", "last line");
+        /* "id" is a line of its own, not the end of "bssid" or the start of "ip_address" */
+        check(WpaCtrlClient::findValue(statusReply, strlen(statusReply), "id", value, valueLen) && equals(value, valueLen, "0"), "findValue", "id");
+        check(!WpaCtrlClient::findValue(statusReply, strlen(statusReply), "ss", value, valueLen), "findValue", "key prefix matched");
+        check(!WpaCtrlClient::findValue(statusReply, strlen(statusReply), "pairwise_cipher", value, valueLen), "findValue", "missing key found");
+
+        check(WpaCtrlClient::findValue(signalPollReply, strlen(signalPollReply), "RSSI", value, valueLen) && equals(value, valueLen, "-57"), "findValue", "RSSI");
+        check(WpaCtrlClient::findValue(signalPollReply, strlen(signalPollReply), "FREQUENCY", value, valueLen) && equals(value, valueLen, "5180"), "findValue", "FREQUENCY");
+        /* the reply buffer is not searched past the length it is given */
+        check(!WpaCtrlClient::findValue(signalPollReply, 9, "LINKSPEED", value, valueLen), "findValue", "read past the length");
+
+        const char* event = "CTRL-EVENT-SIGNAL-CHANGE above=0 signal=-71 noise=-95 txrate=65000";
+        check(WpaCtrlClient::findEventValue(event, strlen(event), "signal", value, valueLen) && equals(value, valueLen, "-71"), "findEventValue", "signal");
+        check(WpaCtrlClient::findEventValue(event, strlen(event), "txrate", value, valueLen) && equals(value, valueLen, "65000"), "findEventValue", "last parameter");
+        check(!WpaCtrlClient::findEventValue(event, strlen(event), "sig", value, valueLen), "findEventValue", "key prefix matched");
+        check(!WpaCtrlClient::findEventValue(event, strlen(event), "rssi", value, valueLen), "findEventValue", "missing key found");
+    }
+
+    void testRequests(const std::string& ctrlDir)
+    {
+        FakeSupplicant supplicant(ctrlDir + "/wlan0");
+        WpaCtrlClient client(ctrlDir);
+        const char* reply = nullptr;
+        const char* value = nullptr;
+        size_t replyLen = 0, valueLen = 0;
+
+        check(client.request("STATUS", reply, replyLen) && replyLen == strlen(statusReply), "request", "STATUS");
+        check(WpaCtrlClient::findValue(reply, replyLen, "wpa_state", value, valueLen) && equals(value, valueLen, "COMPLETED"), "request", "STATUS wpa_state");
+        check(client.request("SIGNAL_POLL", reply, replyLen) && WpaCtrlClient::findValue(reply, replyLen, "RSSI", value, valueLen) && strtol(value, nullptr, 10) == -57, "request", "SIGNAL_POLL RSSI");
+        check(reply[replyLen] == '\0', "request", "reply not NUL terminated");
+
+        /* an event before the reply is skipped, the reply is what comes back */
+        supplicant.eventBeforeReply = true;
+        check(client.request("PING", reply, replyLen) && strcmp(reply, "PONG\n") == 0, "request", "event taken for the reply");
+        supplicant.eventBeforeReply = false;
+
+        /* a second reply left behind is dropped before the next request is sent */
+        supplicant.staleAfterReply = true;
+        check(client.request("PING", reply, replyLen) && strcmp(reply, "PONG\n") == 0, "request", "PING with a stale reply after it");
+        supplicant.staleAfterReply = false;
+        usleep(50000);
+        check(client.request("STATUS", reply, replyLen) && replyLen == strlen(statusReply), "request", "stale reply taken for the next one");
+        printf("%-32s %d requests\n", "requests", static_cast<int>(supplicant.requests));
+    }
+
+    void testRestart(const std::string& ctrlDir)
+    {
+        WpaCtrlClient client(ctrlDir);
+        const char* reply = nullptr;
+        size_t replyLen = 0;
+        {
+            FakeSupplicant supplicant(ctrlDir + "/wlan0");
+            check(client.request("PING", reply, replyLen) && client.isOpen(), "restart", "first PING");
+        }
+
+        /* the socket the client is connected to is gone, the request fails and leaves the client closed */
+        check(!client.request("PING", reply, replyLen), "restart", "PING with no supplicant");
+        check(!client.isOpen(), "restart", "client left open with no supplicant");
+
+        FakeSupplicant restarted(ctrlDir + "/wlan0");
+        check(client.request("PING", reply, replyLen) && strcmp(reply, "PONG\n") == 0, "restart", "PING after the restart");
+        check(restarted.requests == 1, "restart", "request not sent once to the new socket");
+
+        /* connected to the restarted one, it goes away again while the client is open */
+        {
+            WpaCtrlClient open(ctrlDir);
+            FakeSupplicant* again = new FakeSupplicant(ctrlDir + "/wlan0");
+            check(open.request("PING", reply, replyLen), "restart", "PING before the second restart");
+            delete again;
+            FakeSupplicant back(ctrlDir + "/wlan0");
+            /* the old socket refuses the send, the client reopens and sends again in the same request */
+            check(open.request("STATUS", reply, replyLen) && replyLen == strlen(statusReply), "restart", "request not retried on a new socket");
+            check(back.requests == 1 && back.lastCommand() == "STATUS", "restart", "retry not sent to the restarted supplicant");
+        }
+    }
+
+    void testEvents(const std::string& ctrlDir)
+    {
+        FakeSupplicant supplicant(ctrlDir + "/wlan0");
+        WpaCtrlClient events(ctrlDir);
+        const char* event = nullptr;
+        const char* value = nullptr;
+        size_t eventLen = 0, valueLen = 0;
+
+        check(events.attach() && events.isAttached(), "events", "ATTACH");
+        check(events.waitEvent(100, event, eventLen) == 0, "events", "event without one sent");
+
+        /* a late reply is not an event */
+        supplicant.event("OK\n");
+        supplicant.event("<3>CTRL-EVENT-SIGNAL-CHANGE above=0 signal=-71 noise=-95 txrate=65000");
+        check(events.waitEvent(1000, event, eventLen) == 1, "events", "no signal change event");
+        check(eventLen > 24 && strncmp(event, "CTRL-EVENT-SIGNAL-CHANGE ", 25) == 0, "events", "level prefix left on the event");
+        check(WpaCtrlClient::findEventValue(event, eventLen, "signal", value, valueLen) && strtol(value, nullptr, 10) == -71, "events", "signal");
+        check(WpaCtrlClient::findEventValue(event, eventLen, "above", value, valueLen) && equals(value, valueLen, "0"), "events", "above");
+
+        events.detach();
+        check(!events.isAttached() && supplicant.lastCommand() == "DETACH", "events", "DETACH");
+        events.close();
+        check(events.waitEvent(0, event, eventLen) == -1, "events", "wait on a closed client");
+    }
+
+    void testInterfaceLookup(const std::string& ctrlDir)
+    {
+        WpaCtrlClient client(ctrlDir);
+        const char* reply = nullptr;
+        size_t replyLen = 0;
+        check(!client.request("PING", reply, replyLen), "lookup", "PING with no control socket");
+
+        /* without wlan0 the first control socket in the directory is taken, like wpa_cli does */
+        FakeSupplicant supplicant(ctrlDir + "/wlp2s0");
+        check(client.request("PING", reply, replyLen) && strcmp(reply, "PONG\n") == 0, "lookup", "first socket in the directory");
+    }
+}
+
+int main()
+{
+    char ctrlDir[] = "/tmp/nm_wpa_test_XXXXXX";
+    if (mkdtemp(ctrlDir) == nullptr)
+    {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    testFindValue();
+    testRequests(ctrlDir);
+    testRestart(ctrlDir);
+    testEvents(ctrlDir);
+    testInterfaceLookup(ctrlDir);
+
+    rmdir(ctrlDir);
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,408 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include <linux/icmp.h>
+#include "NetworkManagerLogger.h"
+#include "IcmpPing.h"
+#include "Traceroute.h"
+
+/* what traceroute sent, 52 and 64 byte packets */
+#define TRACEROUTE_PAYLOAD_SIZE_V4      24
+#define TRACEROUTE_PAYLOAD_SIZE_V6      16
+#define UDP_HEADER_SIZE                 8
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        Traceroute::Traceroute(int family)
+            : family(family)
+            , udpFd(-1)
+            , icmpFd(-1)
+            , cancelled(false)
+            , percent(0)
+        {
+            memset(&local, 0, sizeof(local));
+            memset(&target, 0, sizeof(target));
+        }
+
+        Traceroute::~Traceroute()
+        {
+            close();
+        }
+
+        bool Traceroute::open(const sockaddr_storage& address, socklen_t addressLen)
+        {
+            target = address;
+            if (family == AF_INET6)
+                reinterpret_cast<sockaddr_in6*>(&target)->sin6_port = htons(TRACEROUTE_PORT);
+            else
+                reinterpret_cast<sockaddr_in*>(&target)->sin_port = htons(TRACEROUTE_PORT);
+
+            if (family == AF_INET6)
+                icmpFd = socket(AF_INET6, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMPV6);
+            else
+                icmpFd = socket(AF_INET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+            if (icmpFd < 0)
+            {
+                NMLOG_ERROR("ICMP socket failed: %s", strerror(errno));
+                return false;
+            }
+
+            /* only what a probe can bring back */
+            if (family == AF_INET6)
+            {
+                struct icmp6_filter filter;
+                ICMP6_FILTER_SETBLOCKALL(&filter);
+                ICMP6_FILTER_SETPASS(ICMP6_TIME_EXCEEDED, &filter);
+                ICMP6_FILTER_SETPASS(ICMP6_DST_UNREACH, &filter);
+                setsockopt(icmpFd, IPPROTO_ICMPV6, ICMP6_FILTER, &filter, sizeof(filter));
+            }
+            else
+            {
+                struct icmp_filter filter;
+                filter.data = ~((1U << ICMP_TIME_EXCEEDED) | (1U << ICMP_DEST_UNREACH));
+                setsockopt(icmpFd, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+            }
+
+            udpFd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+            if (udpFd < 0)
+            {
+                NMLOG_ERROR("UDP socket failed: %s", strerror(errno));
+                return false;
+            }
+
+            /* connected for the source the checksum covers; disconnecting would give up the port as well */
+            socklen_t localLen = sizeof(local);
+            if (connect(udpFd, reinterpret_cast<const sockaddr*>(&target), addressLen) != 0
+                || getsockname(udpFd, reinterpret_cast<sockaddr*>(&local), &localLen) != 0)
+            {
+                NMLOG_ERROR("no route to %s: %s", IcmpPing::addressToString(target).c_str(), strerror(errno));
+                return false;
+            }
+            return true;
+        }
+
+        void Traceroute::close()
+        {
+            if (udpFd >= 0)
+            {
+                ::close(udpFd);
+                udpFd = -1;
+            }
+            if (icmpFd >= 0)
+            {
+                ::close(icmpFd);
+                icmpFd = -1;
+            }
+        }
+
+        uint16_t Traceroute::udpChecksum(const uint8_t* payload, size_t payloadLen) const
+        {
+            /* pseudo header, UDP header with a zero checksum, payload */
+            uint8_t data[40 + UDP_HEADER_SIZE + TRACEROUTE_PAYLOAD_SIZE_V4];
+            size_t length = 0;
+            const uint16_t udpLen = static_cast<uint16_t>(UDP_HEADER_SIZE + payloadLen);
+            uint16_t srcPort, dstPort;
+            if (family == AF_INET6)
+            {
+                const sockaddr_in6* src = reinterpret_cast<const sockaddr_in6*>(&local);
+                const sockaddr_in6* dst = reinterpret_cast<const sockaddr_in6*>(&target);
+                memcpy(data, &src->sin6_addr, 16);
+                memcpy(data + 16, &dst->sin6_addr, 16);
+                data[32] = 0; data[33] = 0; data[34] = udpLen >> 8; data[35] = udpLen & 0xFF;
+                data[36] = 0; data[37] = 0; data[38] = 0; data[39] = IPPROTO_UDP;
+                length = 40;
+                srcPort = src->sin6_port;
+                dstPort = dst->sin6_port;
+            }
+            else
+            {
+                const sockaddr_in* src = reinterpret_cast<const sockaddr_in*>(&local);
+                const sockaddr_in* dst = reinterpret_cast<const sockaddr_in*>(&target);
+                memcpy(data, &src->sin_addr, 4);
+                memcpy(data + 4, &dst->sin_addr, 4);
+                data[8] = 0; data[9] = IPPROTO_UDP; data[10] = udpLen >> 8; data[11] = udpLen & 0xFF;
+                length = 12;
+                srcPort = src->sin_port;
+                dstPort = dst->sin_port;
+            }
+            memcpy(data + length, &srcPort, 2);
+            memcpy(data + length + 2, &dstPort, 2);
+            data[length + 4] = udpLen >> 8;
+            data[length + 5] = udpLen & 0xFF;
+            data[length + 6] = 0;
+            data[length + 7] = 0;
+            length += UDP_HEADER_SIZE;
+            memcpy(data + length, payload, payloadLen);
+            length += payloadLen;
+
+            uint16_t sum = IcmpPing::checksum(data, length);
+            /* a sum of zero goes out as all ones, zero means none */
+            return (sum == 0) ? 0xFFFF : sum;
+        }
+
+        int Traceroute::receive(const std::vector<Probe>& probes, std::string& from, bool& fromTarget)
+        {
+            uint8_t packet[1500];
+            sockaddr_storage sender;
+            socklen_t senderLen = sizeof(sender);
+            ssize_t length = recvfrom(icmpFd, packet, sizeof(packet), 0, reinterpret_cast<sockaddr*>(&sender), &senderLen);
+            if (length < 0)
+                return -2;
+
+            const uint8_t* icmp = packet;
+            size_t icmpLen = static_cast<size_t>(length);
+            const uint8_t* udp = nullptr;
+            size_t udpLen = 0;
+            if (family == AF_INET)
+            {
+                /* IP header, ICMP header, the probe's IP header and at least its UDP header */
+                size_t headerLen = static_cast<size_t>(packet[0] & 0x0F) * 4;
+                if (headerLen < 20 || icmpLen < headerLen + 8 + 20)
+                    return -1;
+                icmp += headerLen;
+                icmpLen -= headerLen;
+                if (icmp[0] != ICMP_TIME_EXCEEDED && icmp[0] != ICMP_DEST_UNREACH)
+                    return -1;
+                const uint8_t* inner = icmp + 8;
+                size_t innerLen = static_cast<size_t>(inner[0] & 0x0F) * 4;
+                if (innerLen < 20 || icmpLen < 8 + innerLen + UDP_HEADER_SIZE || inner[9] != IPPROTO_UDP
+                    || memcmp(inner + 16, &reinterpret_cast<const sockaddr_in*>(&target)->sin_addr, 4) != 0)
+                    return -1;
+                udp = inner + innerLen;
+                udpLen = icmpLen - 8 - innerLen;
+                fromTarget = (reinterpret_cast<sockaddr_in*>(&sender)->sin_addr.s_addr == reinterpret_cast<const sockaddr_in*>(&target)->sin_addr.s_addr);
+            }
+            else
+            {
+                /* no extension headers in what we sent, the UDP header follows the IPv6 one */
+                if (icmpLen < 8 + 40 + UDP_HEADER_SIZE)
+                    return -1;
+                if (icmp[0] != ICMP6_TIME_EXCEEDED && icmp[0] != ICMP6_DST_UNREACH)
+                    return -1;
+                const uint8_t* inner = icmp + 8;
+                if (inner[6] != IPPROTO_UDP || memcmp(inner + 24, &reinterpret_cast<const sockaddr_in6*>(&target)->sin6_addr, 16) != 0)
+                    return -1;
+                udp = inner + 40;
+                udpLen = icmpLen - 8 - 40;
+                fromTarget = (memcmp(&reinterpret_cast<sockaddr_in6*>(&sender)->sin6_addr, &reinterpret_cast<const sockaddr_in6*>(&target)->sin6_addr, 16) == 0);
+            }
+
+            uint16_t localPort = (family == AF_INET6) ? reinterpret_cast<const sockaddr_in6*>(&local)->sin6_port : reinterpret_cast<const sockaddr_in*>(&local)->sin_port;
+            if (memcmp(udp, &localPort, 2) != 0 || ((udp[2] << 8) | udp[3]) != TRACEROUTE_PORT)
+                return -1;
+
+            int index = -1;
+            if (udpLen >= UDP_HEADER_SIZE + 2)
+            {
+                /* the whole probe came back, its payload says which; locally sent packets may quote an unfinished checksum */
+                index = ((udp[8] << 8) | udp[9]) - 1;
+            }
+            else
+            {
+                /* routers may quote only 8 bytes of UDP, the checksum then is all there is */
+                uint16_t checksum = static_cast<uint16_t>((udp[6] << 8) | udp[7]);
+                for (size_t i = 0; i < probes.size(); i++)
+                {
+                    if (probes[i].checksum == checksum)
+                    {
+                        index = static_cast<int>(i);
+                        break;
+                    }
+                }
+            }
+            if (index < 0 || static_cast<size_t>(index) >= probes.size())
+                return -1;
+            from = IcmpPing::addressToString(sender);
+            return index;
+        }
+
+        bool Traceroute::run(const std::string& endpoint, uint32_t queries, TracerouteResult& result, uint32_t maxHops, uint32_t waitMs)
+        {
+            result = TracerouteResult();
+            queries = (queries == 0) ? 1 : (queries > TRACEROUTE_MAX_QUERIES) ? TRACEROUTE_MAX_QUERIES : queries;
+            maxHops = (maxHops == 0) ? 1 : (maxHops > 64) ? 64 : maxHops;
+
+            sockaddr_storage address;
+            socklen_t addressLen = 0;
+            if (!IcmpPing::resolve(endpoint, family, address, addressLen))
+            {
+                result.error = "Bad Address";
+                return false;
+            }
+            result.target = IcmpPing::addressToString(address);
+            if (!open(address, addressLen))
+            {
+                result.error = "Could not open trace sockets";
+                close();
+                return false;
+            }
+
+            const size_t payloadLen = (family == AF_INET6) ? TRACEROUTE_PAYLOAD_SIZE_V6 : TRACEROUTE_PAYLOAD_SIZE_V4;
+            std::vector<Probe> probes(maxHops * queries);
+            for (uint32_t ttl = 1; ttl <= maxHops; ttl++)
+            {
+                int hops = static_cast<int>(ttl);
+                if (family == AF_INET6)
+                    setsockopt(udpFd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &hops, sizeof(hops));
+                else
+                    setsockopt(udpFd, IPPROTO_IP, IP_TTL, &hops, sizeof(hops));
+
+                for (uint32_t query = 0; query < queries; query++)
+                {
+                    const size_t index = (ttl - 1) * queries + query;
+                    uint8_t payload[TRACEROUTE_PAYLOAD_SIZE_V4];
+                    for (size_t i = 0; i < payloadLen; i++)
+                        payload[i] = static_cast<uint8_t>(0x40 + i);
+                    payload[0] = static_cast<uint8_t>((index + 1) >> 8);
+                    payload[1] = static_cast<uint8_t>((index + 1) & 0xFF);
+
+                    Probe& probe = probes[index];
+                    probe.ttl = ttl;
+                    probe.checksum = udpChecksum(payload, payloadLen);
+                    probe.rtt = -1;
+                    probe.fromTarget = false;
+                    probe.sentAt = IcmpPing::nowUs();
+                    ssize_t sent = send(udpFd, payload, payloadLen, 0);
+                    /* a connected socket reports the target's port unreachable to an earlier probe on this send */
+                    if (sent < 0 && errno == ECONNREFUSED)
+                        sent = send(udpFd, payload, payloadLen, 0);
+                    if (sent < 0)
+                        NMLOG_WARNING("trace probe ttl %u not sent: %s", ttl, strerror(errno));
+                }
+            }
+
+            const uint64_t started = IcmpPing::nowUs();
+            const uint64_t deadline = started + static_cast<uint64_t>(waitMs) * 1000;
+            uint32_t lastHop = maxHops;
+            while (true)
+            {
+                if (cancelled)
+                {
+                    result.error = "Cancelled";
+                    break;
+                }
+
+                /* done once every probe up to the target's hop is answered */
+                uint32_t expected = 0, answered = 0;
+                for (const Probe& probe : probes)
+                {
+                    if (probe.ttl > lastHop)
+                        continue;
+                    expected++;
+                    answered += (probe.rtt >= 0) ? 1 : 0;
+                }
+                uint64_t now = IcmpPing::nowUs();
+                if (answered == expected || now >= deadline)
+                    break;
+                /* silent hops never answer, the time waited is progress too */
+                uint32_t answeredPercent = answered * 100 / expected;
+                uint32_t waitedPercent = static_cast<uint32_t>((now - started) * 100 / (deadline - started));
+                percent = (answeredPercent > waitedPercent) ? answeredPercent : waitedPercent;
+
+                int waitMsLeft = static_cast<int>((deadline - now + 999) / 1000);
+                struct pollfd pfd = { icmpFd, POLLIN, 0 };
+                if (poll(&pfd, 1, (waitMsLeft > ICMP_CANCEL_CHECK_MS) ? ICMP_CANCEL_CHECK_MS : waitMsLeft) <= 0 || !(pfd.revents & POLLIN))
+                    continue;
+
+                std::string from;
+                bool fromTarget = false;
+                int index;
+                while ((index = receive(probes, from, fromTarget)) != -2)
+                {
+                    if (index < 0 || probes[index].rtt >= 0)
+                        continue;
+                    Probe& probe = probes[index];
+                    probe.rtt = (IcmpPing::nowUs() - probe.sentAt) / 1000.0;
+                    probe.from = from;
+                    probe.fromTarget = fromTarget;
+                    if (fromTarget && probe.ttl < lastHop)
+                        lastHop = probe.ttl;
+                }
+            }
+            close();
+            percent = 100;
+
+            uint32_t answered = 0;
+            for (uint32_t ttl = 1; ttl <= lastHop; ttl++)
+            {
+                TracerouteHop hop;
+                hop.ttl = ttl;
+                uint32_t replies = 0;
+                for (uint32_t query = 0; query < queries; query++)
+                {
+                    const Probe& probe = probes[(ttl - 1) * queries + query];
+                    hop.rtts.push_back(probe.rtt);
+                    if (probe.rtt < 0)
+                        continue;
+                    replies++;
+                    if (hop.address.empty())
+                        hop.address = probe.from;
+                    if (probe.fromTarget)
+                        result.reached = true;
+                }
+                hop.loss = 100.0 * (queries - replies) / queries;
+                answered += replies;
+                result.hops.push_back(hop);
+            }
+
+            NMLOG_INFO("trace %s (%s): %zu hops, %s", endpoint.c_str(), result.target.c_str(), result.hops.size(), result.reached ? "reached" : "not reached");
+            if (answered == 0)
+            {
+                if (result.error.empty())
+                    result.error = "Could not trace endpoint";
+                return false;
+            }
+            return result.error.empty();
+        }
+
+        std::vector<std::string> Traceroute::toLines(const TracerouteResult& result)
+        {
+            std::vector<std::string> lines;
+            char text[64];
+            for (const TracerouteHop& hop : result.hops)
+            {
+                snprintf(text, sizeof(text), "%2u  ", hop.ttl);
+                std::string line(text);
+                line += hop.address;
+                for (double rtt : hop.rtts)
+                {
+                    if (rtt < 0)
+                        line += hop.address.empty() ? "* " : "  *";
+                    else
+                    {
+                        snprintf(text, sizeof(text), "  %.3f ms", rtt);
+                        line += text;
+                    }
+                }
+                lines.push_back(line);
+            }
+            return lines;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+#define TRACEROUTE_PORT                 33434
+#define TRACEROUTE_MAX_HOPS             6       // what Trace always ran traceroute with, -m 6
+#define TRACEROUTE_WAIT_MS              3000    // -w 3
+#define TRACEROUTE_MAX_QUERIES          10
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        struct TracerouteHop {
+            uint32_t ttl = 0;
+            std::string address;                /* first router that answered, empty when none did */
+            std::vector<double> rtts;           /* ms, one per query, negative when it got no answer */
+            double loss = 100;                  /* percent */
+        };
+
+        struct TracerouteResult {
+            std::string target;
+            bool reached = false;
+            std::vector<TracerouteHop> hops;    /* up to the target when it answered, TRACEROUTE_MAX_HOPS otherwise */
+            std::string error;
+        };
+
+        /*
+         * UDP traceroute in process. Every probe of every TTL goes out at once from one UDP socket to one
+         * destination port, so the flow, and the path a per flow load balancer picks, is the same for all of
+         * them (the Paris traceroute idea). Probes differ only in their payload and so in their UDP checksum,
+         * which the time exceeded and port unreachable messages quote back; a raw ICMP socket collects those
+         * and the checksum tells which probe each answers. A trace takes about one RTT to the farthest hop
+         * that answers, and at most the wait. Needs CAP_NET_RAW for the ICMP socket.
+         */
+        class Traceroute
+        {
+            public:
+                /* AF_INET or AF_INET6 */
+                explicit Traceroute(int family);
+                ~Traceroute();
+                /* false when no hop answered at all or it was cancelled, result.error says why */
+                bool run(const std::string& endpoint, uint32_t queries, TracerouteResult& result,
+                         uint32_t maxHops = TRACEROUTE_MAX_HOPS, uint32_t waitMs = TRACEROUTE_WAIT_MS);
+                /* from any thread; the run, or the next one, stops with the hops it has */
+                void cancel() { cancelled = true; }
+                /* from any thread; percent of the probes answered, or of the wait when that is further */
+                uint32_t progress() const { return percent; }
+                /* result as traceroute prints it, one line per hop */
+                static std::vector<std::string> toLines(const TracerouteResult& result);
+
+            private:
+                struct Probe {
+                    uint32_t ttl;
+                    uint16_t checksum;
+                    uint64_t sentAt;
+                    double rtt;
+                    std::string from;
+                    bool fromTarget;
+                };
+
+                Traceroute(const Traceroute&) = delete;
+                Traceroute& operator=(const Traceroute&) = delete;
+
+                bool open(const sockaddr_storage& target, socklen_t targetLen);
+                void close();
+                uint16_t udpChecksum(const uint8_t* payload, size_t payloadLen) const;
+                /* index of the probe an ICMP message answers, -1 for anything else, -2 when nothing is left to read */
+                int receive(const std::vector<Probe>& probes, std::string& from, bool& fromTarget);
+
+                const int family;
+                int udpFd;
+                int icmpFd;
+                sockaddr_storage local;
+                sockaddr_storage target;
+                std::atomic<bool> cancelled;
+                std::atomic<uint32_t> percent;
+        };
+    }
+}
@@ -0,0 +1,193 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "NetworkManagerLogger.h"
+#include "WiFiScanCache.h"
+
+#define NM_WIFI_SCAN_CACHE_MAGIC            0x4E4D5743      // "NMWC"
+#define NM_WIFI_SCAN_CACHE_VERSION          3
+#define NM_WIFI_SCAN_CACHE_BOOT_ID_PATH     "/proc/sys/kernel/random/boot_id"
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        WiFiScanCache::WiFiScanCache(const std::string& path)
+            : path(path)
+            , file(nullptr)
+        {
+        }
+
+        WiFiScanCache::~WiFiScanCache()
+        {
+            close();
+        }
+
+        int32_t WiFiScanCache::now()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_BOOTTIME, &ts);
+            return static_cast<int32_t>(ts.tv_sec);
+        }
+
+        /* left all zero when it cannot be read, the last scan time check is then all there is */
+        static void readBootId(char* bootId, size_t size)
+        {
+            memset(bootId, 0, size);
+            int fd = ::open(NM_WIFI_SCAN_CACHE_BOOT_ID_PATH, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+            ssize_t length = read(fd, bootId, size);
+            ::close(fd);
+            if (length != static_cast<ssize_t>(size))
+                memset(bootId, 0, size);
+        }
+
+        void WiFiScanCache::reset(const char* bootId)
+        {
+            memset(file, 0, sizeof(File));
+            file->header.magic = NM_WIFI_SCAN_CACHE_MAGIC;
+            file->header.version = NM_WIFI_SCAN_CACHE_VERSION;
+            file->header.capacity = NM_WIFI_SCAN_CACHE_ENTRIES;
+            file->header.lastScan = -1;
+            memcpy(file->header.bootId, bootId, sizeof(file->header.bootId));
+        }
+
+        bool WiFiScanCache::open()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (file != nullptr)
+                return true;
+
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            if (fd < 0)
+            {
+                NMLOG_ERROR("wifi scan cache %s open failed: %s", path.c_str(), strerror(errno));
+                return false;
+            }
+
+            struct stat st;
+            bool sized = (fstat(fd, &st) == 0 && st.st_size == static_cast<off_t>(sizeof(File)));
+            if (!sized && ftruncate(fd, sizeof(File)) != 0)
+            {
+                NMLOG_ERROR("wifi scan cache %s resize failed: %s", path.c_str(), strerror(errno));
+                ::close(fd);
+                return false;
+            }
+
+            void* mapped = mmap(nullptr, sizeof(File), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED)
+            {
+                NMLOG_ERROR("wifi scan cache %s mmap failed: %s", path.c_str(), strerror(errno));
+                return false;
+            }
+            file = static_cast<File*>(mapped);
+
+            const Header& header = file->header;
+            char bootId[sizeof(Header::bootId)];
+            readBootId(bootId, sizeof(bootId));
+            /* times of another boot mean nothing now, /tmp on disk keeps the file across a reboot */
+            if (!sized || header.magic != NM_WIFI_SCAN_CACHE_MAGIC || header.version != NM_WIFI_SCAN_CACHE_VERSION
+                || header.capacity != NM_WIFI_SCAN_CACHE_ENTRIES || header.count > NM_WIFI_SCAN_CACHE_ENTRIES
+                || memcmp(header.bootId, bootId, sizeof(bootId)) != 0 || header.lastScan > now())
+            {
+                NMLOG_INFO("wifi scan cache %s starts empty", path.c_str());
+                reset(bootId);
+            }
+            else
+                NMLOG_INFO("wifi scan cache %s has %u access points, last scan %d sec ago", path.c_str(), header.count, now() - header.lastScan);
+            return true;
+        }
+
+        void WiFiScanCache::close()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (file != nullptr)
+            {
+                munmap(file, sizeof(File));
+                file = nullptr;
+            }
+        }
+
+        void WiFiScanCache::update(const std::vector<AccessPoint>& accessPoints)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (file == nullptr)
+                return;
+
+            int32_t scanTime = now();
+            Header& header = file->header;
+            for (const auto& accessPoint : accessPoints)
+            {
+                if (accessPoint.m_ssid.size() > sizeof(Record::ssid))
+                    continue;
+
+                const uint64_t key = WiFiScanResults::keyOf(accessPoint);
+                Record* record = nullptr;
+                Record* oldest = nullptr;
+                for (uint32_t i = 0; i < header.count; i++)
+                {
+                    if (file->records[i].key == key)
+                    {
+                        record = &file->records[i];
+                        break;
+                    }
+                    if (oldest == nullptr || file->records[i].lastSeen < oldest->lastSeen)
+                        oldest = &file->records[i];
+                }
+                if (record == nullptr)
+                    record = (header.count < NM_WIFI_SCAN_CACHE_ENTRIES) ? &file->records[header.count++] : oldest;
+
+                record->key = key;
+                record->frequency = accessPoint.m_frequency;
+                record->securityFlags = accessPoint.m_securityFlags;
+                record->lastSeen = (accessPoint.m_lastSeen >= 0 && accessPoint.m_lastSeen <= scanTime) ? accessPoint.m_lastSeen : scanTime;
+                record->rssi = accessPoint.m_rssi;
+                record->securityMode = static_cast<uint8_t>(accessPoint.m_securityMode);
+                record->ssidLength = static_cast<uint8_t>(accessPoint.m_ssid.size());
+                memcpy(record->ssid, accessPoint.m_ssid.data(), accessPoint.m_ssid.size());
+            }
+            header.lastScan = scanTime;
+        }
+
+        int32_t WiFiScanCache::age(const std::string& ssid) const
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (file == nullptr || ssid.empty() || ssid.size() > sizeof(Record::ssid))
+                return -1;
+
+            int32_t lastSeen = -1;
+            for (uint32_t i = 0; i < file->header.count; i++)
+            {
+                const Record& record = file->records[i];
+                if (record.ssidLength == ssid.size() && memcmp(record.ssid, ssid.data(), ssid.size()) == 0 && record.lastSeen > lastSeen)
+                    lastSeen = record.lastSeen;
+            }
+            return (lastSeen < 0) ? -1 : now() - lastSeen;
+        }
+    }
+}
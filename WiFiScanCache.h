@@ -0,0 +1,93 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "WiFiScanResults.h"
+
+#define NM_WIFI_SCAN_CACHE_PATH             "/tmp/nm.plugin.wifiscan"
+#define NM_WIFI_SCAN_CACHE_ENTRIES          128
+#define NM_WIFI_SCAN_CACHE_FRESH_SEC        30      // an SSID seen within this long is connected to without scanning first
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        /*
+         * Every access point seen by a scan, with the time it was last seen, in a memory mapped file so it
+         * outlives the plugin process. Times are CLOCK_BOOTTIME seconds, like the libnm last seen time, so
+         * the file carries the boot ID they belong to and a file from another boot starts empty. A record is keyed like
+         * the scan table, by BSSID or by SSID and band for the IARM records that have none, and when the table is
+         * full the one seen longest ago makes room. Open failures leave the cache empty and every
+         * lookup misses, callers then scan as they would without it.
+         */
+        class WiFiScanCache
+        {
+            public:
+                typedef WiFiScanResults::AccessPoint AccessPoint;
+
+                explicit WiFiScanCache(const std::string& path = NM_WIFI_SCAN_CACHE_PATH);
+                ~WiFiScanCache();
+                /* maps the file, a missing, foreign or older boot's file starts the cache empty */
+                bool open();
+                void close();
+                void update(const std::vector<AccessPoint>& accessPoints);
+                /* seconds since an AP with this SSID was last seen, -1 when it never was */
+                int32_t age(const std::string& ssid) const;
+                static int32_t now();
+
+            private:
+                struct Record {
+                    uint64_t key;                   /* WiFiScanResults::keyOf */
+                    uint32_t frequency;
+                    uint32_t securityFlags;
+                    int32_t lastSeen;
+                    int16_t rssi;
+                    uint8_t securityMode;
+                    uint8_t ssidLength;
+                    uint8_t ssid[32];
+                };
+
+                struct Header {
+                    uint32_t magic;
+                    uint16_t version;
+                    uint16_t capacity;
+                    uint32_t count;
+                    int32_t lastScan;
+                    char bootId[36];            /* /proc/sys/kernel/random/boot_id of the boot the times belong to */
+                };
+
+                struct File {
+                    Header header;
+                    Record records[NM_WIFI_SCAN_CACHE_ENTRIES];
+                };
+
+                WiFiScanCache(const WiFiScanCache&) = delete;
+                WiFiScanCache& operator=(const WiFiScanCache&) = delete;
+                void reset(const char* bootId);
+
+                const std::string path;
+                File* file;
+                mutable std::mutex lock;
+        };
+    }
+}
@@ -0,0 +1,354 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include "NetworkManagerLogger.h"
+#include "WiFiScanResults.h"
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        typedef Exchange::INetworkManager INM;
+
+        static void appendJsonString(std::string& json, const std::string& value);
+
+        WiFiScanResults::WiFiScanResults(std::vector<AccessPoint>&& accessPoints)
+            : records(std::move(accessPoints))
+            , fromText(false)
+            , parsed(true)
+        {
+            std::call_once(recordsOnce, [] {});
+        }
+
+        WiFiScanResults::WiFiScanResults(std::string&& json)
+            : text(std::move(json))
+            , fromText(true)
+            , parsed(false)
+        {
+        }
+
+        const std::vector<WiFiScanResults::AccessPoint>& WiFiScanResults::accessPoints() const
+        {
+            std::call_once(recordsOnce, [this] {
+                parsed = parseJson(text, records);
+                if (!parsed)
+                    NMLOG_ERROR("scan result JSON does not parse, no access points");
+            });
+            return records;
+        }
+
+        const std::string& WiFiScanResults::json() const
+        {
+            std::call_once(jsonOnce, [this] {
+                if (fromText)
+                {
+                    /* checked once, by the parse the records come from; the text is embedded unquoted in the event */
+                    accessPoints();
+                    if (!parsed)
+                    {
+                        std::string unparsed;
+                        unparsed.swap(text);
+                        if (unparsed.empty())
+                            text = "[]";
+                        else
+                            appendJsonString(text, unparsed);
+                    }
+                    return;
+                }
+                text.reserve(records.size() * 96 + 2);
+                text += '[';
+                for (const auto& accessPoint : records)
+                {
+                    if (text.size() > 1)
+                        text += ',';
+                    appendJson(text, accessPoint);
+                }
+                text += ']';
+            });
+            return text;
+        }
+
+        std::string WiFiScanResults::frequencyBand(uint32_t frequencyMHz)
+        {
+            if (frequencyMHz >= 2400 && frequencyMHz < 5000)
+                return "2.4";
+            else if (frequencyMHz >= 5000 && frequencyMHz < 6000)
+                return "5";
+            else if (frequencyMHz >= 6000)
+                return "6";
+            return "Not available";
+        }
+
+        uint64_t WiFiScanResults::bssidFromString(const char* bssid)
+        {
+            unsigned int octets[6];
+            if (bssid == nullptr || sscanf(bssid, "%2x:%2x:%2x:%2x:%2x:%2x", &octets[0], &octets[1], &octets[2], &octets[3], &octets[4], &octets[5]) != 6)
+                return 0;
+            uint64_t packed = 0;
+            for (int i = 0; i < 6; i++)
+                packed = (packed << 8) | octets[i];
+            return packed;
+        }
+
+        std::string WiFiScanResults::bssidToString(uint64_t bssid)
+        {
+            if (bssid == 0)
+                return std::string();
+            char text[18];
+            snprintf(text, sizeof(text), "%02X:%02X:%02X:%02X:%02X:%02X",
+                     static_cast<unsigned int>((bssid >> 40) & 0xFF), static_cast<unsigned int>((bssid >> 32) & 0xFF),
+                     static_cast<unsigned int>((bssid >> 24) & 0xFF), static_cast<unsigned int>((bssid >> 16) & 0xFF),
+                     static_cast<unsigned int>((bssid >> 8) & 0xFF), static_cast<unsigned int>(bssid & 0xFF));
+            return std::string(text);
+        }
+
+        /* valid UTF-8 sequence length at c, 0 when it is not one */
+        static size_t utf8SequenceLength(const unsigned char* c, const unsigned char* end)
+        {
+            size_t length = (*c < 0x80) ? 1 : ((*c & 0xE0) == 0xC0) ? 2 : ((*c & 0xF0) == 0xE0) ? 3 : ((*c & 0xF8) == 0xF0) ? 4 : 0;
+            if (length == 0 || static_cast<size_t>(end - c) < length)
+                return 0;
+            for (size_t i = 1; i < length; i++)
+            {
+                if ((c[i] & 0xC0) != 0x80)
+                    return 0;
+            }
+            return length;
+        }
+
+        static void appendJsonString(std::string& json, const std::string& value)
+        {
+            json += '"';
+            const unsigned char* c = reinterpret_cast<const unsigned char*>(value.data());
+            const unsigned char* end = c + value.size();
+            while (c < end)
+            {
+                size_t length = utf8SequenceLength(c, end);
+                if (length == 0)
+                {
+                    /* SSIDs are octets; a byte that is not UTF-8 is taken as Latin-1 */
+                    json += static_cast<char>(0xC0 | (*c >> 6));
+                    json += static_cast<char>(0x80 | (*c & 0x3F));
+                    c++;
+                }
+                else if (*c == '"' || *c == '\\')
+                {
+                    json += '\\';
+                    json += static_cast<char>(*c++);
+                }
+                else if (*c < 0x20)
+                {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", *c++);
+                    json += escaped;
+                }
+                else
+                {
+                    json.append(reinterpret_cast<const char*>(c), length);
+                    c += length;
+                }
+            }
+            json += '"';
+        }
+
+        void WiFiScanResults::appendJson(std::string& json, const AccessPoint& accessPoint, bool withBssid)
+        {
+            json += "{\"ssid\":";
+            appendJsonString(json, accessPoint.m_ssid.empty() ? std::string("---") : accessPoint.m_ssid); // hidden ssid TODO modify
+            if (withBssid)
+            {
+                json += ",\"bssid\":";
+                appendJsonString(json, bssidToString(accessPoint.m_bssid));
+            }
+            json += ",\"security\":";
+            json += std::to_string(static_cast<int>(accessPoint.m_securityMode));
+            json += ",\"signalStrength\":";
+            json += std::to_string(static_cast<int>(accessPoint.m_strength));
+            if (withBssid)
+            {
+                /* signalStrength is the 0 - 100 quality libnm reports, the IARM event has dBm, so the records carry both */
+                json += ",\"rssi\":";
+                json += std::to_string(static_cast<int>(accessPoint.m_rssi));
+            }
+            json += ",\"frequency\":";
+            appendJsonString(json, frequencyBand(accessPoint.m_frequency));
+            json += '}';
+        }
+
+        static uint32_t securityFlagsFromMode(INM::WIFISecurityMode mode)
+        {
+            switch (mode)
+            {
+                case INM::WIFI_SECURITY_NONE:
+                    return 0;
+                case INM::WIFI_SECURITY_WEP_64:
+                case INM::WIFI_SECURITY_WEP_128:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY;
+                case INM::WIFI_SECURITY_WPA_PSK_TKIP:
+                case INM::WIFI_SECURITY_WPA_PSK_AES:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_WPA | INM::WIFI_SECURITY_FLAG_PSK;
+                case INM::WIFI_SECURITY_WPA2_PSK_TKIP:
+                case INM::WIFI_SECURITY_WPA2_PSK_AES:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_RSN | INM::WIFI_SECURITY_FLAG_PSK;
+                case INM::WIFI_SECURITY_WPA_ENTERPRISE_TKIP:
+                case INM::WIFI_SECURITY_WPA_ENTERPRISE_AES:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_WPA | INM::WIFI_SECURITY_FLAG_8021X;
+                case INM::WIFI_SECURITY_WPA2_ENTERPRISE_TKIP:
+                case INM::WIFI_SECURITY_WPA2_ENTERPRISE_AES:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_RSN | INM::WIFI_SECURITY_FLAG_8021X;
+                case INM::WIFI_SECURITY_WPA_WPA2_PSK:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_WPA | INM::WIFI_SECURITY_FLAG_RSN | INM::WIFI_SECURITY_FLAG_PSK;
+                case INM::WIFI_SECURITY_WPA_WPA2_ENTERPRISE:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_WPA | INM::WIFI_SECURITY_FLAG_RSN | INM::WIFI_SECURITY_FLAG_8021X;
+                case INM::WIFI_SECURITY_WPA3_PSK_AES:
+                case INM::WIFI_SECURITY_WPA3_SAE:
+                    return INM::WIFI_SECURITY_FLAG_PRIVACY | INM::WIFI_SECURITY_FLAG_RSN | INM::WIFI_SECURITY_FLAG_SAE;
+            }
+            return INM::WIFI_SECURITY_FLAG_PRIVACY;
+        }
+
+        bool WiFiScanResults::parseJson(const std::string& json, std::vector<AccessPoint>& accessPoints)
+        {
+            JsonArray array;
+            if (!array.FromString(json))
+                return false;
+
+            accessPoints.reserve(array.Length());
+            for (uint16_t i = 0; i < array.Length(); i++)
+            {
+                if (array[i].Content() != Core::JSON::Variant::type::OBJECT)
+                    continue;
+                JsonObject object = array[i].Object();
+                AccessPoint accessPoint;
+                accessPoint.m_ssid = object["ssid"].String();
+                if (accessPoint.m_ssid == "---")
+                    accessPoint.m_ssid.clear();
+                accessPoint.m_bssid = 0;
+                /* IARM reports the band or the frequency in GHz; the signal strength is in dBm */
+                double frequency = strtod(object["frequency"].String().c_str(), nullptr);
+                accessPoint.m_frequency = static_cast<uint32_t>(frequency < 100 ? frequency * 1000 : frequency);
+                int rssi = static_cast<int>(strtof(object["signalStrength"].String().c_str(), nullptr));
+                accessPoint.m_rssi = static_cast<int16_t>(rssi);
+                accessPoint.m_strength = static_cast<uint8_t>(rssi >= -50 ? 100 : (rssi <= -100 ? 0 : 2 * (rssi + 100)));
+                accessPoint.m_securityMode = static_cast<INM::WIFISecurityMode>(strtol(object["security"].String().c_str(), nullptr, 10));
+                accessPoint.m_securityFlags = securityFlagsFromMode(accessPoint.m_securityMode);
+                accessPoint.m_lastSeen = -1;
+                accessPoints.push_back(accessPoint);
+            }
+            return true;
+        }
+
+        uint64_t WiFiScanResults::keyOf(const AccessPoint& accessPoint)
+        {
+            if (accessPoint.m_bssid != 0)
+                return accessPoint.m_bssid;
+            /* above the 48 bits a BSSID uses, so it never collides with a real one */
+            uint64_t hash = std::hash<std::string>()(accessPoint.m_ssid + '/' + frequencyBand(accessPoint.m_frequency));
+            return (1ULL << 63) | (hash & 0x7FFFFFFFFFFFFFFFULL);
+        }
+
+        bool WiFiScanTable::changedEnough(const AccessPoint& reported, const AccessPoint& current)
+        {
+            int rssiMoved = static_cast<int>(current.m_rssi) - static_cast<int>(reported.m_rssi);
+            return (rssiMoved >= NM_WIFI_SCAN_DELTA_RSSI_DB || rssiMoved <= -NM_WIFI_SCAN_DELTA_RSSI_DB
+                    || current.m_ssid != reported.m_ssid
+                    || current.m_securityMode != reported.m_securityMode
+                    || WiFiScanResults::frequencyBand(current.m_frequency) != WiFiScanResults::frequencyBand(reported.m_frequency));
+        }
+
+        bool WiFiScanTable::update(const WiFiScanResults& scan, WiFiScanDelta& delta)
+        {
+            std::map<uint64_t, const AccessPoint*> current;
+            for (const auto& accessPoint : scan.accessPoints())
+            {
+                auto inserted = current.insert(std::make_pair(WiFiScanResults::keyOf(accessPoint), &accessPoint));
+                if (!inserted.second && accessPoint.m_rssi > inserted.first->second->m_rssi)
+                    inserted.first->second = &accessPoint;
+            }
+
+            delta.added = "[";
+            delta.changed = "[";
+            delta.removed = "[";
+            bool any = false;
+
+            for (auto entry = entries.begin(); entry != entries.end(); )
+            {
+                auto seen = current.find(entry->first);
+                if (seen == current.end())
+                {
+                    if (++entry->second.missed >= NM_WIFI_SCAN_DELTA_MISSES)
+                    {
+                        if (delta.removed.size() > 1)
+                            delta.removed += ',';
+                        WiFiScanResults::appendJson(delta.removed, entry->second.reported, true);
+                        entry = entries.erase(entry);
+                        any = true;
+                        continue;
+                    }
+                }
+                else
+                {
+                    entry->second.missed = 0;
+                    if (changedEnough(entry->second.reported, *seen->second))
+                    {
+                        entry->second.reported = *seen->second;
+                        if (delta.changed.size() > 1)
+                            delta.changed += ',';
+                        WiFiScanResults::appendJson(delta.changed, entry->second.reported, true);
+                        any = true;
+                    }
+                    current.erase(seen);
+                }
+                ++entry;
+            }
+
+            /* what is left in the scan is new */
+            for (const auto& accessPoint : current)
+            {
+                Entry& entry = entries[accessPoint.first];
+                entry.reported = *accessPoint.second;
+                entry.missed = 0;
+                if (delta.added.size() > 1)
+                    delta.added += ',';
+                WiFiScanResults::appendJson(delta.added, entry.reported, true);
+                any = true;
+            }
+
+            delta.added += ']';
+            delta.changed += ']';
+            delta.removed += ']';
+            if (any)
+                currentSequence++;
+            delta.sequence = currentSequence;
+            return any;
+        }
+
+        std::vector<WiFiScanTable::AccessPoint> WiFiScanTable::accessPoints() const
+        {
+            std::vector<AccessPoint> table;
+            table.reserve(entries.size());
+            for (const auto& entry : entries)
+                table.push_back(entry.second.reported);
+            return table;
+        }
+    }
+}
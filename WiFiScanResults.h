@@ -0,0 +1,120 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "Module.h"
+#include "INetworkManager.h"
+
+#define NM_WIFI_SCAN_DELTA_RSSI_DB      6       // an AP whose RSSI moved less than this since it was last reported is unchanged
+#define NM_WIFI_SCAN_DELTA_MISSES       2       // consecutive scans an AP has to be missing from before it is removed
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        /*
+         * One completed scan, immutable once built and shared by reference count. It is created from whatever
+         * the backend has, typed records from libnm or the JSON text of the IARM event, and the other form is
+         * made on first use, once. JSON is only built when an onAvailableSSIDs subscriber needs it. Records are
+         * needed for every scan, the scan table and the scan cache are updated from them, so JSON from IARM is
+         * parsed once per scan and GetWiFiScanResults reuses what was parsed.
+         */
+        class WiFiScanResults
+        {
+            public:
+                typedef Exchange::INetworkManager::WiFiAccessPoint AccessPoint;
+
+                explicit WiFiScanResults(std::vector<AccessPoint>&& accessPoints);
+                /* a JSON array of {ssid, security, signalStrength, frequency} objects */
+                explicit WiFiScanResults(std::string&& json);
+
+                const std::vector<AccessPoint>& accessPoints() const;
+                /* the JSON array; text given that does not parse as one is returned as a JSON string of it instead,
+                   so it stays valid JSON where it is embedded verbatim */
+                const std::string& json() const;
+
+                /* withBssid adds the "bssid" the delta records are matched by and the "rssi" in dBm */
+                static void appendJson(std::string& json, const AccessPoint& accessPoint, bool withBssid = false);
+                static bool parseJson(const std::string& json, std::vector<AccessPoint>& accessPoints);
+                /* "AA:BB:CC:DD:EE:FF" to the packed form, 0 when it does not parse */
+                static uint64_t bssidFromString(const char* bssid);
+                /* "AA:BB:CC:DD:EE:FF", empty for 0 */
+                static std::string bssidToString(uint64_t bssid);
+                /* band as the scan JSON reports it, "2.4", "5" or "6" */
+                static std::string frequencyBand(uint32_t frequencyMHz);
+                /* the BSSID, or for a record without one, an IARM one, a hash of its SSID and band */
+                static uint64_t keyOf(const AccessPoint& accessPoint);
+
+            private:
+                WiFiScanResults(const WiFiScanResults&) = delete;
+                WiFiScanResults& operator=(const WiFiScanResults&) = delete;
+
+                mutable std::once_flag recordsOnce;
+                mutable std::once_flag jsonOnce;
+                mutable std::vector<AccessPoint> records;
+                mutable std::string text;
+                const bool fromText;
+                mutable bool parsed;
+        };
+
+        struct WiFiScanDelta {
+            uint32_t sequence = 0;
+            std::string added;                  /* JSON arrays of scan records with their bssid */
+            std::string changed;
+            std::string removed;
+        };
+
+        /*
+         * The access points subscribers were last told about, keyed by BSSID. Each scan is compared with it
+         * and only what differs goes out: APs that appeared, APs missing from NM_WIFI_SCAN_DELTA_MISSES scans
+         * in a row, and APs whose RSSI moved by NM_WIFI_SCAN_DELTA_RSSI_DB or whose SSID, band or security
+         * changed. An entry keeps the values last reported, so small drifts add up until they are reported and
+         * a client that applies every delta in sequence holds the same table. The sequence moves by one per
+         * delta, a client that sees a gap reads the whole table again. Records without a BSSID, the IARM ones,
+         * are keyed by SSID and band with the strongest one kept. Not locked, the owner serializes access.
+         */
+        class WiFiScanTable
+        {
+            public:
+                typedef WiFiScanResults::AccessPoint AccessPoint;
+
+                WiFiScanTable() : currentSequence(0) {}
+                /* false when nothing changed enough to report, the sequence is left as it is */
+                bool update(const WiFiScanResults& scan, WiFiScanDelta& delta);
+                uint32_t sequence() const { return currentSequence; }
+                std::vector<AccessPoint> accessPoints() const;
+
+            private:
+                struct Entry {
+                    AccessPoint reported;
+                    uint32_t missed;
+                };
+
+                static bool changedEnough(const AccessPoint& reported, const AccessPoint& current);
+
+                std::map<uint64_t, Entry> entries;
+                uint32_t currentSequence;
+        };
+    }
+}
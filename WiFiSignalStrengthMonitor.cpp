@@ -1,4 +1,8 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <thread>
 #include <chrono>
 #include <atomic>
@@ -6,9 +10,11 @@
 #include "NetworkManagerImplementation.h"
 #include "WiFiSignalStrengthMonitor.h"
 
-#define BUFFER_SIZE 512
-#define rssid_command "wpa_cli signal_poll"
-#define ssid_command "wpa_cli status"
+#define rssid_command "SIGNAL_POLL"
+#define ssid_command "STATUS"
+#define WPA_EVENT_SIGNAL_CHANGE "CTRL-EVENT-SIGNAL-CHANGE"
+#define WPA_EVENT_CONNECTED "CTRL-EVENT-CONNECTED"
+#define WPA_EVENT_DISCONNECTED "CTRL-EVENT-DISCONNECTED"
 
 namespace WPEFramework
 {
@@ -19,38 +25,169 @@ namespace WPEFramework
         static const float signalStrengthThresholdFair = -67.0f;
         extern NetworkManagerImplementation* _instance;
 
-        std::string WiFiSignalStrengthMonitor::retrieveValues(const char *command, const char* keyword, char *output_buffer, size_t output_buffer_size)
+        static Exchange::INetworkManager::WiFiSignalQuality signalQualityFromRssi(float signalStrengthOut)
         {
-            std::string key, value;
-            std::string keystr = "";
+            if (signalStrengthOut == 0.0f)
+                return Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
+            else if (signalStrengthOut >= signalStrengthThresholdExcellent && signalStrengthOut < 0)
+                return Exchange::INetworkManager::WIFI_SIGNAL_EXCELLENT;
+            else if (signalStrengthOut >= signalStrengthThresholdGood && signalStrengthOut < signalStrengthThresholdExcellent)
+                return Exchange::INetworkManager::WIFI_SIGNAL_GOOD;
+            else if (signalStrengthOut >= signalStrengthThresholdFair && signalStrengthOut < signalStrengthThresholdGood)
+                return Exchange::INetworkManager::WIFI_SIGNAL_FAIR;
+            else
+                return Exchange::INetworkManager::WIFI_SIGNAL_WEAK;
+        }
 
-            FILE *fp = popen(command, "r");
-            if (!fp)
+        static float signalQualityLowerEdge(Exchange::INetworkManager::WiFiSignalQuality quality)
+        {
+            switch (quality)
             {
-                NMLOG_ERROR("Failed in getting output from command %s \n",command);
-                return keystr;
+                case Exchange::INetworkManager::WIFI_SIGNAL_EXCELLENT: return signalStrengthThresholdExcellent;
+                case Exchange::INetworkManager::WIFI_SIGNAL_GOOD: return signalStrengthThresholdGood;
+                case Exchange::INetworkManager::WIFI_SIGNAL_FAIR: return signalStrengthThresholdFair;
+                default: return -200.0f;
             }
+        }
+
+        static long monotonicMs()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        WiFiSignalFilter::WiFiSignalFilter(float hysteresisDb, long minDwellMs, float ewmaAlpha)
+            : hysteresisDb(hysteresisDb)
+            , minDwellMs(minDwellMs)
+            , ewmaAlpha(ewmaAlpha)
+        {
+            reset();
+        }
+
+        void WiFiSignalFilter::reset()
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            historyCount = 0;
+            historyIndex = 0;
+            rawRssi = 0.0f;
+            filteredRssi = 0.0f;
+            rawQuality = Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
+            reportedQuality = Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
+            lastTransition = 0;
+            pending = false;
+        }
+
+        Exchange::INetworkManager::WiFiSignalQuality WiFiSignalFilter::qualityWithHysteresis(float rssi) const
+        {
+            Exchange::INetworkManager::WiFiSignalQuality candidate = signalQualityFromRssi(rssi);
+            if (reportedQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED || candidate == reportedQuality)
+                return candidate;
 
-            while ((!feof(fp)) && (fgets(output_buffer, output_buffer_size, fp) != NULL))
+            if (candidate > reportedQuality)
             {
-                std::istringstream mystream(output_buffer);
-                if(std::getline(std::getline(mystream, key, '=') >> std::ws, value))
-                    if (key == keyword) {
-                        keystr = value;
-                        break;
-                    }
+                /* going up, clear every band edge on the way by the hysteresis */
+                while (candidate > reportedQuality && rssi < signalQualityLowerEdge(candidate) + hysteresisDb)
+                    candidate = static_cast<Exchange::INetworkManager::WiFiSignalQuality>(candidate - 1);
             }
-            pclose(fp);
+            else
+            {
+                /* going down, same on the way down; leaving the current band needs the full hysteresis */
+                if (rssi >= signalQualityLowerEdge(reportedQuality) - hysteresisDb)
+                    return reportedQuality;
+                while (candidate < reportedQuality && rssi >= signalQualityLowerEdge(static_cast<Exchange::INetworkManager::WiFiSignalQuality>(candidate + 1)) - hysteresisDb)
+                    candidate = static_cast<Exchange::INetworkManager::WiFiSignalQuality>(candidate + 1);
+            }
+            return candidate;
+        }
+
+        bool WiFiSignalFilter::update(float rssi, long nowMs, bool useMedian)
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            history[historyIndex] = rssi;
+            historyIndex = (historyIndex + 1) % 3;
+            if (historyCount < 3)
+                historyCount++;
 
-            return keystr;
+            /* median of the last three polled samples drops single spikes, driver events are filtered already */
+            float sample = rssi;
+            if (useMedian && historyCount == 3)
+                sample = std::max(std::min(history[0], history[1]), std::min(std::max(history[0], history[1]), history[2]));
+
+            filteredRssi = (reportedQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED) ? sample : filteredRssi + ewmaAlpha * (sample - filteredRssi);
+            rawRssi = rssi;
+
+            Exchange::INetworkManager::WiFiSignalQuality previousRawQuality = rawQuality;
+            rawQuality = signalQualityFromRssi(rssi);
+            Exchange::INetworkManager::WiFiSignalQuality candidate = qualityWithHysteresis(filteredRssi);
+            bool changed = false;
+            pending = false;
+            if (candidate != reportedQuality)
+            {
+                if (reportedQuality != Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED && nowMs - lastTransition < minDwellMs)
+                    pending = true;
+                else
+                {
+                    reportedQuality = candidate;
+                    lastTransition = nowMs;
+                    transitions++;
+                    changed = true;
+                }
+            }
+
+            /* a raw band change that would have been notified without the filter */
+            if (rawQuality != previousRawQuality && previousRawQuality != Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED && !changed)
+                suppressedTransitions++;
+            return changed;
+        }
+
+        bool WiFiSignalFilter::isSettling() const
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            if (reportedQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED)
+                return false;
+            return pending || std::fabs(filteredRssi - rawRssi) > WIFI_SIGNAL_SETTLED_DB;
+        }
+
+        Exchange::INetworkManager::WiFiSignalQuality WiFiSignalFilter::quality() const
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            return reportedQuality;
+        }
+
+        WiFiSignalFilterStats WiFiSignalFilter::getStats() const
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            WiFiSignalFilterStats stats;
+            stats.rawRssi = rawRssi;
+            stats.filteredRssi = filteredRssi;
+            stats.transitions = transitions;
+            stats.suppressedTransitions = suppressedTransitions;
+            return stats;
+        }
+
+        void WiFiSignalFilter::configure(float hysteresisDb, long minDwellMs)
+        {
+            std::lock_guard<std::mutex> lock(filterMutex);
+            this->hysteresisDb = hysteresisDb;
+            this->minDwellMs = minDwellMs;
         }
 
         void WiFiSignalStrengthMonitor::getSignalData(std::string &ssid, Exchange::INetworkManager::WiFiSignalQuality &quality, std::string &strengthOut)
         {
             float signalStrengthOut = 0.0f;
-            char buff[BUFFER_SIZE] = {'\0'};
+            getSignalData(ssid, quality, strengthOut, signalStrengthOut);
+        }
 
-            ssid = retrieveValues(ssid_command, "ssid", buff, sizeof (buff));
+        void WiFiSignalStrengthMonitor::getSignalData(std::string &ssid, Exchange::INetworkManager::WiFiSignalQuality &quality, std::string &strengthOut, float &signalStrengthOut)
+        {
+            signalStrengthOut = 0.0f;
+            const char* reply = nullptr;
+            const char* value = nullptr;
+            size_t replyLen = 0, valueLen = 0;
+
+            ssid.clear();
+            strengthOut.clear();
+            if (wpaCtrl.request(ssid_command, reply, replyLen) && WpaCtrlClient::findValue(reply, replyLen, "ssid", value, valueLen))
+                ssid.assign(value, valueLen);
             if (ssid.empty())
             {
                 NMLOG_ERROR("ssid is empty");
@@ -58,35 +195,16 @@ namespace WPEFramework
                 return;
             }
 
-            string signalStrength = retrieveValues(rssid_command, "RSSI", buff, sizeof (buff));
-            if (!signalStrength.empty()) {
-                signalStrengthOut = std::stof(signalStrength.c_str());
-                strengthOut = signalStrength;
+            if (wpaCtrl.request(rssid_command, reply, replyLen) && WpaCtrlClient::findValue(reply, replyLen, "RSSI", value, valueLen) && valueLen > 0) {
+                /* the value ends at the newline, strtol stops there */
+                signalStrengthOut = static_cast<float>(strtol(value, nullptr, 10));
+                strengthOut.assign(value, valueLen);
             }
             else
                 NMLOG_ERROR("signalStrength is empty");
 
             NMLOG_DEBUG("SSID = %s Signal Strength %f db", ssid.c_str(), signalStrengthOut);
-            if (signalStrengthOut == 0.0f)
-            {
-                quality = Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
-            }
-            else if (signalStrengthOut >= signalStrengthThresholdExcellent && signalStrengthOut < 0)
-            {
-                quality = Exchange::INetworkManager::WIFI_SIGNAL_EXCELLENT;
-            }
-            else if (signalStrengthOut >= signalStrengthThresholdGood && signalStrengthOut < signalStrengthThresholdExcellent)
-            {
-                quality = Exchange::INetworkManager::WIFI_SIGNAL_GOOD;
-            }
-            else if (signalStrengthOut >= signalStrengthThresholdFair && signalStrengthOut < signalStrengthThresholdGood)
-            {
-                quality = Exchange::INetworkManager::WIFI_SIGNAL_FAIR;
-            }
-            else
-            {
-                quality = Exchange::INetworkManager::WIFI_SIGNAL_WEAK;
-            };
+            quality = signalQualityFromRssi(signalStrengthOut);
         }
 
         void WiFiSignalStrengthMonitor::startWiFiSignalStrengthMonitor(int interval)
@@ -103,37 +221,179 @@ namespace WPEFramework
             NMLOG_INFO("Thread started with interval: %d seconds", interval);
         }
 
+        bool WiFiSignalStrengthMonitor::reportSignalQuality(const std::string &ssid, const std::string &signalStrength, Exchange::INetworkManager::WiFiSignalQuality newSignalQuality)
+        {
+            if(oldSignalQuality != newSignalQuality)
+            {
+                WiFiSignalFilterStats stats = signalFilter.getStats();
+                NMLOG_INFO("Notifying WiFiSignalStrengthChangedEvent %s (filtered %.1f dBm, %u transitions suppressed)", signalStrength.c_str(),
+                                                                                    stats.filteredRssi, stats.suppressedTransitions);
+                oldSignalQuality = newSignalQuality;
+                _instance->ReportWiFiSignalStrengthChangedEvent(ssid, signalStrength, newSignalQuality);
+            }
+
+            if(newSignalQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED)
+            {
+                NMLOG_WARNING("WiFiSignalStrengthChanged to disconnect - WiFiSignalStrengthMonitor exiting");
+                return false;
+            }
+            return true;
+        }
+
+        bool WiFiSignalStrengthMonitor::processSignalSample(const std::string &ssid, const std::string &signalStrength, Exchange::INetworkManager::WiFiSignalQuality rawQuality,
+                                                                                                float rssi, bool useMedian)
+        {
+            /* losing the link is reported right away, only the quality bands are filtered */
+            if (rawQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED)
+            {
+                signalFilter.reset();
+                return reportSignalQuality(ssid, signalStrength, rawQuality);
+            }
+
+            NMLOG_DEBUG("WiFi signal raw %.0f dBm filtered %.1f dBm", rssi, signalFilter.getStats().filteredRssi);
+            if (signalFilter.update(rssi, monotonicMs(), useMedian))
+                return reportSignalQuality(ssid, signalStrength, signalFilter.quality());
+            return true;
+        }
+
+        bool WiFiSignalStrengthMonitor::armSignalThreshold(Exchange::INetworkManager::WiFiSignalQuality quality)
+        {
+            /*
+             * one CQM threshold at the upper edge of the current band (the lower one for excellent). the driver
+             * reports crossing it and, below it, every further drop by the hysteresis, so both band edges are seen.
+             */
+            int threshold = static_cast<int>(signalStrengthThresholdExcellent);
+            if (quality == Exchange::INetworkManager::WIFI_SIGNAL_FAIR)
+                threshold = static_cast<int>(signalStrengthThresholdGood);
+            else if (quality == Exchange::INetworkManager::WIFI_SIGNAL_WEAK)
+                threshold = static_cast<int>(signalStrengthThresholdFair);
+
+            char command[64];
+            const char* reply = nullptr;
+            size_t replyLen = 0;
+            snprintf(command, sizeof(command), "SIGNAL_MONITOR THRESHOLD=%d HYSTERESIS=%d", threshold, WIFI_SIGNAL_EVENT_HYSTERESIS_DB);
+            if (!wpaCtrl.request(command, reply, replyLen) || strncmp(reply, "OK", 2) != 0)
+                return false;
+            NMLOG_DEBUG("signal change events armed at %d dBm", threshold);
+            return true;
+        }
+
+        bool WiFiSignalStrengthMonitor::runEventMonitor()
+        {
+            string ssid = "";
+            string signalStrength;
+            Exchange::INetworkManager::WiFiSignalQuality signalQuality;
+            float rssi = 0.0f;
+
+            if (_instance == nullptr || !wpaEvents.attach())
+            {
+                wpaEvents.close();
+                return false;
+            }
+
+            getSignalData(ssid, signalQuality, signalStrength, rssi);
+            bool connected = processSignalSample(ssid, signalStrength, signalQuality, rssi, false);
+            Exchange::INetworkManager::WiFiSignalQuality armedQuality = oldSignalQuality;
+            if (connected && !armSignalThreshold(armedQuality))
+            {
+                NMLOG_WARNING("no signal change events from the driver, polling WiFi signal strength");
+                wpaEvents.detach();
+                wpaEvents.close();
+                return false;
+            }
+
+            NMLOG_INFO("WiFiSignalStrengthMonitor waiting for signal change events");
+            while (connected && !stopThread)
+            {
+                const char* event = nullptr;
+                const char* value = nullptr;
+                size_t eventLen = 0, valueLen = 0;
+                bool resync = false;
+
+                /* a few quick samples while the filter catches up with a change, no wakeups once it has */
+                bool settling = signalFilter.isSettling();
+                int rc = wpaEvents.waitEvent((settling ? WIFI_SIGNAL_SETTLE_INTERVAL_SEC : WIFI_SIGNAL_EVENT_WATCHDOG_SEC) * 1000, event, eventLen);
+                if (rc < 0)
+                {
+                    /* wpa_supplicant restarted, the thresholds went with it */
+                    NMLOG_WARNING("wpa_supplicant event socket lost, attaching again");
+                    wpaEvents.close();
+                    if (!wpaEvents.attach())
+                        break;
+                    resync = true;
+                }
+                else if (rc == 0)
+                    resync = true; /* settle sample, or the watchdog in case the driver stopped reporting */
+                else if (strncmp(event, WPA_EVENT_SIGNAL_CHANGE, strlen(WPA_EVENT_SIGNAL_CHANGE)) == 0)
+                {
+                    if (!WpaCtrlClient::findEventValue(event, eventLen, "signal", value, valueLen) || valueLen == 0)
+                        continue;
+                    signalStrength.assign(value, valueLen);
+                    rssi = static_cast<float>(strtol(value, nullptr, 10));
+                    NMLOG_DEBUG("signal change event %s dBm", signalStrength.c_str());
+                    connected = processSignalSample(ssid, signalStrength, signalQualityFromRssi(rssi), rssi, false);
+                }
+                else if (strncmp(event, WPA_EVENT_CONNECTED, strlen(WPA_EVENT_CONNECTED)) == 0 ||
+                         strncmp(event, WPA_EVENT_DISCONNECTED, strlen(WPA_EVENT_DISCONNECTED)) == 0)
+                    resync = true;
+                else
+                    continue;
+
+                if (resync)
+                {
+                    getSignalData(ssid, signalQuality, signalStrength, rssi);
+                    connected = processSignalSample(ssid, signalStrength, signalQuality, rssi, false);
+                }
+                if (connected && (rc < 0 || armedQuality != oldSignalQuality))
+                {
+                    armedQuality = oldSignalQuality;
+                    armSignalThreshold(armedQuality);
+                }
+            }
+
+            if (wpaEvents.isAttached())
+            {
+                const char* reply = nullptr;
+                size_t replyLen = 0;
+                wpaCtrl.request("SIGNAL_MONITOR", reply, replyLen);
+                wpaEvents.detach();
+            }
+            wpaEvents.close();
+            /* lost the event socket for good, carry on polling */
+            return !connected || stopThread;
+        }
+
         void WiFiSignalStrengthMonitor::monitorThreadFunction(int interval)
         {
-            static Exchange::INetworkManager::WiFiSignalQuality oldSignalQuality = Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
             NMLOG_INFO("WiFiSignalStrengthMonitor thread started !");
+            signalFilter.reset();
+            oldSignalQuality = Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED;
+            if (runEventMonitor())
+            {
+                isRunning = false;
+                return;
+            }
+
             while (!stopThread)
             {
                 string ssid = "";
                 string signalStrength;
                 Exchange::INetworkManager::WiFiSignalQuality newSignalQuality;
+                float rssi = 0.0f;
                 if (_instance != nullptr)
                 {
                     NMLOG_DEBUG("checking WiFi signal strength");
-                    getSignalData(ssid, newSignalQuality, signalStrength);
-                    if(oldSignalQuality != newSignalQuality)
-                    {
-                        NMLOG_INFO("Notifying WiFiSignalStrengthChangedEvent %s", signalStrength.c_str());
-                        oldSignalQuality = newSignalQuality;
-                        _instance->ReportWiFiSignalStrengthChangedEvent(ssid, signalStrength, newSignalQuality);
-                    }
-
-                    if(newSignalQuality == Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED)
+                    getSignalData(ssid, newSignalQuality, signalStrength, rssi);
+                    if (!processSignalSample(ssid, signalStrength, newSignalQuality, rssi, true))
                     {
-                        NMLOG_WARNING("WiFiSignalStrengthChanged to disconnect - WiFiSignalStrengthMonitor exiting");
                         stopThread= false;
                         break; // Let the thread exit naturally
                     }
                 }
                 else
                     NMLOG_FATAL("NetworkManagerImplementation pointer error !");
-                // Wait for the specified interval or until notified to stop
-                std::this_thread::sleep_for(std::chrono::seconds(interval));
+                // Wait for the specified interval or until notified to stop, shorter while the filter settles
+                std::this_thread::sleep_for(std::chrono::seconds(signalFilter.isSettling() ? std::min(interval, WIFI_SIGNAL_SETTLE_INTERVAL_SEC) : interval));
             }
             isRunning = false;
         }
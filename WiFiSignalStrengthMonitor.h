@@ -26,25 +26,87 @@
 #include <atomic>
 #include "Module.h"
 #include "NetworkManagerLogger.h"
+#include "WpaCtrlClient.h"
 
 #define DEFAULT_WIFI_SIGNAL_TEST_INTERVAL_SEC       60
+#define WIFI_SIGNAL_EVENT_HYSTERESIS_DB             2       // below the threshold the driver reports every drop of this size
+#define WIFI_SIGNAL_EVENT_WATCHDOG_SEC              600     // signal is sampled once in a while in event mode too
+#define WIFI_SIGNAL_HYSTERESIS_DB                   3.0f    // a quality band edge has to be cleared by this much
+#define WIFI_SIGNAL_MIN_DWELL_MS                    10000   // reported quality is held at least this long
+#define WIFI_SIGNAL_EWMA_ALPHA                      0.5f
+#define WIFI_SIGNAL_SETTLED_DB                      1.0f    // filtered value this close to the last sample needs no more samples
+#define WIFI_SIGNAL_SETTLE_INTERVAL_SEC             2       // sampling interval while the filter catches up
 namespace WPEFramework
 {
     namespace Plugin
     {
+        struct WiFiSignalFilterStats {
+            float rawRssi;
+            float filteredRssi;
+            uint32_t transitions;               /* reported quality changes */
+            uint32_t suppressedTransitions;     /* raw quality changes the filter kept from being reported */
+        };
+
+        /* RSSI median of three and EWMA, quality bands with hysteresis and a minimum dwell time */
+        class WiFiSignalFilter
+        {
+            public:
+                WiFiSignalFilter(float hysteresisDb = WIFI_SIGNAL_HYSTERESIS_DB, long minDwellMs = WIFI_SIGNAL_MIN_DWELL_MS, float ewmaAlpha = WIFI_SIGNAL_EWMA_ALPHA);
+                /* new link, the next sample is reported as it is */
+                void reset();
+                /* true when the reported quality changed */
+                bool update(float rssi, long nowMs, bool useMedian);
+                /* filtered value still moving, or a change held back by the dwell time */
+                bool isSettling() const;
+                Exchange::INetworkManager::WiFiSignalQuality quality() const;
+                WiFiSignalFilterStats getStats() const;
+                /* tuning from the plugin configuration, takes effect with the next sample */
+                void configure(float hysteresisDb, long minDwellMs);
+
+            private:
+                Exchange::INetworkManager::WiFiSignalQuality qualityWithHysteresis(float rssi) const;
+                float hysteresisDb;
+                long minDwellMs;
+                const float ewmaAlpha;
+                mutable std::mutex filterMutex;
+                float history[3];
+                int historyCount;
+                int historyIndex;
+                float rawRssi;
+                float filteredRssi;
+                Exchange::INetworkManager::WiFiSignalQuality rawQuality;
+                Exchange::INetworkManager::WiFiSignalQuality reportedQuality;
+                long lastTransition;
+                bool pending;
+                uint32_t transitions = 0;
+                uint32_t suppressedTransitions = 0;
+        };
+
         class WiFiSignalStrengthMonitor
         {
             public:
-                WiFiSignalStrengthMonitor():isRunning(false) {}
+                WiFiSignalStrengthMonitor():oldSignalQuality(Exchange::INetworkManager::WIFI_SIGNAL_DISCONNECTED), isRunning(false) {}
                 ~WiFiSignalStrengthMonitor(){ NMLOG_INFO("~WiFiSignalStrengthMonitor"); }
                 void startWiFiSignalStrengthMonitor(int interval);
                 void getSignalData(std::string &ssid, Exchange::INetworkManager::WiFiSignalQuality &quality, std::string &strengthOut);
+                WiFiSignalFilterStats getSignalFilterStats() const { return signalFilter.getStats(); }
+                void configureSignalFilter(float hysteresisDb, long minDwellMs) { signalFilter.configure(hysteresisDb, minDwellMs); }
             private:
-                std::string retrieveValues(const char *command, const char* keyword, char *output_buffer, size_t output_buffer_size);
+                void getSignalData(std::string &ssid, Exchange::INetworkManager::WiFiSignalQuality &quality, std::string &strengthOut, float &signalStrengthOut);
+                bool processSignalSample(const std::string &ssid, const std::string &signalStrength, Exchange::INetworkManager::WiFiSignalQuality rawQuality, float rssi, bool useMedian);
+                /* only used from the monitor thread */
+                WpaCtrlClient wpaCtrl;
+                WpaCtrlClient wpaEvents;
+                Exchange::INetworkManager::WiFiSignalQuality oldSignalQuality;
+                WiFiSignalFilter signalFilter;
                 std::thread monitorThread;
                 std::atomic<bool> stopThread;
                 std::atomic<bool> isRunning;
                 void monitorThreadFunction(int interval);
+                /* CQM threshold events through wpa_supplicant, false when the driver can not do it */
+                bool runEventMonitor();
+                bool armSignalThreshold(Exchange::INetworkManager::WiFiSignalQuality quality);
+                bool reportSignalQuality(const std::string &ssid, const std::string &signalStrength, Exchange::INetworkManager::WiFiSignalQuality newSignalQuality);
         };
     }
 }
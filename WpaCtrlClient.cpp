@@ -0,0 +1,293 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "NetworkManagerLogger.h"
+#include "WpaCtrlClient.h"
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        static std::atomic<int> localSocketCounter(0);
+
+        WpaCtrlClient::WpaCtrlClient(const std::string& ctrlDir, const std::string& interface)
+            : ctrlDir(ctrlDir)
+            , interface(interface)
+            , ctrlFd(-1)
+            , attached(false)
+        {
+            replyBuffer[0] = '\0';
+        }
+
+        WpaCtrlClient::~WpaCtrlClient()
+        {
+            close();
+        }
+
+        bool WpaCtrlClient::resolveCtrlPath()
+        {
+            std::string ifname = interface.empty() ? WPA_CTRL_DEFAULT_INTERFACE : interface;
+            ctrlPath = ctrlDir + "/" + ifname;
+            if (!interface.empty() || access(ctrlPath.c_str(), F_OK) == 0)
+                return true;
+
+            DIR *dir = opendir(ctrlDir.c_str());
+            if (dir == nullptr)
+                return false;
+            struct dirent *entry = nullptr;
+            bool found = false;
+            while ((entry = readdir(dir)) != nullptr)
+            {
+                if (entry->d_name[0] == '.')
+                    continue;
+                ctrlPath = ctrlDir + "/" + entry->d_name;
+                found = true;
+                break;
+            }
+            closedir(dir);
+            return found;
+        }
+
+        bool WpaCtrlClient::open()
+        {
+            if (ctrlFd >= 0)
+                return true;
+            if (!resolveCtrlPath())
+            {
+                NMLOG_ERROR("no wpa_supplicant control socket in %s", ctrlDir.c_str());
+                return false;
+            }
+
+            int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            if (fd < 0)
+            {
+                NMLOG_ERROR("wpa ctrl socket failed: %s", strerror(errno));
+                return false;
+            }
+
+            /* wpa_supplicant replies to the sender address, so the client socket needs a path too */
+            struct sockaddr_un local;
+            memset(&local, 0, sizeof(local));
+            local.sun_family = AF_UNIX;
+            snprintf(local.sun_path, sizeof(local.sun_path), "/tmp/nm_wpa_ctrl_%d-%d", static_cast<int>(getpid()), localSocketCounter++);
+            unlink(local.sun_path);
+            if (bind(fd, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0)
+            {
+                NMLOG_ERROR("wpa ctrl bind %s failed: %s", local.sun_path, strerror(errno));
+                ::close(fd);
+                return false;
+            }
+            localPath = local.sun_path;
+
+            struct sockaddr_un remote;
+            memset(&remote, 0, sizeof(remote));
+            remote.sun_family = AF_UNIX;
+            if (ctrlPath.size() >= sizeof(remote.sun_path))
+            {
+                NMLOG_ERROR("wpa ctrl path too long %s", ctrlPath.c_str());
+                ::close(fd);
+                unlink(localPath.c_str());
+                return false;
+            }
+            strncpy(remote.sun_path, ctrlPath.c_str(), sizeof(remote.sun_path) - 1);
+            if (connect(fd, reinterpret_cast<struct sockaddr*>(&remote), sizeof(remote)) < 0)
+            {
+                NMLOG_ERROR("wpa ctrl connect %s failed: %s", ctrlPath.c_str(), strerror(errno));
+                ::close(fd);
+                unlink(localPath.c_str());
+                return false;
+            }
+
+            ctrlFd = fd;
+            NMLOG_INFO("wpa_supplicant control interface %s opened", ctrlPath.c_str());
+            return true;
+        }
+
+        void WpaCtrlClient::close()
+        {
+            if (ctrlFd < 0)
+                return;
+            ::close(ctrlFd);
+            ctrlFd = -1;
+            attached = false;
+            unlink(localPath.c_str());
+        }
+
+        bool WpaCtrlClient::sendAndReceive(const char* command, size_t& replyLen)
+        {
+            /* a reply that came in after an earlier timeout must not be taken for this one */
+            while (recv(ctrlFd, replyBuffer, sizeof(replyBuffer) - 1, MSG_DONTWAIT) > 0);
+
+            if (send(ctrlFd, command, strlen(command), 0) < 0)
+            {
+                NMLOG_WARNING("wpa ctrl send %s failed: %s", command, strerror(errno));
+                return false;
+            }
+
+            struct pollfd pfd = { ctrlFd, POLLIN, 0 };
+            while (true)
+            {
+                int rc = poll(&pfd, 1, WPA_CTRL_REPLY_TIMEOUT_MS);
+                if (rc < 0 && errno == EINTR)
+                    continue;
+                if (rc <= 0)
+                {
+                    NMLOG_WARNING("wpa ctrl %s: %s", command, rc == 0 ? "no reply" : strerror(errno));
+                    return false;
+                }
+
+                ssize_t len = recv(ctrlFd, replyBuffer, sizeof(replyBuffer) - 1, 0);
+                if (len < 0)
+                {
+                    NMLOG_WARNING("wpa ctrl recv failed: %s", strerror(errno));
+                    return false;
+                }
+                replyBuffer[len] = '\0';
+                /* "<level>" prefixed messages are unsolicited events for attached clients, not replies */
+                if (len > 0 && replyBuffer[0] == '<')
+                    continue;
+                replyLen = static_cast<size_t>(len);
+                return true;
+            }
+        }
+
+        bool WpaCtrlClient::request(const char* command, const char*& reply, size_t& replyLen)
+        {
+            if (!open())
+                return false;
+
+            replyLen = 0;
+            if (!sendAndReceive(command, replyLen))
+            {
+                /* wpa_supplicant may have been restarted, the old socket is gone then */
+                close();
+                if (!open() || !sendAndReceive(command, replyLen))
+                {
+                    close();
+                    return false;
+                }
+            }
+            reply = replyBuffer;
+            return true;
+        }
+
+        bool WpaCtrlClient::attach()
+        {
+            const char* reply = nullptr;
+            size_t replyLen = 0;
+            attached = false;
+            if (!request("ATTACH", reply, replyLen) || strncmp(reply, "OK", 2) != 0)
+            {
+                NMLOG_ERROR("wpa ctrl attach failed");
+                return false;
+            }
+            attached = true;
+            return true;
+        }
+
+        void WpaCtrlClient::detach()
+        {
+            const char* reply = nullptr;
+            size_t replyLen = 0;
+            if (attached && ctrlFd >= 0)
+                request("DETACH", reply, replyLen);
+            attached = false;
+        }
+
+        int WpaCtrlClient::waitEvent(int timeoutMs, const char*& event, size_t& eventLen)
+        {
+            if (ctrlFd < 0)
+                return -1;
+
+            struct pollfd pfd = { ctrlFd, POLLIN, 0 };
+            while (true)
+            {
+                int rc = poll(&pfd, 1, timeoutMs);
+                if (rc < 0 && errno == EINTR)
+                    continue;
+                if (rc == 0)
+                    return 0;
+                if (rc < 0 || (pfd.revents & (POLLERR | POLLHUP)))
+                    return -1;
+
+                ssize_t len = recv(ctrlFd, replyBuffer, sizeof(replyBuffer) - 1, 0);
+                if (len < 0)
+                    return -1;
+                replyBuffer[len] = '\0';
+                if (len == 0 || replyBuffer[0] != '<')
+                    continue; /* late reply of an earlier request */
+
+                const char* text = static_cast<const char*>(memchr(replyBuffer, '>', len));
+                event = text ? text + 1 : replyBuffer;
+                eventLen = replyBuffer + len - event;
+                return 1;
+            }
+        }
+
+        bool WpaCtrlClient::findEventValue(const char* event, size_t eventLen, const char* key, const char*& value, size_t& valueLen)
+        {
+            size_t keyLen = strlen(key);
+            const char* token = event;
+            const char* end = event + eventLen;
+            while (token < end)
+            {
+                const char* tokenEnd = static_cast<const char*>(memchr(token, ' ', end - token));
+                if (tokenEnd == nullptr)
+                    tokenEnd = end;
+                if (static_cast<size_t>(tokenEnd - token) > keyLen && memcmp(token, key, keyLen) == 0 && token[keyLen] == '=')
+                {
+                    value = token + keyLen + 1;
+                    valueLen = tokenEnd - value;
+                    return true;
+                }
+                token = tokenEnd + 1;
+            }
+            return false;
+        }
+
+        bool WpaCtrlClient::findValue(const char* reply, size_t replyLen, const char* key, const char*& value, size_t& valueLen)
+        {
+            size_t keyLen = strlen(key);
+            const char* line = reply;
+            const char* end = reply + replyLen;
+            while (line < end)
+            {
+                const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+                if (lineEnd == nullptr)
+                    lineEnd = end;
+                if (static_cast<size_t>(lineEnd - line) > keyLen && memcmp(line, key, keyLen) == 0 && line[keyLen] == '=')
+                {
+                    value = line + keyLen + 1;
+                    valueLen = lineEnd - value;
+                    return true;
+                }
+                line = lineEnd + 1;
+            }
+            return false;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+* If not stated otherwise in this file or this component's LICENSE
+* file the following copyright and licenses apply:
+*
+* Copyright 2020 RDK Management
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+**/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#define WPA_CTRL_DEFAULT_DIR            "/var/run/wpa_supplicant"
+#define WPA_CTRL_DEFAULT_INTERFACE      "wlan0"
+#define WPA_CTRL_REPLY_TIMEOUT_MS       2000
+#define WPA_CTRL_REPLY_SIZE             4096
+
+namespace WPEFramework
+{
+    namespace Plugin
+    {
+        /*
+         * wpa_supplicant control interface client, same protocol wpa_cli speaks; one UNIX datagram socket
+         * bound to a local path and connected to the interface socket, kept open between requests.
+         * not thread safe, one user thread per client.
+         */
+        class WpaCtrlClient
+        {
+            public:
+                /* empty interface picks wlan0, or the first control socket in the directory like wpa_cli does */
+                WpaCtrlClient(const std::string& ctrlDir = WPA_CTRL_DEFAULT_DIR, const std::string& interface = "");
+                ~WpaCtrlClient();
+                bool open();
+                void close();
+                bool isOpen() const { return ctrlFd >= 0; }
+                /* reply points into the client buffer and stays valid until the next request, it is NUL terminated */
+                bool request(const char* command, const char*& reply, size_t& replyLen);
+                /* unsolicited events; an attached client should not be used for requests, they drop the pending events */
+                bool attach();
+                void detach();
+                bool isAttached() const { return attached; }
+                /* 1 with the event text without its "<level>" prefix, 0 on timeout, -1 on error; -1 timeout waits forever */
+                int waitEvent(int timeoutMs, const char*& event, size_t& eventLen);
+                /* value of a "key=value" reply line, not NUL terminated */
+                static bool findValue(const char* reply, size_t replyLen, const char* key, const char*& value, size_t& valueLen);
+                /* value of a space separated "key=value" event parameter, not NUL terminated */
+                static bool findEventValue(const char* event, size_t eventLen, const char* key, const char*& value, size_t& valueLen);
+
+            private:
+                WpaCtrlClient(const WpaCtrlClient&) = delete;
+                WpaCtrlClient& operator=(const WpaCtrlClient&) = delete;
+                bool resolveCtrlPath();
+                bool sendAndReceive(const char* command, size_t& replyLen);
+
+                std::string ctrlDir;
+                std::string interface;
+                std::string ctrlPath;
+                std::string localPath;
+                int ctrlFd;
+                bool attached;
+                char replyBuffer[WPA_CTRL_REPLY_SIZE];
+        };
+    }
+}